@@ -0,0 +1,82 @@
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "camera.h"
+#include "integrator.h"
+#include "log.h"
+
+struct BDPTVertex
+{
+    enum Type
+    {
+        Camera,
+        Light,
+        Surface
+    };
+
+    Type type_;
+    glm::vec3 position_;
+    // unit geometric normal, the view direction for the camera
+    glm::vec3 normal_;
+    glm::vec3 beta_;
+    // area densities of reaching the vertex from either end of the path
+    float pdf_fwd_;
+    float pdf_rev_;
+    // the path left this vertex through a specular bounce
+    bool delta_;
+
+    // material inputs of surface vertices
+    SurfaceInteraction si_;
+    glm::vec3 emission_;
+};
+
+// Bidirectional path tracing (Veach 1997) with every connection strategy weighted by
+// the balance heuristic. Paths connecting to the camera (light tracing) land at
+// arbitrary pixels and are splatted onto the film.
+class BidirectionalPathTracer : public Integrator
+{
+    Log log_{"BDPT"};
+
+    const int max_depth_;
+    const LightDistribution lights_;
+
+    PinholeCamera camera_;
+    Film *film_ = nullptr;
+
+    void RandomWalk(glm::vec3 dir, glm::vec3 beta, float pdf_dir, Sampler &sampler,
+                    std::vector<BDPTVertex> &path, int max_vertices, PixelAOV *aov,
+                    glm::vec3 *escaped) const;
+
+    // reflected radiance, or emission for lights
+    glm::vec3 F(const BDPTVertex &v, glm::vec3 from, glm::vec3 to) const;
+    // solid angle density of leaving v towards wo, wi points where the path came from
+    float PdfDir(const BDPTVertex &v, glm::vec3 wi, glm::vec3 wo) const;
+    // the same converted to the area density of next
+    float Pdf(const BDPTVertex &v, const BDPTVertex *prev, const BDPTVertex &next) const;
+    float PdfLightOrigin(const BDPTVertex &v) const;
+    float ConvertDensity(float pdf_dir, glm::vec3 from, const BDPTVertex &to) const;
+
+    bool Visible(glm::vec3 from, glm::vec3 to) const;
+
+    glm::vec3 Connect(std::vector<BDPTVertex> &light_path,
+                      std::vector<BDPTVertex> &camera_path, int s, int t, Sampler &sampler,
+                      glm::uvec2 *splat_pixel) const;
+    float MISWeight(std::vector<BDPTVertex> &light_path,
+                    std::vector<BDPTVertex> &camera_path, const BDPTVertex &sampled, int s,
+                    int t) const;
+
+  public:
+    BidirectionalPathTracer(const Scene &scene, const RayCaster &raycaster);
+
+    void SetCamera(glm::vec3 camera_pos, glm::mat4 inv_mvp, Film &film) override;
+
+    glm::vec3 Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                    PixelAOV *aov = nullptr,
+                    const glm::uvec2 *pixel = nullptr) const override;
+
+    // the light tracing strategies (t = 1)
+    bool Splats() const override { return true; }
+};
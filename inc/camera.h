@@ -0,0 +1,33 @@
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+// The pinhole camera of ViewRayCaster::RenderPass, seen from the other side: camera
+// rays go through the image plane spanned by the columns of the inverse MVP matrix.
+class PinholeCamera
+{
+    glm::vec3 position_;
+    glm::vec3 image_x_, image_y_, image_center_;
+    glm::vec3 forward_;
+    // image area on a plane at unit distance
+    float area_;
+
+  public:
+    PinholeCamera();
+    PinholeCamera(glm::vec3 position, glm::mat4 inv_mvp);
+
+    glm::vec3 GetPosition() const;
+    glm::vec3 GetForward() const;
+
+    // normalized device coordinates of the direction, false if it points backwards
+    bool Project(glm::vec3 dir, glm::vec2 *ndc) const;
+    // the pixel whose camera rays include dir, false if it misses the image
+    bool GetPixel(glm::vec3 dir, uint32_t width, uint32_t height, glm::uvec2 *pixel) const;
+    // solid angle density of the camera ray directions
+    float Pdf(glm::vec3 dir) const;
+    // importance
+    float We(glm::vec3 dir) const;
+    // angle a pixel spans at the image centre
+    float PixelSpread(uint32_t width, uint32_t height) const;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "span.h"
+
+struct Vertex;
+
+// The vertices of one submesh in 16 bytes each instead of 32. Positions are quantized
+// to 21 bits per axis within the submesh's bounds, in a stream of their own that
+// intersection tests and the kd-tree build read. Normals are octahedral, two 16 bit
+// components, and texture coordinates 16 bits each within the submesh's uv bounds; they
+// are decoded for the final hit only.
+class CompactVertices
+{
+    struct Attributes
+    {
+        uint32_t normal_;
+        uint16_t uv_[2];
+    };
+
+    glm::vec3 origin_, scale_;
+    glm::vec2 uv_origin_, uv_scale_;
+    std::vector<uint64_t> positions_;
+    std::vector<Attributes> attributes_;
+
+  public:
+    CompactVertices() = default;
+    explicit CompactVertices(Span<const Vertex> vertices);
+
+    bool Empty() const { return positions_.empty(); }
+    size_t Size() const { return positions_.size(); }
+    size_t Bytes() const
+    {
+        return positions_.size() * (sizeof(uint64_t) + sizeof(Attributes));
+    }
+
+    glm::vec3 Position(uint32_t i) const
+    {
+        uint64_t q = positions_[i];
+        return origin_ + glm::vec3(float(q & 0x1fffff), float(q >> 21 & 0x1fffff),
+                                   float(q >> 42 & 0x1fffff)) *
+                             scale_;
+    }
+
+    Vertex Decode(uint32_t i) const;
+};
+
+// Where the kd-tree and the intersection tests read vertex positions from: the full
+// precision vertices, or the quantized stream of CompactVertices.
+class PositionStream
+{
+    const Vertex *vertices_ = nullptr;
+    const CompactVertices *compact_ = nullptr;
+
+  public:
+    PositionStream(const Vertex *vertices, const CompactVertices *compact)
+        : vertices_(vertices), compact_(compact)
+    {
+    }
+
+    // one branch the predictor learns once, the mode is the same for the whole scene
+    inline glm::vec3 operator[](uint32_t i) const;
+};
@@ -0,0 +1,28 @@
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "film.h"
+#include "log.h"
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010). The radiance is divided
+// by the albedo before filtering, so textures stay sharp, and the normal and depth
+// AOVs stop the filter at geometric edges.
+class Denoiser
+{
+    const int iterations_;
+    const float sigma_color_;
+    const float sigma_normal_;
+    const float sigma_depth_;
+    const int threads_;
+
+    Log log_{"Denoiser"};
+
+  public:
+    Denoiser();
+
+    // returns the filtered radiance, one value per pixel in row-major order
+    std::vector<glm::vec3> Denoise(const Film &film, float iso) const;
+};
@@ -0,0 +1,78 @@
+
+#pragma once
+
+#include <atomic>
+#include <glm/glm.hpp>
+#include <inttypes.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log.h"
+
+// Auxiliary data of the first surface a camera ray hits, used to guide denoising.
+struct PixelAOV
+{
+    glm::vec3 albedo_;
+    glm::vec3 normal_;
+    float depth_;
+};
+
+// HDR accumulation buffer. Keeps per-pixel radiance sums and sample counts so the
+// picture can be refined in several passes and read out at any moment.
+class Film
+{
+    uint32_t rx_, ry_;
+
+    std::vector<glm::vec3> radiance_sum_;
+    std::vector<uint32_t> sample_count_;
+
+    std::vector<glm::vec3> albedo_sum_;
+    std::vector<glm::vec3> normal_sum_;
+    std::vector<float> depth_sum_;
+
+    // Radiance splatted onto the film from elsewhere, e.g. by light tracing, as
+    // r, g, b triples. Any thread may add to any pixel.
+    std::unique_ptr<std::atomic<float>[]> splat_sum_;
+
+    // sampler seeds of all the renders accumulated into this film
+    std::vector<uint32_t> seeds_;
+
+    Log log_{"Film"};
+
+  public:
+    Film(uint32_t rx, uint32_t ry);
+
+    void Clear();
+
+    // Only one thread may write a given pixel at a time.
+    void AddSamples(uint32_t x, uint32_t y, glm::vec3 radiance_sum, uint32_t samples);
+    // AOV sums go along the radiance sums, there is one AOV per sample
+    void AddAOVs(uint32_t x, uint32_t y, const PixelAOV &aov_sum);
+    // Thread safe, lock free. Splats are averaged over the samples of the pixel, so
+    // the estimate is right once all the pixels have the same sample count.
+    void AddSplat(uint32_t x, uint32_t y, glm::vec3 radiance);
+
+    uint32_t GetSampleCount(uint32_t x, uint32_t y) const;
+    glm::vec3 GetPixel(uint32_t x, uint32_t y) const;
+    PixelAOV GetAOV(uint32_t x, uint32_t y) const;
+
+    uint32_t GetWidth() const;
+    uint32_t GetHeight() const;
+
+    void AddSeed(uint32_t seed);
+    const std::vector<uint32_t> &GetSeeds() const;
+
+    // Sums an independent render of the same job into this one. Returns false (and
+    // leaves the film untouched) if the renders share a seed.
+    bool Merge(const Film &other);
+
+    void SaveCheckpoint(const std::string &path) const;
+    static Film LoadCheckpoint(const std::string &path);
+
+    // Writes the radiance along with albedo, normal (N) and depth (Z) layers. If a
+    // denoised image is given it becomes the main layer and the raw radiance is kept
+    // in the "noisy" one.
+    void WriteEXR(const std::string &path, float iso,
+                  const std::vector<glm::vec3> &denoised = {}) const;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "mesh.h"
+
+struct PreprocessingReport
+{
+    // merged into another vertex
+    size_t welded_vertices_ = 0;
+    size_t degenerate_triangles_ = 0;
+    size_t duplicate_triangles_ = 0;
+    // left without triangles, mostly by the triangles dropped
+    size_t unused_vertices_ = 0;
+
+    PreprocessingReport &operator+=(const PreprocessingReport &other);
+};
+
+// Cleans up an imported object before the acceleration structure is built over it:
+//  - welds vertices closer than tolerance times the diagonal of the object's bounds,
+//    if their normals and texture coordinates agree too, 0 welds none
+//  - drops triangles of zero area and triangles repeating others' vertices
+//  - orders the triangles along a Morton curve through their centroids and numbers the
+//    vertices in their order of first use, so that triangles close in space are close
+//    in memory, for the kd-tree build and traversal alike
+PreprocessingReport PreprocessGeometry(std::vector<Vertex> *vertices,
+                                       std::vector<glm::u32> *indices, float tolerance);
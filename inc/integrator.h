@@ -0,0 +1,58 @@
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <glm/glm.hpp>
+#include <memory>
+
+#include "film.h"
+#include "log.h"
+#include "raycaster.h"
+#include "sampler.h"
+#include "scene.h"
+
+// Light transport algorithm estimating the radiance along camera rays. All integrators
+// share the ray caster of the view, so the kd-tree is built only once.
+class Integrator
+{
+  protected:
+    const Scene scene_;
+    const RayCaster &raycaster_;
+
+    // resolves the material inputs of a hit, done once per hit; footprint is the width of
+    // the ray on the surface, for texture filtering
+    SurfaceInteraction Interact(const TriangleIntersection &intersection,
+                                const TriangleIndices &surface,
+                                float footprint = 0.0f) const;
+
+    // fills the AOV with the data of the given camera ray hit
+    void RecordAOV(PixelAOV *aov, glm::vec3 dir, const SurfaceInteraction &si,
+                   float dist) const;
+
+  public:
+    Integrator(const Scene &scene, const RayCaster &raycaster);
+
+    // Called when a picture starts, before its first pass. The film stays valid until
+    // the picture is done, integrators may splat onto it.
+    virtual void SetCamera(glm::vec3 camera_pos, glm::mat4 inv_mvp, Film &film);
+
+    // Called before every rendering pass, passes are numbered from 0. Trace must not
+    // be running meanwhile.
+    virtual void StartPass(uint32_t pass);
+
+    // aov, if given, receives the data of the first surface hit; pixel, if given, is the
+    // film pixel the ray is traced for, it keys what integrators keep per pixel
+    virtual glm::vec3 Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                            PixelAOV *aov = nullptr,
+                            const glm::uvec2 *pixel = nullptr) const = 0;
+
+    // whether Trace splats onto other pixels of the film than the one it traces for
+    virtual bool Splats() const { return false; }
+
+    boost::optional<int> DebugTrace(glm::vec3 camera_pos, glm::vec3 dir) const;
+
+    virtual ~Integrator() = default;
+};
+
+// Creates the integrator chosen by the "integrator" option.
+std::unique_ptr<Integrator> MakeIntegrator(const Scene &scene, const RayCaster &raycaster);
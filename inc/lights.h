@@ -1,14 +1,36 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "material.h"
 
+// Constant sky, or a lat-long environment map ("sky_map" option) with +y up. The map
+// is importance sampled proportionally to luminance times sin(theta).
 class Skybox
 {
     glm::vec3 radiance_;
 
+    uint32_t width_, height_;
+    // rows from the zenith down, empty for the constant sky
+    std::vector<glm::vec3> map_;
+    // running sums of the sampling weights, of whole rows and within every row
+    std::vector<float> row_cdf_;
+    std::vector<float> column_cdf_;
+
+    void LoadMap(const std::string &path, float scale);
+    void BuildDistribution();
+    uint32_t Texel(glm::vec3 dir) const;
+
   public:
     Skybox();
+
+    bool HasMap() const;
     glm::vec3 Sample(glm::vec3 dir) const;
+
+    // pdf receives the solid angle density, 0 if the map is black
+    glm::vec3 SampleDirection(glm::vec2 u, float *pdf) const;
+    float Pdf(glm::vec3 dir) const;
 };
 
 class PointLight
@@ -27,8 +49,26 @@ class AreaLight
   public:
     AreaLight(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, const Material &mat);
     float GetArea() const;
-    float GetNormal() const;
+    // unit normal, the winding of the triangle decides the side
+    glm::vec3 GetNormal() const;
+    glm::vec3 GetEmission() const;
 
     // first term is source position, the second one is radiance
     std::pair<glm::vec3, glm::vec3> Sample(glm::vec3 target, Sampler &sampler) const;
+};
+
+// Picks area lights proportionally to their power.
+class LightDistribution
+{
+    std::vector<float> cdf_;
+
+  public:
+    LightDistribution(const std::vector<AreaLight> &lights);
+
+    bool Empty() const;
+
+    // returns the light index, pdf receives the probability of picking it
+    uint32_t Sample(float u, float *pdf) const;
+    // density, per unit area, of picking a point on a light with the given emission
+    float AreaPdf(glm::vec3 emission) const;
 };
\ No newline at end of file
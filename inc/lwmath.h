@@ -1,9 +1,22 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace lwmath
 {
 
 float lerp(float t, float v1, float v2);
 
+// 64 bit finalizer with full avalanche, for hashing keys and counters
+inline uint64_t mix64(uint64_t v)
+{
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ull;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= v >> 33;
+    return v;
+}
+
 } // namespace lwmath
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory map of a whole file. The OS pages it in on access and shares the
+// pages with every process mapping the same file.
+class MappedFile
+{
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+
+  public:
+    MappedFile() = default;
+    // maps nothing if the file can't be opened, see IsOpen
+    explicit MappedFile(const std::string &path);
+    MappedFile(MappedFile &&other);
+    MappedFile &operator=(MappedFile &&other);
+    MappedFile(const MappedFile &) = delete;
+    void operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    bool IsOpen() const { return data_ != nullptr; }
+    const char *Data() const { return data_; }
+    size_t Size() const { return size_; }
+};
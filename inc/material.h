@@ -9,33 +9,18 @@
 #include <memory>
 #include <vector>
 
+#include "material_table.h"
 #include "renderable.h"
 #include "texture.h"
-
-struct Vertex;
+#include "texture_manager.h"
 
 class Material
 {
   public:
-    struct Reflection
-    {
-        glm::vec3 radiance_;
-        float pdf_;
-        glm::vec3 dir_;
-    };
-
-    virtual glm::vec3 BRDF(glm::vec3 from, glm::vec3 p, glm::vec3 to, glm::vec3 normal,
-                           glm::vec3 barycentric, const Vertex &p1, const Vertex &p2,
-                           const Vertex &p3) const = 0;
-
-    virtual Reflection SampleF(glm::vec3 position, glm::vec3 normal, glm::vec3 in_dir,
-                               glm::vec3 barycentric, const Vertex &p1, const Vertex &p2,
-                               const Vertex &p3, Sampler &s) const = 0;
-
-    virtual Reflection SampleSpecular(glm::vec3 position, glm::vec3 normal,
-                                      glm::vec3 in_dir, glm::vec3 barycentric,
-                                      const Vertex &p1, const Vertex &p2,
-                                      const Vertex &p3, Sampler &s) const = 0;
+    // the reflection model, evaluated through MaterialTable
+    virtual MaterialRecord Record() const = 0;
+    // null if the material is not textured
+    virtual const Texture *DiffuseTexture() const = 0;
 
     virtual glm::vec3 Emission() const = 0;
     virtual bool IsEmissive() const = 0;
@@ -48,9 +33,23 @@ class Material
     virtual ~Material() = default;
 };
 
+// The parameters MaterialFromAssimp takes from an Assimp material, as stored by the
+// scene cache
+struct MaterialDescription
+{
+    glm::vec3 diffuse_;
+    glm::vec3 reflective_;
+    // black if the material has none
+    glm::vec3 specular_;
+    glm::vec3 emission_;
+    // full path of the diffuse texture, empty if there is none
+    std::string texture_;
+};
+
 class MaterialFromAssimp : public Material
 {
-    std::unique_ptr<Texture> texture_;
+    // owned by the mesh's TextureManager
+    Texture *texture_;
     glm::vec3 diffuse_color_;
     glm::vec3 reflective_color_;
     boost::optional<glm::vec3> specular_color_;
@@ -59,19 +58,13 @@ class MaterialFromAssimp : public Material
     bool texture_used_;
 
   public:
-    MaterialFromAssimp(aiMaterial *mat, std::string dir);
-
-    glm::vec3 BRDF(glm::vec3 from, glm::vec3 p, glm::vec3 to, glm::vec3 normal,
-                   glm::vec3 barycentric, const Vertex &p1, const Vertex &p2,
-                   const Vertex &p3) const override;
+    MaterialFromAssimp(const MaterialDescription &description, TextureManager &textures);
 
-    Reflection SampleF(glm::vec3 position, glm::vec3 normal, glm::vec3 in_dir,
-                       glm::vec3 barycentric, const Vertex &p1, const Vertex &p2,
-                       const Vertex &p3, Sampler &s) const override;
+    // texture paths are relative to dir in Assimp materials
+    static MaterialDescription Describe(aiMaterial *material, const std::string &dir);
 
-    Reflection SampleSpecular(glm::vec3 position, glm::vec3 normal, glm::vec3 in_dir,
-                              glm::vec3 barycentric, const Vertex &p1, const Vertex &p2,
-                              const Vertex &p3, Sampler &s) const override;
+    MaterialRecord Record() const override;
+    const Texture *DiffuseTexture() const override;
 
     glm::vec3 Emission() const override;
 
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <type_traits>
+#include <vector>
+
+#include "exceptions.h"
+#include "sampler.h"
+
+struct Vertex;
+class Texture;
+
+// The closed set of reflection models. Kernels are templates on the kind, so a stage
+// shading many hits of one kind resolves the model once and inlines the rest.
+enum class BSDFKind : uint8_t
+{
+    Lambertian,
+    // Lambertian plus a Phong lobe
+    Phong
+};
+
+// Flat description of a material, everything the kernels read but the texture.
+struct MaterialRecord
+{
+    // diffuse colour, the texel multiplies it
+    glm::vec3 albedo_;
+    // weights of the Phong lobe and of the mirror lobe, black if there is none
+    glm::vec3 glossy_;
+    glm::vec3 specular_;
+    glm::vec3 emission_;
+    // scales the diffuse lobe, see the material_parameter_factor option
+    float parameter_correction_;
+    // index into the textures of the table, -1 for none
+    int32_t texture_;
+    BSDFKind kind_;
+    bool has_specular_;
+    bool emissive_;
+};
+
+// The direction independent part of a surface hit, resolved once by
+// MaterialTable::Interact so that every light sample and bounce leaving the hit only
+// evaluates the terms depending on the directions.
+struct SurfaceInteraction
+{
+    glm::vec3 position_;
+    // unit geometric normal, on either side of the surface
+    glm::vec3 normal_;
+    // unit interpolated vertex normal
+    glm::vec3 shading_normal_;
+    glm::vec3 barycentric_;
+    glm::vec2 uv_;
+
+    // diffuse reflectance, texture included
+    glm::vec3 albedo_;
+    // lobe weights of the BRDF
+    glm::vec3 diffuse_;
+    glm::vec3 glossy_;
+
+    BSDFKind kind_;
+    const MaterialRecord *record_;
+};
+
+struct BSDFSample
+{
+    glm::vec3 radiance_;
+    float pdf_;
+    glm::vec3 dir_;
+};
+
+// Materials of a mesh by object id, in one array of records.
+class MaterialTable
+{
+    std::vector<MaterialRecord> records_;
+    std::vector<const Texture *> textures_;
+    // record of every object
+    std::vector<uint32_t> object_records_;
+
+  public:
+    // texture may be null, it has to outlive the table
+    uint32_t AddMaterial(MaterialRecord record, const Texture *texture);
+    void AddObject(uint32_t record);
+
+    const MaterialRecord &GetRecord(uint32_t object_id) const
+    {
+        return records_[object_records_[object_id]];
+    }
+
+    // footprint is the width of the ray's footprint on the surface, it selects the MIP
+    // level of the texture; 0 reads the nearest full resolution texel
+    SurfaceInteraction Interact(uint32_t object_id, glm::vec3 position, glm::vec3 normal,
+                                glm::vec3 barycentric, const Vertex &p1, const Vertex &p2,
+                                const Vertex &p3, float footprint = 0.0f) const;
+
+    size_t Size() const { return records_.size(); }
+};
+
+// Calls f with std::integral_constant<BSDFKind, kind>, for the kernels to be
+// instantiated once per kind instead of branching per evaluation.
+template <typename F> auto DispatchBSDF(BSDFKind kind, F &&f)
+{
+    switch (kind)
+    {
+    case BSDFKind::Phong:
+        return f(std::integral_constant<BSDFKind, BSDFKind::Phong>());
+    case BSDFKind::Lambertian:
+    default:
+        return f(std::integral_constant<BSDFKind, BSDFKind::Lambertian>());
+    }
+}
+
+// BRDF times pi for light arriving from the point from and leaving towards to
+template <BSDFKind KIND>
+inline glm::vec3 EvaluateBSDF(const SurfaceInteraction &si, glm::vec3 from, glm::vec3 to)
+{
+    if (KIND == BSDFKind::Lambertian)
+        return si.diffuse_;
+
+    glm::vec3 surface_to_source = from - si.position_;
+    glm::vec3 specular_dir =
+        2.0f * glm::dot(si.normal_, surface_to_source) * si.normal_ - surface_to_source;
+
+    glm::vec3 surface_to_target = to - si.position_;
+    float glossy_term =
+        std::max(0.0f, glm::dot(surface_to_target, specular_dir) /
+                           glm::length(specular_dir) / glm::length(surface_to_target));
+
+    STRONG_ASSERT(glossy_term <= 1.01f)
+    return std::pow(glossy_term, 15.0f) * si.glossy_ + si.diffuse_;
+}
+
+inline glm::vec3 EvaluateBSDF(const SurfaceInteraction &si, glm::vec3 from, glm::vec3 to)
+{
+    return DispatchBSDF(si.kind_, [&](auto kind) {
+        return EvaluateBSDF<decltype(kind)::value>(si, from, to);
+    });
+}
+
+// uniform over the hemisphere of the normal, in_dir is the direction the path arrived in
+inline BSDFSample SampleBSDF(const SurfaceInteraction &si, glm::vec3 in_dir, Sampler &s)
+{
+    auto dir = s.SampleDirection(si.normal_);
+
+    return {EvaluateBSDF(si, si.position_ + in_dir, si.position_ + dir),
+            1.0f / (2.0f * glm::pi<float>()), dir};
+}
+
+// solid angle density of SampleBSDF
+inline float BSDFPdf(const SurfaceInteraction &si, glm::vec3, glm::vec3 out_dir)
+{
+    return glm::dot(si.normal_, out_dir) > 0.0f ? 1.0f / (2.0f * glm::pi<float>()) : 0.0f;
+}
+
+// the mirror lobe, only for materials having one
+inline BSDFSample SampleSpecularBSDF(const SurfaceInteraction &si, glm::vec3 in_dir)
+{
+    glm::vec3 specular_dir = 2.0f * glm::dot(si.normal_, -in_dir) * si.normal_ + in_dir;
+
+    return {si.record_->specular_, 1.0f, specular_dir};
+}
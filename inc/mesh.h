@@ -3,10 +3,13 @@
 
 #include <string>
 
+#include "compact_vertices.h"
 #include "lights.h"
 #include "log.h"
+#include "mapped_file.h"
 #include "material.h"
 #include "renderable.h"
+#include "span.h"
 #include "texture.h"
 
 class Scene;
@@ -18,13 +21,53 @@ struct Vertex
     glm::vec3 norm_;
 };
 
+inline glm::vec3 PositionStream::operator[](uint32_t i) const
+{
+    return compact_ ? compact_->Position(i) : vertices_[i].pos_;
+}
+
+// What a Mesh is built from: the imported scene after its post-processing, or the
+// scene cache holding it
+struct SceneDescription
+{
+    struct Object
+    {
+        uint32_t material_;
+        Span<const Vertex> vertices_;
+        Span<const glm::u32> indices_;
+    };
+
+    // an object drawn by the OpenGL preview, with the transforms of its node and the
+    // node's parents applied
+    struct Draw
+    {
+        glm::mat4 transform_;
+        uint32_t object_;
+    };
+
+    std::vector<MaterialDescription> materials_;
+    std::vector<Object> objects_;
+    std::vector<Draw> draws_;
+    // the tolerance PreprocessGeometry welded with, negative if it didn't run
+    float weld_tolerance_ = -1.0f;
+
+    // What the objects' arrays are in: the mapped scene cache, or the arrays of the
+    // import when there is no cache. Moving the description keeps them in place.
+    MappedFile file_;
+    std::vector<std::vector<Vertex>> imported_vertices_;
+    std::vector<std::vector<glm::u32>> imported_indices_;
+};
+
 class Mesh : public Renderable
 {
   public:
     struct MeshEntry
     {
-        MeshEntry(std::vector<Vertex> &&Vertices, std::vector<glm::u32> &&Indices,
-                  Material &mat);
+        // compact replaces the full precision vertices by CompactVertices
+        MeshEntry(Span<const Vertex> vertices, Span<const glm::u32> indices,
+                  Material &mat, bool compact);
+        // moves the compact vertices instead of copying them when the submeshes grow
+        MeshEntry(MeshEntry &&) = default;
 
         ~MeshEntry();
 
@@ -32,31 +75,57 @@ class Mesh : public Renderable
         GLuint VB;
         GLuint IB;
 
-        const std::vector<Vertex> vertices_;
-        const std::vector<glm::u32> indices_;
+        // vertex i, decoded from the compact vertices if there are
+        Vertex GetVertex(uint32_t i) const
+        {
+            return compact_.Empty() ? vertices_[i] : compact_.Decode(i);
+        }
+
+        // the positions either way, for the kd-tree and the intersection tests
+        PositionStream Positions() const
+        {
+            return PositionStream(vertices_.data(),
+                                  compact_.Empty() ? nullptr : &compact_);
+        }
+
+        // owned by the mesh's SceneDescription, empty with compact vertices
+        const Span<const Vertex> vertices_;
+        const Span<const glm::u32> indices_;
+        CompactVertices compact_;
         Material &material_;
     };
 
     Mesh(std::string filename, Scene &scene);
     virtual ~Mesh();
 
-    void RenderByOpenGL(OpenGLRenderingContext context, aiNode *node = nullptr) override;
+    void RenderByOpenGL(OpenGLRenderingContext context) override;
+    // Uploads the geometry and the textures. The geometry can be drawn once it is
+    // uploaded, the textures are white until theirs are.
     void SetupForOpenGL();
+    void SetupGeometryForOpenGL();
+    void SetupTexturesForOpenGL();
+    // until the textures the constructor started decoding are decoded
+    void WaitForTextures();
 
     std::vector<MeshEntry> submeshes_;
     Material &GetMaterial(uint32_t obj_index_);
+    // the same materials as flat records, indexed by object id
+    MaterialTable material_table_;
 
     glm::vec3 GetUpperBound();
     glm::vec3 GetLowerBound();
 
   private:
-    MeshEntry InitMesh(const aiMesh *mesh, std::vector<AreaLight> &lights,
-                       const Material &material);
+    SceneDescription Import(const std::string &filename, const std::string &dir);
+    MeshEntry InitMesh(const SceneDescription::Object &object,
+                       std::vector<AreaLight> &lights, bool compact);
 
-    const aiScene *scene_;
+    // the geometry of the submeshes, and the draws of the OpenGL preview
+    SceneDescription description_;
 
+    // outlives the materials referring to its textures
+    TextureManager textures_;
     std::vector<MaterialFromAssimp> materials_;
-    Assimp::Importer importer_;
     glm::vec3 lower_bound_;
     glm::vec3 upper_bound_;
 
@@ -0,0 +1,97 @@
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// Distribution over the sphere of directions, stored as a quadtree over the cylindrical
+// (cos theta, phi) square, which maps areas on the sphere to the same areas. Used both
+// to learn where light comes from (Record) and to sample from what has been learnt.
+class DirectionalDistribution
+{
+    struct Node
+    {
+        std::array<std::atomic<float>, 4> sum_;
+        // 0 marks a leaf quadrant, the root is never a child
+        std::array<uint32_t, 4> children_;
+
+        Node();
+        Node(const Node &other);
+        Node &operator=(const Node &other);
+    };
+
+    std::vector<Node> nodes_;
+
+    float Accumulate(uint32_t node_id);
+    // source_id is -1 where the source tree has no node
+    void RefineNode(uint32_t node_id, const DirectionalDistribution &source,
+                    int source_id, float energy, float total, float threshold, int depth);
+
+  public:
+    DirectionalDistribution();
+
+    // Thread safe. Only fills leaves, Accumulate the tree before reading it.
+    void Record(glm::vec3 dir, float value);
+    void Accumulate();
+
+    float Total() const;
+
+    glm::vec3 Sample(glm::vec2 u) const;
+    // solid angle density of Sample
+    float Pdf(glm::vec3 dir) const;
+
+    // Empty tree whose leaves hold about threshold of the energy of this one each.
+    DirectionalDistribution Refined(float threshold) const;
+};
+
+// Path guiding after Muller et al. 2017: a binary tree splitting the scene bounds
+// holds a directional distribution per region. Every pass trains fresh distributions
+// while sampling from the ones trained by the previous pass, and regions that saw
+// many samples are split.
+class GuidingField
+{
+  public:
+    struct Region
+    {
+        DirectionalDistribution sampling_;
+        DirectionalDistribution training_;
+        std::atomic<uint32_t> samples_;
+
+        Region();
+        Region(const Region &other);
+    };
+
+  private:
+    struct Node
+    {
+        uint8_t axis_;
+        // 0 marks a leaf, whose region is region_
+        uint32_t children_[2];
+        uint32_t region_;
+    };
+
+    const glm::vec3 lower_bound_, upper_bound_;
+    const uint32_t spatial_threshold_;
+    const float directional_threshold_;
+
+    std::vector<Node> nodes_;
+    std::vector<std::unique_ptr<Region>> regions_;
+
+  public:
+    // spatial_threshold - samples a region needs in the first pass to be split, it
+    //   grows with the square root of the pass budget
+    // directional_threshold - energy fraction kept in a directional leaf
+    GuidingField(glm::vec3 lower_bound, glm::vec3 upper_bound, uint32_t spatial_threshold,
+                 float directional_threshold);
+
+    void Reset();
+    // Makes what was recorded so far the sampling distribution. Nothing may be
+    // recorded meanwhile.
+    void Refine(uint32_t pass);
+
+    Region &GetRegion(glm::vec3 position) const;
+    size_t GetRegionCount() const;
+};
@@ -1,33 +1,86 @@
 #pragma once
 
+#include <algorithm>
 #include <boost/optional.hpp>
 #include <glm/glm.hpp>
 
+#include "camera.h"
 #include "config.h"
 #include "exceptions.h"
+#include "film.h"
+#include "integrator.h"
 #include "log.h"
+#include "path_guiding.h"
+#include "radiance_cache.h"
 #include "raycaster.h"
+#include "restir.h"
 #include "scene.h"
 
-class PathTracer
+// Footprint of a ray for texture filtering (Akenine-Moller et al. 2019, "Texture Level
+// of Detail Strategies for Real-Time Ray Tracing"): a cone whose width grows linearly
+// along the ray. The triangles are flat, so mirror bounces keep the spread angle. Rough
+// bounces send neighbouring paths apart by about the width of their lobe and widen it.
+struct RayCone
+{
+    float width_;
+    float spread_;
+
+    RayCone Propagate(float distance) const { return {width_ + spread_ * distance, spread_}; }
+    RayCone Scatter(float lobe_spread) const
+    {
+        return {width_, std::max(spread_, lobe_spread)};
+    }
+};
+
+class PathTracer : public Integrator
 {
     Log log_{"PathTracer"};
 
+    // Returns the radiance arriving at origin from dir, the caller applies the
+    // throughput of the path so far.
     glm::vec3 Trace(glm::vec3 origin, glm::vec3 dir, bool include_emission,
-                    glm::vec3 beta, Sampler &sampler, int32_t depth) const;
+                    Sampler &sampler, int32_t depth, glm::vec3 camera_pos, RayCone cone,
+                    PixelAOV *aov = nullptr, const glm::uvec2 *pixel = nullptr) const;
+
+    // Direct lighting of a camera ray hit from the resampled light candidate of the
+    // pixel, one shadow ray however many lights there are.
+    glm::vec3 ResampledDirectLight(glm::uvec2 pixel, glm::vec3 origin,
+                                   const TriangleIntersection &intersection,
+                                   const SurfaceInteraction &si, Sampler &sampler) const;
 
     // Forced Incomming Light FIXME
     glm::vec3 FIL(boost::optional<glm::vec3> light) const;
 
-    const Scene scene_;
-    const RayCaster raycaster_;
     const int recursion_level_;
     const int max_reflections_;
     const float roulette_factor_;
 
+    // paths reaching this many bounces may end in the radiance cache
+    const int radiance_cache_depth_;
+    std::unique_ptr<RadianceCache> radiance_cache_;
+
+    // probability of sampling the guiding distribution instead of the material
+    const float guiding_fraction_;
+    std::unique_ptr<GuidingField> guiding_;
+
+    const LightDistribution lights_;
+    const int restir_candidates_;
+    const int restir_neighbors_;
+    const float restir_radius_;
+    const int restir_history_;
+    std::unique_ptr<ReservoirGrid> reservoirs_;
+
+    const bool mip_mapping_;
+    // of camera rays, 0 without MIP mapping
+    float pixel_spread_ = 0.0f;
+
   public:
-    PathTracer(const Scene &scene);
+    PathTracer(const Scene &scene, const RayCaster &raycaster);
+
+    void SetCamera(glm::vec3 camera_pos, glm::mat4 inv_mvp, Film &film) override;
+    void StartPass(uint32_t pass) override;
 
-    glm::vec3 Trace(glm::vec3 origin, glm::vec3 dir) const;
-    boost::optional<int> DebugTrace(glm::vec3 camera_pos, glm::vec3 dir) const;
-};
\ No newline at end of file
+    glm::vec3 Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                    PixelAOV *aov = nullptr,
+                    const glm::uvec2 *pixel = nullptr) const override;
+};
@@ -0,0 +1,126 @@
+
+#pragma once
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "integrator.h"
+#include "log.h"
+
+struct Photon
+{
+    enum Type : uint32_t
+    {
+        // first hit after leaving the light
+        Direct = 1,
+        // reached a surface through specular bounces only
+        Caustic = 2,
+        Indirect = 4
+    };
+
+    glm::vec3 position_;
+    glm::vec3 power_;
+    // direction of travel
+    glm::vec3 dir_;
+    uint32_t type_;
+};
+
+// Hashed uniform grid. Photons are sorted by the hash of their cell, so the photons of
+// one cell lie next to each other in memory.
+class PhotonGrid
+{
+    float cell_size_ = 1.0f;
+    uint32_t mask_ = 0;
+
+    std::vector<uint32_t> cell_start_;
+    std::vector<Photon> photons_;
+
+    glm::ivec3 Cell(glm::vec3 position) const;
+    uint32_t Hash(glm::ivec3 cell) const;
+
+  public:
+    // Lookups are meant for radii up to the given one.
+    void Build(std::vector<Photon> &&photons, float radius);
+
+    size_t Size() const;
+
+    // Calls callback(photon) for every photon closer than radius to position.
+    template <typename Callback>
+    void ForEachPhoton(glm::vec3 position, float radius, Callback callback) const
+    {
+        if (photons_.empty())
+            return;
+
+        glm::ivec3 low = Cell(position - glm::vec3(radius));
+        glm::ivec3 high = Cell(position + glm::vec3(radius));
+
+        // different cells may share a bucket, each bucket must be visited once
+        uint32_t visited[8];
+        int visited_no = 0;
+
+        for (int z = low.z; z <= high.z; z++)
+            for (int y = low.y; y <= high.y; y++)
+                for (int x = low.x; x <= high.x; x++)
+                {
+                    uint32_t bucket = Hash(glm::ivec3(x, y, z));
+                    if (std::find(visited, visited + visited_no, bucket) !=
+                        visited + visited_no)
+                        continue;
+                    if (visited_no < 8)
+                        visited[visited_no++] = bucket;
+
+                    for (uint32_t i = cell_start_[bucket]; i < cell_start_[bucket + 1]; i++)
+                    {
+                        glm::vec3 diff = photons_[i].position_ - position;
+                        if (glm::dot(diff, diff) < radius * radius)
+                            callback(photons_[i]);
+                    }
+                }
+    }
+};
+
+// Photon mapping (Jensen 1996) with the progressive radius reduction of Knaus and
+// Zwicker 2011: every pass shoots a fresh photon map with a smaller radius, and the
+// average of the passes converges to the right answer. Camera paths follow specular
+// bounces and stop at the first surface, where direct light is sampled explicitly and
+// the rest is read from the photon map, either directly or through final gathering.
+class PhotonMapper : public Integrator
+{
+    Log log_{"PhotonMapper"};
+
+    const int recursion_level_;
+    const uint32_t photons_per_pass_;
+    const float initial_radius_;
+    const float alpha_;
+    const int final_gather_rays_;
+    const int max_photon_bounces_;
+    const int threads_;
+    const uint32_t seed_;
+
+    const LightDistribution lights_;
+
+    PhotonGrid grid_;
+    float radius_;
+
+    std::vector<Photon> ShootPhotons(uint32_t first, uint32_t last, uint32_t pass) const;
+
+    glm::vec3 Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler, int32_t depth,
+                    PixelAOV *aov) const;
+
+    glm::vec3 DirectLight(glm::vec3 viewer, glm::vec3 normal, const SurfaceInteraction &si,
+                          Sampler &sampler) const;
+
+    // Radiance reflected towards the viewer by the photons of the given types.
+    glm::vec3 EstimateRadiance(glm::vec3 viewer, glm::vec3 normal,
+                               const SurfaceInteraction &si, uint32_t types) const;
+
+  public:
+    PhotonMapper(const Scene &scene, const RayCaster &raycaster);
+
+    void StartPass(uint32_t pass) override;
+
+    glm::vec3 Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                    PixelAOV *aov = nullptr,
+                    const glm::uvec2 *pixel = nullptr) const override;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "film.h"
+
+// The 8 bit ARGB picture of the ray tracer's preview window, saved as the PNG.
+class PreviewBuffer
+{
+    const uint32_t rx_, ry_;
+    std::vector<uint32_t> pixels_;
+
+  public:
+    PreviewBuffer(uint32_t rx, uint32_t ry);
+
+    // Only one thread may write a given pixel at a time.
+    void SetPixel(uint32_t x, uint32_t y, glm::vec3 radiance, float iso);
+    // Every pixel again from the film. Splats may land on pixels set before, after
+    // their own samples, only this brings them in.
+    void Update(const Film &film, float iso);
+
+    uint32_t GetPixel(uint32_t x, uint32_t y) const { return pixels_[y * rx_ + x]; }
+    const void *Data() const { return pixels_.data(); }
+    // bytes per row
+    int Pitch() const { return int(rx_ * sizeof(uint32_t)); }
+};
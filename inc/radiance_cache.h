@@ -0,0 +1,47 @@
+
+#pragma once
+
+#include <atomic>
+#include <boost/optional.hpp>
+#include <glm/glm.hpp>
+#include <memory>
+
+// World-space radiance cache: an open-addressed hash table keyed by the quantized
+// position and normal of path vertices. Cells grow with the distance from the camera,
+// so they cover about the same part of the picture everywhere. Any number of threads
+// may insert and look up at once, the table never locks.
+class RadianceCache
+{
+    struct Entry
+    {
+        // 0 marks a free slot
+        std::atomic<uint64_t> key_;
+        // fixed point radiance sums
+        std::atomic<uint64_t> sum_[3];
+        std::atomic<uint32_t> count_;
+    };
+
+    const uint32_t mask_;
+    const float min_cell_size_;
+    const float cell_angle_;
+    const uint32_t min_samples_;
+
+    std::unique_ptr<Entry[]> entries_;
+
+    uint64_t Key(glm::vec3 position, glm::vec3 normal, glm::vec3 camera_pos) const;
+
+  public:
+    // size_log2 - log2 of the slot count
+    // min_cell_size - cell size close to the camera
+    // cell_angle - cell size divided by the distance from the camera, far away
+    // min_samples - lookups of cells with fewer samples fail
+    RadianceCache(uint32_t size_log2, float min_cell_size, float cell_angle,
+                  uint32_t min_samples);
+
+    void Clear();
+
+    void Insert(glm::vec3 position, glm::vec3 normal, glm::vec3 camera_pos,
+                glm::vec3 radiance);
+    boost::optional<glm::vec3> Lookup(glm::vec3 position, glm::vec3 normal,
+                                      glm::vec3 camera_pos) const;
+};
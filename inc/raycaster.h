@@ -30,9 +30,10 @@ union KDElement {
 struct TriangleIndices
 {
     uint32_t t1_, t2_, t3_;
-    uint16_t object_id_;
+    // 32 bits cost nothing, the struct is padded to 16 bytes anyway
+    uint32_t object_id_;
 
-    TriangleIndices(uint32_t t1, uint32_t t2, uint32_t t3, uint16_t object_id)
+    TriangleIndices(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t object_id)
         : t1_(t1), t2_(t2), t3_(t3), object_id_(object_id)
     {
     }
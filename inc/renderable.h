@@ -29,6 +29,5 @@ struct OpenGLRenderingContext
 class Renderable
 {
   public:
-    virtual void RenderByOpenGL(OpenGLRenderingContext context,
-                                struct aiNode *node = nullptr) = 0;
+    virtual void RenderByOpenGL(OpenGLRenderingContext context) = 0;
 };
@@ -0,0 +1,64 @@
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// A point on an area light, with what is needed to shade with it anywhere.
+struct LightCandidate
+{
+    glm::vec3 position_;
+    glm::vec3 normal_;
+    glm::vec3 emission_;
+};
+
+// Weighted reservoir sampling (Chao 1982) of light candidates, the building block of
+// ReSTIR (Bitterli et al. 2020). The reservoir keeps one candidate out of count_ seen
+// ones, picked proportionally to the resampling weights.
+struct Reservoir
+{
+    LightCandidate sample_ = {};
+    float weight_sum_ = 0.0f;
+    // target density of the kept candidate at the owner's shading point
+    float target_pdf_ = 0.0f;
+    uint32_t count_ = 0;
+
+    // shading point the reservoir was built for
+    glm::vec3 normal_ = glm::vec3();
+    float depth_ = 0.0f;
+
+    // u is uniform in [0, 1), returns true if the candidate was kept
+    bool Update(const LightCandidate &candidate, float weight, float target_pdf, float u);
+    // Streams in the candidate of other, target_pdf is its density at this reservoir's
+    // shading point. Its history counts as at most max_count candidates.
+    bool Merge(const Reservoir &other, float target_pdf, float u, uint32_t max_count);
+
+    // the weight making target_pdf_ an estimator of the integrand, 0 if empty
+    float ContributionWeight() const;
+    // reusing candidates between too different shading points only adds noise
+    bool Compatible(glm::vec3 normal, float depth) const;
+};
+
+// One reservoir per pixel. The current reservoirs belong to the pixel being rendered,
+// the previous ones are a copy frozen at the start of the pass, so neighbours can be
+// read by any thread without locking.
+class ReservoirGrid
+{
+    uint32_t width_, height_;
+    std::vector<Reservoir> current_, previous_;
+
+  public:
+    ReservoirGrid();
+
+    void Resize(uint32_t width, uint32_t height);
+    void Clear();
+    // makes the reservoirs of the pass just rendered visible to Previous
+    void StartPass();
+
+    uint32_t GetWidth() const;
+    uint32_t GetHeight() const;
+
+    Reservoir &Current(uint32_t x, uint32_t y);
+    // nullptr outside of the image
+    const Reservoir *Previous(int x, int y) const;
+};
@@ -0,0 +1,11 @@
+
+#pragma once
+
+#include "build_config.h"
+
+// The table written by rgb2spec_gen at build time. Colours are indexed by their
+// brightest component (which one, then its value through RGB2SPEC_SCALE) and the other
+// two divided by it, every cell holds the coefficients of a SigmoidPolynomial.
+extern const float RGB2SPEC_SCALE[RGB2SPEC_RESOLUTION];
+extern const float RGB2SPEC_DATA[3 * RGB2SPEC_RESOLUTION * RGB2SPEC_RESOLUTION *
+                                 RGB2SPEC_RESOLUTION * 3];
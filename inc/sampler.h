@@ -2,18 +2,82 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#include <random>
+#include <memory>
+#include <vector>
 
+// Samplers hand out the sample vector of one camera sample dimension by dimension.
+// Dimensions are consumed in call order: the pixel jitter first, then, per path
+// vertex, the light positions, the sky direction, the BSDF direction and roulette.
 class Sampler
 {
-    std::random_device rd_;
-    std::mt19937 mt_;
-    std::uniform_real_distribution<float> dist_;
-
   public:
-    Sampler();
-    float Sample();
-    std::pair<float, float> SamplePair();
+    virtual void StartPixelSample(uint32_t x, uint32_t y, uint32_t sample_index) = 0;
+
+    virtual float Get1D() = 0;
+    virtual glm::vec2 Get2D() = 0;
+
     glm::vec3 SampleDirection();
     glm::vec3 SampleDirection(glm::vec3 normal);
-};
\ No newline at end of file
+    // cosine weighted around the normal, pdf = cos / pi
+    glm::vec3 SampleCosineDirection(glm::vec3 normal);
+
+    virtual ~Sampler() = default;
+};
+
+// Counter-based generator: every value is a pcg4d hash (Jarzynski & Olano 2020) of the
+// pixel, the seed, the sample index and the dimension, one lane each. Nothing to seed or
+// carry between samples, so renders are reproducible whatever the thread layout is.
+class RandomSampler : public Sampler
+{
+    // the hashed seed, lane of its own so that no seed and pixel pair repeats another;
+    // camera samples take its low half, light paths the high one
+    const uint64_t seed_hash_;
+    uint32_t stream_;
+    // x in the low 16 bits, y in the high ones, the pass for light paths
+    uint32_t pixel_, sample_index_, dimension_;
+
+  public:
+    RandomSampler(uint32_t seed);
+
+    void StartPixelSample(uint32_t x, uint32_t y, uint32_t sample_index) override;
+    // Light paths belong to no pixel: every path of a pass, e.g. the photons, is a
+    // sample index of its own, up to 2^32 of them.
+    void StartLightSample(uint32_t path, uint32_t pass);
+    float Get1D() override;
+    glm::vec2 Get2D() override;
+};
+
+// Every dimension (pair) is a separately shuffled and Owen-scrambled copy of the
+// first two Sobol dimensions, so each power-of-two prefix of a pixel's samples
+// stays stratified no matter how many samples the pixel gets in the end.
+class SobolSampler : public Sampler
+{
+    const uint32_t seed_;
+    uint32_t x_, y_, sample_index_, dimension_;
+
+  public:
+    SobolSampler(uint32_t seed);
+
+    void StartPixelSample(uint32_t x, uint32_t y, uint32_t sample_index) override;
+    float Get1D() override;
+    glm::vec2 Get2D() override;
+};
+
+// Progressive multi-jittered (0,2) points (Christensen et al. 2018), generated once
+// per process. Every dimension picks one of the tables and a random digital shift.
+class PMJ02Sampler : public Sampler
+{
+    const uint32_t seed_;
+    const std::vector<std::vector<glm::vec2>> &tables_;
+    uint32_t x_, y_, sample_index_, dimension_;
+
+  public:
+    PMJ02Sampler(uint32_t seed, uint32_t samples_per_pixel);
+
+    void StartPixelSample(uint32_t x, uint32_t y, uint32_t sample_index) override;
+    float Get1D() override;
+    glm::vec2 Get2D() override;
+};
+
+// Creates the sampler chosen by the "sampler" option.
+std::unique_ptr<Sampler> MakeSampler(uint32_t seed);
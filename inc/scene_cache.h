@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include "mesh.h"
+
+// Binary copy of an imported scene next to its source file, image.obj.lwsc for
+// image.obj, so that later runs map it instead of importing the source again. It is
+// keyed by the size, modification time and hash of the source: a copy with a new
+// modification time is still recognised by its hash. The material libraries an .obj
+// names in mtllib lines are keyed by their hash.
+
+// false if the cache is missing, stale or damaged; texture paths are relative to dir
+// in the file
+bool ReadSceneCache(const std::string &path, const std::string &source,
+                    const std::string &dir, SceneDescription *scene);
+bool WriteSceneCache(const std::string &path, const std::string &source,
+                     const std::string &dir, const SceneDescription &scene);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// Non-owning view of a contiguous array, the std::span of C++20 in short. Whatever
+// owns the elements, a container or a file mapping, has to outlive the span.
+template <typename T> class Span
+{
+    T *data_ = nullptr;
+    size_t size_ = 0;
+
+  public:
+    Span() = default;
+    Span(T *data, size_t size) : data_(data), size_(size) {}
+    // any container with data() and size(), e.g. a std::vector
+    template <typename C>
+    Span(C &container) : data_(container.data()), size_(container.size())
+    {
+    }
+
+    T *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T &operator[](size_t i) const { return data_[i]; }
+    T *begin() const { return data_; }
+    T *end() const { return data_ + size_; }
+};
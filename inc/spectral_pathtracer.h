@@ -0,0 +1,47 @@
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "integrator.h"
+#include "log.h"
+#include "spectrum.h"
+
+// Unidirectional path tracer carrying a packet of hero wavelengths instead of RGB. The
+// colours of materials and lights are upsampled at the sampled wavelengths, and the
+// result goes through CIE XYZ back to RGB before it reaches the film. Light and
+// material samples are combined with the power heuristic.
+class SpectralPathTracer : public Integrator
+{
+    struct ShadingPoint
+    {
+        glm::vec3 position_;
+        // unit geometric normal, on the side of the viewer
+        glm::vec3 normal_;
+        glm::vec3 viewer_;
+        SurfaceInteraction si_;
+    };
+
+    Log log_{"SpectralPathTracer"};
+
+    const int max_depth_;
+    const LightDistribution lights_;
+
+    SampledSpectrum F(const ShadingPoint &point, glm::vec3 dir,
+                      const HeroWavelengths &lambda) const;
+    // solid angle density of the diffuse bounce
+    float Pdf(const ShadingPoint &point, glm::vec3 dir) const;
+
+    // next event estimation, towards a point on an area light and towards the sky map
+    SampledSpectrum SampleLight(const ShadingPoint &point, const HeroWavelengths &lambda,
+                                Sampler &sampler) const;
+    SampledSpectrum SampleSky(const ShadingPoint &point, const HeroWavelengths &lambda,
+                              Sampler &sampler) const;
+
+  public:
+    SpectralPathTracer(const Scene &scene, const RayCaster &raycaster);
+
+    glm::vec3 Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                    PixelAOV *aov = nullptr,
+                    const glm::uvec2 *pixel = nullptr) const override;
+};
@@ -1,8 +1,9 @@
-
 #pragma once
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <glm/glm.hpp>
 #include <vector>
 
 #include "build_config.h"
@@ -10,12 +11,13 @@
 
 template <int N_SAMPLES> class CoefficientSpectrum
 {
-    std::array<float, N_SAMPLES> samples_;
+    // aligned so a packet of 4 or 8 samples fills whole SIMD registers
+    alignas(16) std::array<float, N_SAMPLES> samples_;
 
   public:
     CoefficientSpectrum(float value = 0.0f)
     {
-        for (int i = 0; i < samples_; ++i)
+        for (int i = 0; i < N_SAMPLES; ++i)
             samples_[i] = value;
     }
 
@@ -30,11 +32,52 @@ template <int N_SAMPLES> class CoefficientSpectrum
     {
         CoefficientSpectrum ret;
         for (int i = 0; i < N_SAMPLES; ++i)
-            ret.c[i] = samples_[i] + rhs.samples_[i];
+            ret.samples_[i] = samples_[i] + rhs.samples_[i];
+        return ret;
+    }
+
+    CoefficientSpectrum &operator*=(const CoefficientSpectrum &rhs)
+    {
+        for (int i = 0; i < N_SAMPLES; ++i)
+            samples_[i] *= rhs.samples_[i];
+        return *this;
+    }
+
+    CoefficientSpectrum operator*(const CoefficientSpectrum &rhs) const
+    {
+        CoefficientSpectrum ret;
+        for (int i = 0; i < N_SAMPLES; ++i)
+            ret.samples_[i] = samples_[i] * rhs.samples_[i];
         return ret;
     }
 
+    CoefficientSpectrum &operator*=(float rhs)
+    {
+        for (int i = 0; i < N_SAMPLES; ++i)
+            samples_[i] *= rhs;
+        return *this;
+    }
+
+    CoefficientSpectrum operator*(float rhs) const
+    {
+        CoefficientSpectrum ret;
+        for (int i = 0; i < N_SAMPLES; ++i)
+            ret.samples_[i] = samples_[i] * rhs;
+        return ret;
+    }
+
+    float MaxValue() const { return *std::max_element(samples_.begin(), samples_.end()); }
+
+    bool IsBlack() const
+    {
+        for (int i = 0; i < N_SAMPLES; ++i)
+            if (samples_[i] != 0.0f)
+                return false;
+        return true;
+    }
+
     float &operator[](int i) { return samples_[i]; }
+    float operator[](int i) const { return samples_[i]; }
 };
 
 struct LightSample
@@ -51,4 +94,84 @@ class VisibleSpectrum : CoefficientSpectrum<SPECTRUM_N_SAMPLES>
 
   public:
     VisibleSpectrum(float initial);
-};
\ No newline at end of file
+};
+
+// Hero wavelength sampling (Wilkie et al. 2014): one wavelength uniform over the
+// visible range, the others at equal offsets from it, wrapped around the range.
+template <int N_WAVELENGTHS> class SampledWavelengths
+{
+    std::array<float, N_WAVELENGTHS> lambda_;
+
+  public:
+    // u is uniform in [0, 1)
+    explicit SampledWavelengths(float u)
+    {
+        const float range = float(SPECTRUM_LAMBDA_END - SPECTRUM_LAMBDA_START);
+        for (int i = 0; i < N_WAVELENGTHS; ++i)
+        {
+            float offset = std::fmod(u + float(i) / float(N_WAVELENGTHS), 1.0f);
+            lambda_[i] = float(SPECTRUM_LAMBDA_START) + offset * range;
+        }
+    }
+
+    float operator[](int i) const { return lambda_[i]; }
+
+    // density of every single wavelength
+    float Pdf() const { return 1.0f / float(SPECTRUM_LAMBDA_END - SPECTRUM_LAMBDA_START); }
+};
+
+// the spectral packet every path carries, its width is a build option
+using SampledSpectrum = CoefficientSpectrum<SPECTRUM_HERO_WAVELENGTHS>;
+using HeroWavelengths = SampledWavelengths<SPECTRUM_HERO_WAVELENGTHS>;
+
+// CIE 1931 colour matching functions, the multi-lobe fit of Wyman et al. 2013
+glm::vec3 CIEMatching(float lambda);
+// linear sRGB, balanced so that a flat spectrum of 1 gives white (1, 1, 1)
+glm::vec3 XYZToRGB(glm::vec3 xyz);
+
+// Smooth spectrum bounded by [0, 1] (Jakob & Hanika 2019): a sigmoid of a quadratic
+// polynomial in the wavelength, rescaled so the visible range maps onto [0, 1].
+struct SigmoidPolynomial
+{
+    float c0_, c1_, c2_;
+
+    float operator()(float lambda) const
+    {
+        float t = (lambda - float(SPECTRUM_LAMBDA_START)) /
+                  float(SPECTRUM_LAMBDA_END - SPECTRUM_LAMBDA_START);
+        float x = (c0_ * t + c1_) * t + c2_;
+        if (std::isinf(x))
+            return x > 0.0f ? 1.0f : 0.0f;
+        return 0.5f + x / (2.0f * std::sqrt(1.0f + x * x));
+    }
+};
+
+// trilinear lookup in the table generated at build time, rgb is clamped to [0, 1]
+SigmoidPolynomial RGBToSigmoidPolynomial(glm::vec3 rgb);
+
+template <int N>
+CoefficientSpectrum<N> RGBToSpectrum(glm::vec3 rgb, const SampledWavelengths<N> &lambda)
+{
+    // brighter colours, i.e. lights, are scaled copies of a bounded spectrum
+    rgb = glm::max(rgb, glm::vec3(0.0f));
+    float brightest = std::max(rgb.x, std::max(rgb.y, rgb.z));
+    float scale = brightest > 1.0f ? 2.0f * brightest : 1.0f;
+
+    SigmoidPolynomial polynomial = RGBToSigmoidPolynomial(rgb / scale);
+    CoefficientSpectrum<N> ret;
+    for (int i = 0; i < N; ++i)
+        ret[i] = scale * polynomial(lambda[i]);
+    return ret;
+}
+
+// Monte Carlo estimate of the colour of the spectrum from its samples
+template <int N>
+glm::vec3 SpectrumToRGB(const CoefficientSpectrum<N> &spectrum,
+                        const SampledWavelengths<N> &lambda)
+{
+    glm::vec3 xyz = glm::vec3();
+    for (int i = 0; i < N; ++i)
+        xyz += CIEMatching(lambda[i]) * spectrum[i];
+
+    return XYZToRGB(xyz / (float(N) * lambda.Pdf()));
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+
+// Tasks running on a pool of threads, each as soon as the tasks it depends on are done.
+// Tasks marked for the main thread, OpenGL calls among them, run in Wait instead. The
+// graph records when every task ran, for the timing breakdown of LogTimings.
+class TaskGraph
+{
+  public:
+    using Task = uint32_t;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State
+    {
+        Waiting,
+        Ready,
+        Running,
+        Done
+    };
+
+    struct Node
+    {
+        std::string name_;
+        std::function<void()> work_;
+        bool main_thread_;
+        State state_;
+        // dependencies not done yet
+        size_t remaining_;
+        std::vector<Task> dependencies_, dependents_;
+        // of the task or of the dependency which failed, the task didn't run then
+        std::exception_ptr error_;
+        Clock::time_point start_, end_;
+    };
+
+    const Clock::time_point created_ = Clock::now();
+
+    std::vector<Node> nodes_;
+    // ready tasks the workers take, in the order they got ready
+    std::deque<Task> ready_;
+    bool stopping_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<std::thread> workers_;
+
+    Log log_{"TaskGraph"};
+
+    void Run(Task task, std::unique_lock<std::mutex> &lock);
+    void Finish(Task task, std::exception_ptr error);
+    // a ready main thread task among the task and those it depends on, transitively
+    bool NextMainThreadTask(Task task, Task *next) const;
+
+  public:
+    // the timings count from here
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph &) = delete;
+    void operator=(const TaskGraph &) = delete;
+    // waits for the tasks running, those not started yet don't run
+    ~TaskGraph();
+
+    // Dependencies are tasks added before. Tasks may be added while others run.
+    Task Add(const std::string &name, std::function<void()> work,
+             const std::vector<Task> &dependencies = {}, bool main_thread = false);
+
+    // starts the pool, the tasks added so far may run from now on
+    void Start(size_t threads);
+
+    bool Done(Task task) const;
+
+    // Waits until the task is done, running it and the main thread tasks it depends on
+    // on this thread. Rethrows what the task, or a task it depends on, threw.
+    void Wait(Task task);
+
+    // when each task started and how long it took
+    void LogTimings() const;
+};
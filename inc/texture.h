@@ -1,23 +1,110 @@
 #pragma once
 
 #include <GL/glew.h>
-#include <SDL2pp/Surface.hh>
+#include <atomic>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <mutex>
 #include <string>
+#include <vector>
 
+class TextureCache;
+
+// Diffuse texture, decoded once into a MIP pyramid of RGBA8 levels. Levels are cut in
+// pages of 32x32 texels made of 4x4 tiles: one tile is 64 bytes, a cache line, so
+// lookups close in uv in any direction share lines. With the texture_cache_size option
+// the pages are stored in a tiled file next to the image, generated on first use, and
+// streamed through the TextureCache instead of staying in memory. With the
+// texture_compression option resident textures keep each tile as one 8 byte block of a
+// BC1-like codec, decoded texel by texel on lookup.
+//
+// Nothing is read before Load, which the first lookup or the OpenGL upload runs unless
+// the TextureManager got to it first; concurrent first lookups wait for one decode.
 class Texture
 {
   public:
     Texture(GLenum texture_target, const std::string &file_name);
 
     ~Texture();
+    // decodes the file, once whoever calls it
+    void Load();
     void Bind(GLenum TextureUnit);
+    // nearest texel of the full resolution level, uv repeats outside [0, 1)
     glm::vec3 GetPixel(glm::vec2 uv) const;
+    // trilinear filtering, lod is the log2 of the footprint in full resolution texels
+    glm::vec3 Sample(glm::vec2 uv, float lod) const;
     void SetupForOpenGL();
 
+    uint32_t GetWidth() const
+    {
+        EnsureLoaded();
+        return levels_[0].w_;
+    }
+    uint32_t GetHeight() const
+    {
+        EnsureLoaded();
+        return levels_[0].h_;
+    }
+
   private:
+    static const uint32_t TILE_SIZE = 4;
+    static const uint32_t PAGE_SIZE = 32;
+
+    struct Level
+    {
+        uint32_t w_, h_;
+        uint32_t pages_x_;
+        uint32_t first_page_;
+    };
+
+    uint32_t Page(const Level &level, uint32_t x, uint32_t y) const
+    {
+        return level.first_page_ + (y / PAGE_SIZE) * level.pages_x_ + x / PAGE_SIZE;
+    }
+
+    static uint32_t TexelInPage(uint32_t x, uint32_t y)
+    {
+        x %= PAGE_SIZE;
+        y %= PAGE_SIZE;
+        uint32_t tile = (y / TILE_SIZE) * (PAGE_SIZE / TILE_SIZE) + x / TILE_SIZE;
+        return tile * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE;
+    }
+
+    void EnsureLoaded() const
+    {
+        // decoding is the one change of a texture after construction, lookups see
+        // it as read-only
+        if (!loaded_.load(std::memory_order_acquire))
+            const_cast<Texture *>(this)->Load();
+    }
+
+    void Read();
+    void AddLevel(uint32_t w, uint32_t h);
+    void Decode(const std::string &file_name);
+    // replaces the texels by their blocks
+    void Compress();
+    // the tiled file, false if it is missing or stale
+    bool ReadTiled(const std::string &path, const std::string &source, uint64_t *offset);
+    bool WriteTiled(const std::string &path, uint64_t *offset) const;
+
+    // RGBA8 bytes in memory order, x and y are in range
+    uint32_t Texel(const Level &level, uint32_t x, uint32_t y) const;
+    glm::vec3 Fetch(const Level &level, int x, int y) const;
+    glm::vec3 Bilinear(const Level &level, glm::vec2 uv) const;
+
     GLenum texture_target_;
-    GLuint texture_obj_;
-    SDL2pp::Surface surface_;
-    uint32_t w_, h_;
+    // 0 until SetupForOpenGL uploads the texture, Bind binds a white one meanwhile
+    GLuint texture_obj_ = 0;
+    const std::string file_name_;
+    std::once_flag load_once_;
+    std::atomic<bool> loaded_{false};
+    // from full resolution down to 1x1
+    std::vector<Level> levels_;
+    uint32_t page_count_ = 0;
+    // the pages when resident, empty when streamed or compressed
+    std::vector<uint32_t> texels_;
+    // one per tile, in the order of the tiles in texels_
+    std::vector<uint64_t> blocks_;
+    TextureCache *cache_ = nullptr;
+    uint32_t cache_id_ = 0;
 };
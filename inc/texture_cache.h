@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+
+// Bounded memory pool of texture pages, read on demand from the tiled texture files
+// Texture writes. Lookups of resident pages take no lock: each slot is a seqlock whose
+// version is odd while the page is replaced, and readers check it around their read.
+// Misses read the page from the file outside of any lock, then claim the least
+// recently used slot approximately, with the CLOCK algorithm.
+class TextureCache
+{
+  public:
+    static const uint32_t PAGE_TEXELS = 32 * 32;
+    static const uint32_t PAGE_BYTES = PAGE_TEXELS * sizeof(uint32_t);
+
+    struct Statistics
+    {
+        uint64_t hits_;
+        uint64_t misses_;
+        uint64_t evictions_;
+    };
+
+  private:
+    static const uint64_t NO_KEY = 0;
+    static const uint32_t NO_SLOT = ~0u;
+    static const size_t COUNTER_SHARDS = 16;
+    static const uint32_t MAX_FILES = 1 << 16;
+    // descriptors kept open for the page reads, the least recently used one is closed
+    static const size_t MAX_OPEN_FILES = 32;
+
+    struct Slot
+    {
+        // texture and page held, NO_KEY if none
+        std::atomic<uint64_t> key_;
+        // odd while the key and texels are rewritten, a page replaced since a read
+        // began changes it even if the same page comes back
+        std::atomic<uint32_t> version_;
+        // set by lookups, cleared by the clock hand
+        std::atomic<bool> referenced_;
+    };
+
+    struct File
+    {
+        std::string path_;
+        uint64_t offset_;
+        uint32_t page_count_;
+        // slot last known to hold each page, checked against the slot key
+        std::unique_ptr<std::atomic<uint32_t>[]> slots_;
+    };
+
+    // closes the file when the last reader lets go of it
+    struct Descriptor
+    {
+        int fd_;
+
+        explicit Descriptor(int fd) : fd_(fd) {}
+        Descriptor(const Descriptor &) = delete;
+        void operator=(const Descriptor &) = delete;
+        ~Descriptor();
+    };
+
+    struct OpenFile
+    {
+        uint32_t texture_;
+        uint64_t last_use_;
+        std::shared_ptr<Descriptor> descriptor_;
+    };
+
+    // a shared counter bumped on every lookup would bounce its cache line between
+    // all rendering threads
+    struct alignas(64) Counter
+    {
+        std::atomic<uint64_t> value_;
+    };
+
+    Log log_{"TextureCache"};
+
+    const uint32_t slot_count_;
+    std::unique_ptr<Slot[]> slots_;
+    // the texels of slot i start at i * PAGE_TEXELS
+    std::unique_ptr<std::atomic<uint32_t>[]> texels_;
+    // reserved for MAX_FILES, registering never moves the files lookups read
+    std::vector<std::unique_ptr<File>> files_;
+
+    // guards registering, the clock hand and claiming slots
+    std::mutex mutex_;
+    uint32_t hand_ = 0;
+
+    // guards the open descriptors, reads through them happen outside of it
+    std::mutex descriptors_mutex_;
+    std::vector<OpenFile> open_files_;
+    uint64_t descriptor_clock_ = 0;
+
+    std::array<Counter, COUNTER_SHARDS> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> evictions_;
+
+    static uint64_t Key(uint32_t texture, uint32_t page)
+    {
+        return (uint64_t(texture) + 1) << 32 | page;
+    }
+
+    // reads the texel if the slot holds the page
+    bool TryFetch(uint32_t slot, uint64_t key, uint32_t texel, uint32_t *value)
+    {
+        Slot &s = slots_[slot];
+        uint32_t version = s.version_.load(std::memory_order_acquire);
+        if ((version & 1) || s.key_.load(std::memory_order_relaxed) != key)
+            return false;
+
+        *value =
+            texels_[size_t(slot) * PAGE_TEXELS + texel].load(std::memory_order_relaxed);
+        // the version is read again after the texel, unchanged the slot wasn't touched
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.version_.load(std::memory_order_relaxed) != version)
+            return false;
+
+        if (!s.referenced_.load(std::memory_order_relaxed))
+            s.referenced_.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    // the lookup path of pages not found in their slot
+    uint32_t FetchMissing(uint32_t texture, uint32_t page, uint32_t texel);
+    // brings the page in, returns its slot, which may still be being filled
+    uint32_t Load(uint32_t texture, uint32_t page);
+    uint32_t PickVictim();
+    std::shared_ptr<Descriptor> Open(uint32_t texture);
+    void ReadPage(uint32_t texture, uint32_t page, uint32_t *data);
+
+  public:
+    // budget_bytes of 0 disables paging, textures then stay resident as a whole
+    explicit TextureCache(size_t budget_bytes);
+    TextureCache(const TextureCache &) = delete;
+    void operator=(const TextureCache &) = delete;
+
+    // the cache of the texture_cache_size option
+    static TextureCache &inst();
+
+    bool Enabled() const { return slot_count_ > 0; }
+
+    // Pages are stored one after the other from offset in the file. Textures may
+    // register while others are being looked up.
+    uint32_t Register(const std::string &path, uint64_t offset, uint32_t page_count);
+
+    // RGBA8 texel of a page, bytes in memory order
+    uint32_t Fetch(uint32_t texture, uint32_t page, uint32_t texel)
+    {
+        uint32_t value;
+        uint32_t slot = files_[texture]->slots_[page].load(std::memory_order_acquire);
+        if (slot == NO_SLOT || !TryFetch(slot, Key(texture, page), texel, &value))
+            return FetchMissing(texture, page, texel);
+
+        thread_local size_t shard =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) % COUNTER_SHARDS;
+        hits_[shard].value_.fetch_add(1, std::memory_order_relaxed);
+        return value;
+    }
+
+    Statistics GetStatistics() const;
+    void LogStatistics() const;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Block compression of the texture_compression option, close to BC1. A block holds a
+// 4x4 tile: two RGB565 end points in bits 0-31 and a 2 bit palette index per texel
+// above. The palette is the end points and their blends at thirds, alpha is dropped.
+const uint32_t BLOCK_TEXELS = 16;
+
+// End points at the extremes of the principal axis of the colours, each texel then
+// takes the closest entry of the decoded palette. Texels are RGBA8, bytes in memory
+// order, in the order of the tile.
+uint64_t EncodeBlock(const uint32_t *texels);
+
+// RGBA8 bytes in memory order of texel i of the block
+uint32_t DecodeTexel(uint64_t block, uint32_t i);
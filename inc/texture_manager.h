@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+#include "texture.h"
+
+// Textures of a scene by canonical path, so that materials sharing a file share one
+// decoded texture. Textures decode on first use; Prefetch decodes them all on a pool of
+// threads meanwhile, while the rest of the scene loads.
+class TextureManager
+{
+    std::map<std::string, std::unique_ptr<Texture>> textures_;
+
+    // the prefetch: workers take the next texture to decode from the shared index
+    std::vector<Texture *> pending_;
+    std::atomic<size_t> next_{0};
+    std::vector<std::thread> workers_;
+    std::chrono::steady_clock::time_point prefetch_start_;
+
+    Log log_{"TextureManager"};
+
+  public:
+    TextureManager() = default;
+    TextureManager(const TextureManager &) = delete;
+    void operator=(const TextureManager &) = delete;
+    // waits for the prefetch
+    ~TextureManager();
+
+    // res/fail.png in place of missing files; the texture lives as long as the manager
+    Texture *Acquire(const std::string &path);
+
+    // starts decoding every texture acquired so far on the threads option's threads,
+    // at most once
+    void Prefetch();
+    // until the prefetch is done, returns at once without one
+    void Wait();
+
+    size_t Size() const { return textures_.size(); }
+};
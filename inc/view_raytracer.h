@@ -4,13 +4,17 @@
 
 #include <SDL2pp/SDL2pp.hh>
 #include <boost/optional/optional.hpp>
+#include <chrono>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <inttypes.h>
 
+#include "film.h"
 #include "log.h"
 #include "mesh.h"
-#include "pathtracer.h"
+#include "integrator.h"
+#include "preview_buffer.h"
+#include "raycaster.h"
 
 class ViewRayCaster
 {
@@ -27,14 +31,32 @@ class ViewRayCaster
     SDL2pp::Renderer renderer_;
     SDL2pp::Texture tex_;
 
-    uint8_t *raytracer_surface_;
+    PreviewBuffer preview_;
     const glm::vec3 sky_color_;
+    Film film_;
     Log log_{"ViewRayCaster"};
 
+    std::string checkpoint_path_;
+    float checkpoint_interval_;
+    std::chrono::steady_clock::time_point last_checkpoint_;
+
+    // Brings every pixel up to target_samples samples, column batch by column batch.
+    void RenderPass(glm::vec3 camera_pos, glm::mat4 inv_mvp, uint32_t target_samples,
+                    float iso, bool report_progress);
+    // Denoises the film and shows the result in the preview window.
+    std::vector<glm::vec3> DenoisePreview(float iso);
+    void PresentPreview();
+    bool RefinementCancelled();
+    void Checkpoint(bool force);
+
   public:
-    ViewRayCaster(const Scene &scene);
+    // The raycaster and the integrator tracing through it are built beforehand, away
+    // from the main thread the windows are created on.
+    ViewRayCaster(std::unique_ptr<RayCaster> raycaster,
+                  std::unique_ptr<Integrator> integrator);
     void TakePicture(glm::vec3 camera_pos, glm::mat4 mvp, const Scene &scene);
     void Render();
 
-    PathTracer pathtracer_;
+    std::unique_ptr<RayCaster> raycaster_;
+    std::unique_ptr<Integrator> integrator_;
 };
\ No newline at end of file
@@ -0,0 +1,417 @@
+
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+#include "bdpt.h"
+#include "config.h"
+
+namespace
+{
+
+bool IsBlack(glm::vec3 v) { return v.x == 0.0f && v.y == 0.0f && v.z == 0.0f; }
+
+} // namespace
+
+BidirectionalPathTracer::BidirectionalPathTracer(const Scene &scene,
+                                                 const RayCaster &raycaster)
+    : Integrator(scene, raycaster),
+      max_depth_(Config::inst().GetOption<int>("bdpt_max_depth")),
+      lights_(scene.area_lights_)
+{
+    if (lights_.Empty())
+        log_.Warning() << "No area lights, only the sky will be visible.";
+}
+
+void BidirectionalPathTracer::SetCamera(glm::vec3 camera_pos, glm::mat4 inv_mvp,
+                                        Film &film)
+{
+    camera_ = PinholeCamera(camera_pos, inv_mvp);
+    film_ = &film;
+}
+
+glm::vec3 BidirectionalPathTracer::F(const BDPTVertex &v, glm::vec3 from, glm::vec3 to) const
+{
+    if (v.type_ == BDPTVertex::Light)
+        return v.emission_;
+    if (v.type_ == BDPTVertex::Camera)
+        return glm::vec3();
+
+    // nothing is transmitted
+    if (glm::dot(v.normal_, from - v.position_) * glm::dot(v.normal_, to - v.position_) <=
+        0.0f)
+        return glm::vec3();
+
+    return EvaluateBSDF(v.si_, from, to) / glm::pi<float>();
+}
+
+float BidirectionalPathTracer::PdfDir(const BDPTVertex &v, glm::vec3 wi, glm::vec3 wo) const
+{
+    if (v.type_ == BDPTVertex::Camera)
+        return camera_.Pdf(wo);
+    if (v.type_ == BDPTVertex::Light)
+        return std::abs(glm::dot(v.normal_, wo)) / (2.0f * glm::pi<float>());
+
+    if (glm::dot(v.normal_, wi) * glm::dot(v.normal_, wo) <= 0.0f)
+        return 0.0f;
+
+    // the specular lobe is picked half of the time
+    float lobe = v.si_.record_->has_specular_ ? 0.5f : 1.0f;
+    return lobe * std::abs(glm::dot(v.normal_, wo)) / glm::pi<float>();
+}
+
+float BidirectionalPathTracer::ConvertDensity(float pdf_dir, glm::vec3 from,
+                                              const BDPTVertex &to) const
+{
+    glm::vec3 d = to.position_ - from;
+    float dist_sq = glm::dot(d, d);
+    if (dist_sq == 0.0f)
+        return 0.0f;
+
+    if (to.type_ != BDPTVertex::Camera)
+        pdf_dir *= std::abs(glm::dot(to.normal_, d)) / std::sqrt(dist_sq);
+    return pdf_dir / dist_sq;
+}
+
+float BidirectionalPathTracer::Pdf(const BDPTVertex &v, const BDPTVertex *prev,
+                                   const BDPTVertex &next) const
+{
+    glm::vec3 wo = glm::normalize(next.position_ - v.position_);
+    glm::vec3 wi = prev ? glm::normalize(prev->position_ - v.position_) : glm::vec3();
+
+    return ConvertDensity(PdfDir(v, wi, wo), v.position_, next);
+}
+
+float BidirectionalPathTracer::PdfLightOrigin(const BDPTVertex &v) const
+{
+    return lights_.AreaPdf(v.emission_);
+}
+
+bool BidirectionalPathTracer::Visible(glm::vec3 from, glm::vec3 to) const
+{
+    glm::vec3 d = to - from;
+    float dist = glm::length(d);
+    auto hit = raycaster_.Trace(from, d / dist);
+
+    return !hit || hit->first.dist_ > dist * 0.999f;
+}
+
+void BidirectionalPathTracer::RandomWalk(glm::vec3 dir, glm::vec3 beta, float pdf_dir,
+                                         Sampler &sampler, std::vector<BDPTVertex> &path,
+                                         int max_vertices, PixelAOV *aov,
+                                         glm::vec3 *escaped) const
+{
+    glm::vec3 origin = path.back().position_;
+
+    while (int(path.size()) < max_vertices)
+    {
+        auto intersection_raw = raycaster_.Trace(origin, dir);
+        if (!intersection_raw)
+        {
+            if (escaped)
+                *escaped += beta * scene_.skybox_.Sample(dir);
+            if (aov && path.size() == 1)
+                *aov = {scene_.skybox_.Sample(dir), glm::vec3(), 0.0f};
+            return;
+        }
+
+        auto intersection = intersection_raw->first;
+        auto surface = intersection_raw->second;
+        SurfaceInteraction si = Interact(intersection, surface);
+        const MaterialRecord &material = *si.record_;
+
+        if (aov && path.size() == 1)
+            RecordAOV(aov, dir, si, intersection.dist_);
+
+        BDPTVertex vertex;
+        vertex.type_ = BDPTVertex::Surface;
+        vertex.position_ = intersection.global_pos_;
+        vertex.normal_ = si.normal_;
+        vertex.beta_ = beta;
+        vertex.pdf_fwd_ = ConvertDensity(pdf_dir, origin, vertex);
+        vertex.pdf_rev_ = 0.0f;
+        vertex.delta_ = false;
+        vertex.si_ = si;
+        vertex.emission_ = material.emission_;
+        path.push_back(vertex);
+
+        if (int(path.size()) >= max_vertices)
+            return;
+
+        BDPTVertex &current = path[path.size() - 1];
+        BDPTVertex &prev = path[path.size() - 2];
+        glm::vec3 side =
+            glm::dot(current.normal_, dir) < 0.0f ? current.normal_ : -current.normal_;
+
+        glm::vec3 new_dir;
+        float pdf_fwd_dir = 0.0f, pdf_rev_dir = 0.0f;
+
+        if (material.has_specular_ && sampler.Get1D() < 0.5f)
+        {
+            auto reflection = SampleSpecularBSDF(current.si_, dir);
+
+            new_dir = reflection.dir_;
+            beta *= 2.0f * reflection.radiance_ / reflection.pdf_;
+            current.delta_ = true;
+        }
+        else
+        {
+            new_dir = sampler.SampleCosineDirection(side);
+            pdf_fwd_dir = PdfDir(current, -dir, new_dir);
+            if (pdf_fwd_dir == 0.0f)
+                return;
+
+            beta *= F(current, prev.position_, current.position_ + new_dir) *
+                    std::abs(glm::dot(side, new_dir)) / pdf_fwd_dir;
+            pdf_rev_dir = PdfDir(current, new_dir, -dir);
+        }
+
+        prev.pdf_rev_ = ConvertDensity(pdf_rev_dir, current.position_, prev);
+
+        if (IsBlack(beta))
+            return;
+
+        origin = current.position_;
+        dir = new_dir;
+        pdf_dir = pdf_fwd_dir;
+    }
+}
+
+float BidirectionalPathTracer::MISWeight(std::vector<BDPTVertex> &light_path,
+                                         std::vector<BDPTVertex> &camera_path,
+                                         const BDPTVertex &sampled, int s, int t) const
+{
+    if (s + t == 2)
+        return 1.0f;
+
+    BDPTVertex *qs = s > 0 ? &light_path[s - 1] : nullptr;
+    BDPTVertex *pt = t > 0 ? &camera_path[t - 1] : nullptr;
+    BDPTVertex *qs_minus = s > 1 ? &light_path[s - 2] : nullptr;
+    BDPTVertex *pt_minus = t > 1 ? &camera_path[t - 2] : nullptr;
+
+    // the densities at the connection change with the strategy, they are put back below
+    BDPTVertex saved[4];
+    BDPTVertex *changed[4] = {qs, pt, qs_minus, pt_minus};
+    for (int i = 0; i < 4; i++)
+        if (changed[i])
+            saved[i] = *changed[i];
+
+    if (s == 1)
+        *qs = sampled;
+    else if (t == 1)
+        *pt = sampled;
+
+    pt->delta_ = false;
+    pt->pdf_rev_ = s > 0 ? Pdf(*qs, qs_minus, *pt) : PdfLightOrigin(*pt);
+    if (pt_minus)
+    {
+        if (s > 0)
+        {
+            pt_minus->pdf_rev_ = Pdf(*pt, qs, *pt_minus);
+        }
+        else
+        {
+            // pt acts as the light
+            glm::vec3 wo = glm::normalize(pt_minus->position_ - pt->position_);
+            pt_minus->pdf_rev_ =
+                ConvertDensity(std::abs(glm::dot(pt->normal_, wo)) / (2.0f * glm::pi<float>()),
+                               pt->position_, *pt_minus);
+        }
+    }
+
+    if (qs)
+    {
+        qs->delta_ = false;
+        qs->pdf_rev_ = Pdf(*pt, pt_minus, *qs);
+    }
+    if (qs_minus)
+        qs_minus->pdf_rev_ = Pdf(*qs, pt, *qs_minus);
+
+    // delta densities are 0, they cancel out between the two ends
+    auto remap = [](float pdf) { return pdf != 0.0f ? pdf : 1.0f; };
+    float sum_ratios = 0.0f;
+
+    float ratio = 1.0f;
+    for (int i = t - 1; i > 0; i--)
+    {
+        ratio *= remap(camera_path[i].pdf_rev_) / remap(camera_path[i].pdf_fwd_);
+        if (!camera_path[i].delta_ && !camera_path[i - 1].delta_)
+            sum_ratios += ratio;
+    }
+
+    ratio = 1.0f;
+    for (int i = s - 1; i >= 0; i--)
+    {
+        ratio *= remap(light_path[i].pdf_rev_) / remap(light_path[i].pdf_fwd_);
+        bool delta_before = i > 0 ? light_path[i - 1].delta_ : false;
+        if (!light_path[i].delta_ && !delta_before)
+            sum_ratios += ratio;
+    }
+
+    for (int i = 0; i < 4; i++)
+        if (changed[i])
+            *changed[i] = saved[i];
+
+    return 1.0f / (1.0f + sum_ratios);
+}
+
+glm::vec3 BidirectionalPathTracer::Connect(std::vector<BDPTVertex> &light_path,
+                                           std::vector<BDPTVertex> &camera_path, int s,
+                                           int t, Sampler &sampler,
+                                           glm::uvec2 *splat_pixel) const
+{
+    glm::vec3 L = glm::vec3();
+    BDPTVertex sampled = {};
+
+    if (s == 0)
+    {
+        // the camera path found a light by itself
+        const BDPTVertex &pt = camera_path[t - 1];
+        if (pt.type_ != BDPTVertex::Surface)
+            return glm::vec3();
+
+        L = pt.beta_ * pt.emission_;
+    }
+    else if (t == 1)
+    {
+        // light tracing, the path is connected to the camera
+        const BDPTVertex &qs = light_path[s - 1];
+        glm::vec3 to_camera = camera_.GetPosition() - qs.position_;
+        float dist_sq = glm::dot(to_camera, to_camera);
+        glm::vec3 w = to_camera / std::sqrt(dist_sq);
+
+        if (!camera_.GetPixel(-w, film_->GetWidth(), film_->GetHeight(), splat_pixel))
+            return glm::vec3();
+
+        sampled.type_ = BDPTVertex::Camera;
+        sampled.position_ = camera_.GetPosition();
+        sampled.normal_ = camera_.GetForward();
+
+        glm::vec3 from = s > 1 ? light_path[s - 2].position_ : glm::vec3();
+        L = qs.beta_ * F(qs, from, camera_.GetPosition()) * camera_.We(-w) *
+            glm::dot(-w, camera_.GetForward()) * std::abs(glm::dot(qs.normal_, w)) /
+            dist_sq;
+
+        if (!IsBlack(L) && !Visible(qs.position_, camera_.GetPosition()))
+            return glm::vec3();
+    }
+    else if (s == 1)
+    {
+        // next event estimation, a fresh point on a light
+        const BDPTVertex &pt = camera_path[t - 1];
+        if (pt.type_ != BDPTVertex::Surface || lights_.Empty())
+            return glm::vec3();
+
+        float light_pdf;
+        const auto &light = scene_.area_lights_[lights_.Sample(sampler.Get1D(), &light_pdf)];
+        auto light_sample = light.Sample(pt.position_, sampler);
+
+        sampled.type_ = BDPTVertex::Light;
+        sampled.position_ = light_sample.first;
+        sampled.normal_ = light.GetNormal();
+        sampled.beta_ = light_sample.second * light.GetArea() / light_pdf;
+        sampled.pdf_fwd_ = light_pdf / light.GetArea();
+        sampled.emission_ = light_sample.second;
+
+        glm::vec3 to_light = sampled.position_ - pt.position_;
+        float dist_sq = glm::dot(to_light, to_light);
+        glm::vec3 w = to_light / std::sqrt(dist_sq);
+
+        L = pt.beta_ * F(pt, sampled.position_, camera_path[t - 2].position_) *
+            sampled.beta_ * std::abs(glm::dot(pt.normal_, w)) *
+            std::abs(glm::dot(sampled.normal_, w)) / dist_sq;
+
+        if (!IsBlack(L) && !Visible(pt.position_, sampled.position_))
+            return glm::vec3();
+    }
+    else
+    {
+        const BDPTVertex &qs = light_path[s - 1];
+        const BDPTVertex &pt = camera_path[t - 1];
+        if (pt.type_ != BDPTVertex::Surface)
+            return glm::vec3();
+
+        glm::vec3 d = pt.position_ - qs.position_;
+        float dist_sq = glm::dot(d, d);
+        glm::vec3 w = d / std::sqrt(dist_sq);
+
+        L = qs.beta_ * F(qs, light_path[s - 2].position_, pt.position_) *
+            F(pt, qs.position_, camera_path[t - 2].position_) * pt.beta_ *
+            std::abs(glm::dot(qs.normal_, w)) * std::abs(glm::dot(pt.normal_, w)) / dist_sq;
+
+        if (!IsBlack(L) && !Visible(qs.position_, pt.position_))
+            return glm::vec3();
+    }
+
+    if (IsBlack(L))
+        return glm::vec3();
+
+    return L * MISWeight(light_path, camera_path, sampled, s, t);
+}
+
+glm::vec3 BidirectionalPathTracer::Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                                         PixelAOV *aov, const glm::uvec2 *) const
+{
+    std::vector<BDPTVertex> camera_path, light_path;
+    camera_path.reserve(max_depth_ + 2);
+    light_path.reserve(max_depth_ + 1);
+
+    BDPTVertex camera_vertex = {};
+    camera_vertex.type_ = BDPTVertex::Camera;
+    camera_vertex.position_ = origin;
+    camera_vertex.normal_ = camera_.GetForward();
+    camera_vertex.beta_ = glm::vec3(1.0f);
+    camera_path.push_back(camera_vertex);
+
+    glm::vec3 escaped = glm::vec3();
+    RandomWalk(dir, glm::vec3(1.0f), camera_.Pdf(dir), sampler, camera_path,
+               max_depth_ + 2, aov, &escaped);
+
+    if (!lights_.Empty())
+    {
+        float light_pdf;
+        const auto &light = scene_.area_lights_[lights_.Sample(sampler.Get1D(), &light_pdf)];
+        auto light_sample = light.Sample(glm::vec3(), sampler);
+
+        BDPTVertex light_vertex = {};
+        light_vertex.type_ = BDPTVertex::Light;
+        light_vertex.position_ = light_sample.first;
+        light_vertex.normal_ = light.GetNormal();
+        light_vertex.beta_ = light_sample.second * light.GetArea() / light_pdf;
+        light_vertex.pdf_fwd_ = light_pdf / light.GetArea();
+        light_vertex.emission_ = light_sample.second;
+        light_path.push_back(light_vertex);
+
+        // lights are two-sided, the side is picked at random
+        glm::vec3 side = sampler.Get1D() < 0.5f ? light_vertex.normal_ : -light_vertex.normal_;
+        glm::vec3 light_dir = sampler.SampleCosineDirection(side);
+        float pdf_dir = PdfDir(light_vertex, glm::vec3(), light_dir);
+
+        if (pdf_dir > 0.0f)
+            RandomWalk(light_dir,
+                       light_vertex.beta_ * std::abs(glm::dot(side, light_dir)) / pdf_dir,
+                       pdf_dir, sampler, light_path, max_depth_ + 1, nullptr, nullptr);
+    }
+
+    glm::vec3 L = escaped;
+
+    for (int t = 1; t <= int(camera_path.size()); t++)
+    {
+        for (int s = 0; s <= int(light_path.size()); s++)
+        {
+            int depth = s + t - 2;
+            if ((s == 1 && t == 1) || depth < 0 || depth > max_depth_)
+                continue;
+
+            glm::uvec2 pixel;
+            glm::vec3 contribution =
+                Connect(light_path, camera_path, s, t, sampler, &pixel);
+
+            if (t != 1)
+                L += contribution;
+            else if (!IsBlack(contribution))
+                film_->AddSplat(pixel.x, pixel.y, contribution);
+        }
+    }
+
+    return L;
+}
@@ -0,0 +1,81 @@
+
+#include <cmath>
+
+#include "camera.h"
+
+PinholeCamera::PinholeCamera()
+    : position_(), image_x_(), image_y_(), image_center_(), forward_(0.0f, 0.0f, 1.0f),
+      area_(1.0f)
+{
+}
+
+PinholeCamera::PinholeCamera(glm::vec3 position, glm::mat4 inv_mvp)
+    : position_(position), image_x_(inv_mvp[0]), image_y_(inv_mvp[1]),
+      image_center_(inv_mvp[2] + inv_mvp[3])
+{
+    // RenderPass shoots towards image_center_ + x * image_x_ + y * image_y_
+    forward_ = glm::normalize(glm::cross(image_x_, image_y_));
+    if (glm::dot(forward_, image_center_) < 0.0f)
+        forward_ = -forward_;
+
+    float distance = glm::dot(image_center_, forward_);
+    area_ = 4.0f * glm::length(glm::cross(image_x_, image_y_)) / (distance * distance);
+}
+
+glm::vec3 PinholeCamera::GetPosition() const { return position_; }
+glm::vec3 PinholeCamera::GetForward() const { return forward_; }
+
+bool PinholeCamera::Project(glm::vec3 dir, glm::vec2 *ndc) const
+{
+    float cosine = glm::dot(dir, forward_);
+    if (cosine <= 0.0f)
+        return false;
+
+    glm::vec3 on_plane = dir * (glm::dot(image_center_, forward_) / cosine) - image_center_;
+    glm::vec3 x_dual = glm::cross(image_y_, forward_);
+    glm::vec3 y_dual = glm::cross(forward_, image_x_);
+
+    *ndc = glm::vec2(glm::dot(on_plane, x_dual) / glm::dot(image_x_, x_dual),
+                     glm::dot(on_plane, y_dual) / glm::dot(image_y_, y_dual));
+    return true;
+}
+
+float PinholeCamera::Pdf(glm::vec3 dir) const
+{
+    float cosine = glm::dot(dir, forward_);
+    if (cosine <= 0.0f)
+        return 0.0f;
+
+    return 1.0f / (area_ * cosine * cosine * cosine);
+}
+
+float PinholeCamera::We(glm::vec3 dir) const
+{
+    float cosine = glm::dot(dir, forward_);
+    if (cosine <= 0.0f)
+        return 0.0f;
+
+    return 1.0f / (area_ * cosine * cosine * cosine * cosine);
+}
+
+bool PinholeCamera::GetPixel(glm::vec3 dir, uint32_t width, uint32_t height,
+                             glm::uvec2 *pixel) const
+{
+    glm::vec2 ndc;
+    if (!Project(dir, &ndc))
+        return false;
+
+    // the inverse of the pixel to ray mapping of ViewRayCaster::RenderPass
+    float x = std::floor(ndc.x * float(width / 2) + float(width / 2) + 0.5f);
+    float y = std::floor(-ndc.y * float(height / 2) + float(height / 2) + 0.5f);
+    if (x < 0.0f || y < 0.0f || x >= float(width) || y >= float(height))
+        return false;
+
+    *pixel = glm::uvec2(uint32_t(x), uint32_t(y));
+    return true;
+}
+
+float PinholeCamera::PixelSpread(uint32_t width, uint32_t height) const
+{
+    return std::sqrt(area_ / (float(width) * float(height)));
+}
@@ -0,0 +1,92 @@
+
+#include <cmath>
+
+#include "compact_vertices.h"
+#include "mesh.h"
+
+namespace
+{
+
+const float POSITION_STEPS = float((1 << 21) - 1);
+const float UV_STEPS = 65535.0f;
+
+// the unit normal on the octahedron |x| + |y| + |z| = 1, its lower half folded over
+// the upper one, as two components in [-1, 1]
+glm::vec2 OctahedralEncode(glm::vec3 n)
+{
+    float norm = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (norm == 0.0f)
+        return glm::vec2(0.0f);
+    n /= norm;
+    glm::vec2 ret(n.x, n.y);
+    if (n.z < 0.0f)
+        ret = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                        (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    return ret;
+}
+
+glm::vec3 OctahedralDecode(glm::vec2 e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.0f)
+        n = glm::vec3((1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f), n.z);
+    return glm::normalize(n);
+}
+
+} // namespace
+
+CompactVertices::CompactVertices(Span<const Vertex> vertices)
+{
+    if (vertices.empty())
+        return;
+
+    glm::vec3 lower = vertices[0].pos_, upper = lower;
+    glm::vec2 uv_lower = vertices[0].tex_, uv_upper = uv_lower;
+    for (const auto &v : vertices)
+    {
+        lower = glm::min(lower, v.pos_);
+        upper = glm::max(upper, v.pos_);
+        uv_lower = glm::min(uv_lower, v.tex_);
+        uv_upper = glm::max(uv_upper, v.tex_);
+    }
+
+    origin_ = lower;
+    scale_ = (upper - lower) / POSITION_STEPS;
+    uv_origin_ = uv_lower;
+    uv_scale_ = (uv_upper - uv_lower) / UV_STEPS;
+
+    // flat extents quantize to 0, the scale keeps them in place
+    glm::vec3 inverse_scale(0.0f);
+    glm::vec2 inverse_uv_scale(0.0f);
+    for (int i = 0; i < 3; i++)
+        inverse_scale[i] = scale_[i] > 0.0f ? 1.0f / scale_[i] : 0.0f;
+    for (int i = 0; i < 2; i++)
+        inverse_uv_scale[i] = uv_scale_[i] > 0.0f ? 1.0f / uv_scale_[i] : 0.0f;
+
+    positions_.reserve(vertices.size());
+    attributes_.reserve(vertices.size());
+    for (const auto &v : vertices)
+    {
+        glm::vec3 q = glm::clamp(glm::floor((v.pos_ - origin_) * inverse_scale + 0.5f),
+                                 0.0f, POSITION_STEPS);
+        positions_.push_back(uint64_t(q.x) | uint64_t(q.y) << 21 | uint64_t(q.z) << 42);
+
+        glm::vec2 uv = glm::clamp(
+            glm::floor((v.tex_ - uv_origin_) * inverse_uv_scale + 0.5f), 0.0f, UV_STEPS);
+        Attributes attributes;
+        attributes.normal_ = glm::packSnorm2x16(OctahedralEncode(v.norm_));
+        attributes.uv_[0] = uint16_t(uv.x);
+        attributes.uv_[1] = uint16_t(uv.y);
+        attributes_.push_back(attributes);
+    }
+}
+
+Vertex CompactVertices::Decode(uint32_t i) const
+{
+    const Attributes &attributes = attributes_[i];
+    glm::vec2 uv(attributes.uv_[0], attributes.uv_[1]);
+
+    return {Position(i), uv_origin_ + uv * uv_scale_,
+            OctahedralDecode(glm::unpackSnorm2x16(attributes.normal_))};
+}
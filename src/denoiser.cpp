@@ -0,0 +1,113 @@
+
+#include <thread>
+
+#include "config.h"
+#include "denoiser.h"
+
+const float B3_SPLINE[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+const float MIN_ALBEDO = 0.01f;
+
+Denoiser::Denoiser()
+    : iterations_(Config::inst().GetOption<int>("denoise_iterations")),
+      sigma_color_(Config::inst().GetOption<float>("denoise_sigma_color")),
+      sigma_normal_(Config::inst().GetOption<float>("denoise_sigma_normal")),
+      sigma_depth_(Config::inst().GetOption<float>("denoise_sigma_depth")),
+      threads_(Config::inst().GetOption<int>("threads"))
+{
+}
+
+std::vector<glm::vec3> Denoiser::Denoise(const Film &film, float iso) const
+{
+    const int rx = film.GetWidth(), ry = film.GetHeight();
+
+    std::vector<PixelAOV> aovs(rx * ry);
+    std::vector<glm::vec3> albedo(rx * ry), irradiance(rx * ry), filtered(rx * ry);
+
+    for (int y = 0; y < ry; y++)
+    {
+        for (int x = 0; x < rx; x++)
+        {
+            int pixel_id = y * rx + x;
+            aovs[pixel_id] = film.GetAOV(x, y);
+            albedo[pixel_id] = glm::max(aovs[pixel_id].albedo_, glm::vec3(MIN_ALBEDO));
+            irradiance[pixel_id] = film.GetPixel(x, y) / albedo[pixel_id];
+        }
+    }
+
+    // edge stopping on the color is done on the tone mapped values
+    auto tone_map = [iso](glm::vec3 v) { return v * iso / (glm::vec3(1.0f) + v * iso); };
+
+    for (int iteration = 0; iteration < iterations_; iteration++)
+    {
+        const int step = 1 << iteration;
+        const float color_variance =
+            sigma_color_ * sigma_color_ / float(1 << (2 * iteration));
+
+        auto filter_rows = [&](int y_start, int y_end) {
+            for (int y = y_start; y < y_end; y++)
+            {
+                for (int x = 0; x < rx; x++)
+                {
+                    const int p = y * rx + x;
+                    const glm::vec3 color_p = tone_map(irradiance[p]);
+                    const auto &aov_p = aovs[p];
+
+                    glm::vec3 sum = glm::vec3();
+                    float weight_sum = 0.0f;
+
+                    for (int dy = -2; dy <= 2; dy++)
+                    {
+                        for (int dx = -2; dx <= 2; dx++)
+                        {
+                            int qx = x + dx * step, qy = y + dy * step;
+                            if (qx < 0 || qy < 0 || qx >= rx || qy >= ry)
+                                continue;
+
+                            const int q = qy * rx + qx;
+                            float weight = B3_SPLINE[dx + 2] * B3_SPLINE[dy + 2];
+
+                            if (q != p)
+                            {
+                                const auto &aov_q = aovs[q];
+                                glm::vec3 color_diff = color_p - tone_map(irradiance[q]);
+
+                                weight *= std::exp(-glm::dot(color_diff, color_diff) /
+                                                   color_variance);
+                                weight *= std::pow(
+                                    std::max(0.0f, glm::dot(aov_p.normal_, aov_q.normal_)),
+                                    sigma_normal_);
+                                weight *= std::exp(
+                                    -std::abs(aov_p.depth_ - aov_q.depth_) /
+                                    (sigma_depth_ * aov_p.depth_ * step + 1e-4f));
+                            }
+
+                            sum += irradiance[q] * weight;
+                            weight_sum += weight;
+                        }
+                    }
+
+                    filtered[p] = sum / weight_sum;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        int rows_per_thread = (ry + threads_ - 1) / threads_;
+        for (int t = 0; t < threads_; t++)
+        {
+            threads.emplace_back(filter_rows, std::min(ry, t * rows_per_thread),
+                                 std::min(ry, (t + 1) * rows_per_thread));
+        }
+
+        for (auto &thread : threads)
+            thread.join();
+
+        std::swap(irradiance, filtered);
+    }
+
+    for (int i = 0; i < rx * ry; i++)
+        irradiance[i] *= albedo[i];
+
+    log_.Info() << "Denoised with " << iterations_ << " iterations.";
+    return irradiance;
+}
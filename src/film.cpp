@@ -0,0 +1,268 @@
+
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfOutputFile.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "exceptions.h"
+#include "film.h"
+
+// Checkpoint layout (native endianness):
+//   char[4] magic, uint32 version, uint32 rx, uint32 ry, uint32 seeds_no,
+//   uint32[seeds_no] seeds, vec3[rx * ry] radiance sums, uint32[rx * ry] sample counts,
+//   vec3[rx * ry] albedo sums, vec3[rx * ry] normal sums, float[rx * ry] depth sums,
+//   vec3[rx * ry] splat sums
+const char CHECKPOINT_MAGIC[4] = {'L', 'W', 'C', 'P'};
+const uint32_t CHECKPOINT_VERSION = 3;
+
+Film::Film(uint32_t rx, uint32_t ry)
+    : rx_(rx), ry_(ry), radiance_sum_(rx * ry), sample_count_(rx * ry, 0),
+      albedo_sum_(rx * ry), normal_sum_(rx * ry), depth_sum_(rx * ry, 0.0f),
+      splat_sum_(new std::atomic<float>[rx * ry * 3])
+{
+    for (uint32_t i = 0; i < rx * ry * 3; i++)
+        splat_sum_[i].store(0.0f, std::memory_order_relaxed);
+}
+
+void Film::Clear()
+{
+    std::fill(radiance_sum_.begin(), radiance_sum_.end(), glm::vec3());
+    std::fill(sample_count_.begin(), sample_count_.end(), 0);
+    std::fill(albedo_sum_.begin(), albedo_sum_.end(), glm::vec3());
+    std::fill(normal_sum_.begin(), normal_sum_.end(), glm::vec3());
+    std::fill(depth_sum_.begin(), depth_sum_.end(), 0.0f);
+    for (uint32_t i = 0; i < rx_ * ry_ * 3; i++)
+        splat_sum_[i].store(0.0f, std::memory_order_relaxed);
+    seeds_.clear();
+}
+
+void Film::AddSamples(uint32_t x, uint32_t y, glm::vec3 radiance_sum, uint32_t samples)
+{
+    int pixel_id = y * rx_ + x;
+    radiance_sum_[pixel_id] += radiance_sum;
+    sample_count_[pixel_id] += samples;
+}
+
+void Film::AddAOVs(uint32_t x, uint32_t y, const PixelAOV &aov_sum)
+{
+    int pixel_id = y * rx_ + x;
+    albedo_sum_[pixel_id] += aov_sum.albedo_;
+    normal_sum_[pixel_id] += aov_sum.normal_;
+    depth_sum_[pixel_id] += aov_sum.depth_;
+}
+
+void Film::AddSplat(uint32_t x, uint32_t y, glm::vec3 radiance)
+{
+    int pixel_id = y * rx_ + x;
+    for (int c = 0; c < 3; c++)
+    {
+        auto &target = splat_sum_[pixel_id * 3 + c];
+        float current = target.load(std::memory_order_relaxed);
+        while (!target.compare_exchange_weak(current, current + radiance[c],
+                                             std::memory_order_relaxed))
+            ;
+    }
+}
+
+uint32_t Film::GetSampleCount(uint32_t x, uint32_t y) const
+{
+    return sample_count_[y * rx_ + x];
+}
+
+glm::vec3 Film::GetPixel(uint32_t x, uint32_t y) const
+{
+    int pixel_id = y * rx_ + x;
+    if (sample_count_[pixel_id] == 0)
+        return glm::vec3();
+
+    glm::vec3 splat(splat_sum_[pixel_id * 3].load(std::memory_order_relaxed),
+                    splat_sum_[pixel_id * 3 + 1].load(std::memory_order_relaxed),
+                    splat_sum_[pixel_id * 3 + 2].load(std::memory_order_relaxed));
+
+    return (radiance_sum_[pixel_id] + splat) / float(sample_count_[pixel_id]);
+}
+
+PixelAOV Film::GetAOV(uint32_t x, uint32_t y) const
+{
+    int pixel_id = y * rx_ + x;
+    if (sample_count_[pixel_id] == 0)
+        return {glm::vec3(), glm::vec3(), 0.0f};
+
+    float weight = 1.0f / float(sample_count_[pixel_id]);
+    glm::vec3 normal = normal_sum_[pixel_id];
+    if (glm::length(normal) > 0.0f)
+        normal = glm::normalize(normal);
+
+    return {albedo_sum_[pixel_id] * weight, normal, depth_sum_[pixel_id] * weight};
+}
+
+uint32_t Film::GetWidth() const { return rx_; }
+uint32_t Film::GetHeight() const { return ry_; }
+
+void Film::AddSeed(uint32_t seed)
+{
+    if (std::find(seeds_.begin(), seeds_.end(), seed) == seeds_.end())
+        seeds_.push_back(seed);
+}
+
+const std::vector<uint32_t> &Film::GetSeeds() const { return seeds_; }
+
+bool Film::Merge(const Film &other)
+{
+    STRONG_ASSERT(rx_ == other.rx_ && ry_ == other.ry_,
+                  "Cannot merge renders of different resolutions!");
+
+    for (auto seed : other.seeds_)
+    {
+        if (std::find(seeds_.begin(), seeds_.end(), seed) != seeds_.end())
+        {
+            log_.Warning() << "Seed " << seed
+                           << " was already merged, the samples would be correlated.";
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < radiance_sum_.size(); i++)
+    {
+        radiance_sum_[i] += other.radiance_sum_[i];
+        sample_count_[i] += other.sample_count_[i];
+        albedo_sum_[i] += other.albedo_sum_[i];
+        normal_sum_[i] += other.normal_sum_[i];
+        depth_sum_[i] += other.depth_sum_[i];
+    }
+
+    for (uint32_t i = 0; i < rx_ * ry_ * 3; i++)
+        splat_sum_[i].store(splat_sum_[i].load(std::memory_order_relaxed) +
+                                other.splat_sum_[i].load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+
+    seeds_.insert(seeds_.end(), other.seeds_.begin(), other.seeds_.end());
+    return true;
+}
+
+void Film::SaveCheckpoint(const std::string &path) const
+{
+    // write aside and rename, so a preempted write never destroys the last checkpoint
+    std::string tmp_path = path + ".tmp";
+
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        STRONG_ASSERT(out.good(), "Couldn't open " + tmp_path + " for writing!");
+
+        uint32_t seeds_no = seeds_.size();
+
+        out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        out.write((const char *)&CHECKPOINT_VERSION, sizeof(uint32_t));
+        out.write((const char *)&rx_, sizeof(uint32_t));
+        out.write((const char *)&ry_, sizeof(uint32_t));
+        out.write((const char *)&seeds_no, sizeof(uint32_t));
+        out.write((const char *)seeds_.data(), sizeof(uint32_t) * seeds_no);
+        out.write((const char *)radiance_sum_.data(),
+                  sizeof(glm::vec3) * radiance_sum_.size());
+        out.write((const char *)sample_count_.data(),
+                  sizeof(uint32_t) * sample_count_.size());
+        out.write((const char *)albedo_sum_.data(), sizeof(glm::vec3) * albedo_sum_.size());
+        out.write((const char *)normal_sum_.data(), sizeof(glm::vec3) * normal_sum_.size());
+        out.write((const char *)depth_sum_.data(), sizeof(float) * depth_sum_.size());
+
+        std::vector<float> splats(rx_ * ry_ * 3);
+        for (unsigned int i = 0; i < splats.size(); i++)
+            splats[i] = splat_sum_[i].load(std::memory_order_relaxed);
+        out.write((const char *)splats.data(), sizeof(float) * splats.size());
+
+        STRONG_ASSERT(out.good(), "Writing checkpoint " + tmp_path + " failed!");
+    }
+
+    STRONG_ASSERT(std::rename(tmp_path.c_str(), path.c_str()) == 0,
+                  "Couldn't move checkpoint to " + path);
+}
+
+Film Film::LoadCheckpoint(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    STRONG_ASSERT(in.good(), "Couldn't open checkpoint " + path);
+
+    char magic[4];
+    uint32_t version, rx, ry, seeds_no;
+
+    in.read(magic, sizeof(magic));
+    in.read((char *)&version, sizeof(uint32_t));
+    STRONG_ASSERT(in.good() && std::equal(magic, magic + 4, CHECKPOINT_MAGIC),
+                  path + " is not a checkpoint file!");
+    STRONG_ASSERT(version == CHECKPOINT_VERSION,
+                  "Unsupported checkpoint version " + std::to_string(version));
+
+    in.read((char *)&rx, sizeof(uint32_t));
+    in.read((char *)&ry, sizeof(uint32_t));
+    in.read((char *)&seeds_no, sizeof(uint32_t));
+
+    Film ret(rx, ry);
+    ret.seeds_.resize(seeds_no);
+
+    in.read((char *)ret.seeds_.data(), sizeof(uint32_t) * seeds_no);
+    in.read((char *)ret.radiance_sum_.data(), sizeof(glm::vec3) * ret.radiance_sum_.size());
+    in.read((char *)ret.sample_count_.data(), sizeof(uint32_t) * ret.sample_count_.size());
+    in.read((char *)ret.albedo_sum_.data(), sizeof(glm::vec3) * ret.albedo_sum_.size());
+    in.read((char *)ret.normal_sum_.data(), sizeof(glm::vec3) * ret.normal_sum_.size());
+    in.read((char *)ret.depth_sum_.data(), sizeof(float) * ret.depth_sum_.size());
+
+    std::vector<float> splats(rx * ry * 3);
+    in.read((char *)splats.data(), sizeof(float) * splats.size());
+    for (unsigned int i = 0; i < splats.size(); i++)
+        ret.splat_sum_[i].store(splats[i], std::memory_order_relaxed);
+
+    STRONG_ASSERT(in.good(), "Checkpoint " + path + " is truncated!");
+    return ret;
+}
+
+void Film::WriteEXR(const std::string &path, float iso,
+                    const std::vector<glm::vec3> &denoised) const
+{
+    STRONG_ASSERT(denoised.empty() || denoised.size() == radiance_sum_.size());
+
+    std::vector<std::string> names = {"R",        "G",        "B",        "albedo.R",
+                                      "albedo.G", "albedo.B", "N.X",      "N.Y",
+                                      "N.Z",      "Z"};
+    if (!denoised.empty())
+        names.insert(names.end(), {"noisy.R", "noisy.G", "noisy.B"});
+
+    // every channel as a separate float plane
+    std::vector<std::vector<float>> planes(names.size(), std::vector<float>(rx_ * ry_));
+
+    for (uint32_t y = 0; y < ry_; y++)
+    {
+        for (uint32_t x = 0; x < rx_; x++)
+        {
+            int pixel_id = y * rx_ + x;
+            auto readout = GetPixel(x, y) * iso;
+            auto aov = GetAOV(x, y);
+            auto beauty = denoised.empty() ? readout : denoised[pixel_id] * iso;
+
+            for (int c = 0; c < 3; c++)
+            {
+                planes[c][pixel_id] = beauty[c];
+                planes[3 + c][pixel_id] = aov.albedo_[c];
+                planes[6 + c][pixel_id] = aov.normal_[c];
+                if (!denoised.empty())
+                    planes[10 + c][pixel_id] = readout[c];
+            }
+            planes[9][pixel_id] = aov.depth_;
+        }
+    }
+
+    Imf::Header header(rx_, ry_);
+    Imf::FrameBuffer frame_buffer;
+
+    for (unsigned int c = 0; c < names.size(); c++)
+    {
+        header.channels().insert(names[c].c_str(), Imf::Channel(Imf::FLOAT));
+        frame_buffer.insert(names[c].c_str(),
+                            Imf::Slice(Imf::FLOAT, (char *)planes[c].data(), sizeof(float),
+                                       sizeof(float) * rx_));
+    }
+
+    Imf::OutputFile file(path.c_str(), header);
+    file.setFrameBuffer(frame_buffer);
+    file.writePixels(ry_);
+}
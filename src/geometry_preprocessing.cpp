@@ -0,0 +1,202 @@
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "geometry_preprocessing.h"
+
+namespace
+{
+
+const uint32_t NONE = ~0u;
+
+// texture coordinates and normals of vertices welded have to agree this well
+const float UV_TOLERANCE = 1e-5f;
+const float NORMAL_COSINE = 0.9999f;
+// triangles whose edges make a smaller sine are degenerate
+const float MIN_SINE = 1e-6f;
+// Smaller weld tolerances are raised to it: they are below float precision, welding
+// nothing more, and the cell coordinates, up to 1 / tolerance, would overflow int.
+const float MIN_WELD_TOLERANCE = 1e-7f;
+
+// spreads the low 10 bits of x to every third bit
+uint32_t SpreadBits(uint32_t x)
+{
+    x &= 0x3ff;
+    x = (x | x << 16) & 0x030000ff;
+    x = (x | x << 8) & 0x0300f00f;
+    x = (x | x << 4) & 0x030c30c3;
+    x = (x | x << 2) & 0x09249249;
+    return x;
+}
+
+uint32_t MortonCode(glm::vec3 unit)
+{
+    glm::uvec3 cell = glm::uvec3(glm::clamp(unit, 0.0f, 1.0f) * 1023.0f);
+    return SpreadBits(cell.x) | SpreadBits(cell.y) << 1 | SpreadBits(cell.z) << 2;
+}
+
+// wraps around for far cells, which only costs comparisons
+uint64_t CellKey(glm::ivec3 cell)
+{
+    return uint64_t(cell.x & 0x1fffff) | uint64_t(cell.y & 0x1fffff) << 21 |
+           uint64_t(cell.z & 0x1fffff) << 42;
+}
+
+struct TriangleHash
+{
+    size_t operator()(const std::array<glm::u32, 3> &t) const
+    {
+        return size_t(t[0]) * 73856093u ^ size_t(t[1]) * 19349663u ^
+               size_t(t[2]) * 83492791u;
+    }
+};
+
+bool Weldable(const Vertex &a, const Vertex &b, float distance)
+{
+    glm::vec3 d = a.pos_ - b.pos_;
+    return glm::dot(d, d) <= distance * distance &&
+           glm::length(a.tex_ - b.tex_) <= UV_TOLERANCE &&
+           glm::dot(a.norm_, b.norm_) >= NORMAL_COSINE * glm::length(a.norm_) *
+                                              glm::length(b.norm_);
+}
+
+} // namespace
+
+PreprocessingReport &PreprocessingReport::operator+=(const PreprocessingReport &other)
+{
+    welded_vertices_ += other.welded_vertices_;
+    degenerate_triangles_ += other.degenerate_triangles_;
+    duplicate_triangles_ += other.duplicate_triangles_;
+    unused_vertices_ += other.unused_vertices_;
+    return *this;
+}
+
+PreprocessingReport PreprocessGeometry(std::vector<Vertex> *vertices,
+                                       std::vector<glm::u32> *indices, float tolerance)
+{
+    PreprocessingReport report;
+    if (vertices->empty())
+        return report;
+
+    glm::vec3 lower = (*vertices)[0].pos_, upper = lower;
+    for (const auto &v : *vertices)
+    {
+        lower = glm::min(lower, v.pos_);
+        upper = glm::max(upper, v.pos_);
+    }
+    glm::vec3 extent = upper - lower;
+
+    // every vertex is looked up against the ones kept so far in the 27 grid cells
+    // around it, cells as wide as the weld distance
+    std::vector<uint32_t> weld(vertices->size());
+    float distance =
+        tolerance > 0.0f ? std::max(tolerance, MIN_WELD_TOLERANCE) * glm::length(extent)
+                         : 0.0f;
+    if (distance > 0.0f)
+    {
+        std::unordered_map<uint64_t, uint32_t> first_in_cell;
+        std::vector<uint32_t> next_in_cell(vertices->size(), NONE);
+
+        for (uint32_t i = 0; i < vertices->size(); i++)
+        {
+            const Vertex &v = (*vertices)[i];
+            glm::ivec3 cell = glm::ivec3(glm::floor((v.pos_ - lower) / distance));
+
+            weld[i] = i;
+            for (int n = 0; n < 27 && weld[i] == i; n++)
+            {
+                glm::ivec3 offset(n % 3 - 1, n / 3 % 3 - 1, n / 9 - 1);
+                auto found = first_in_cell.find(CellKey(cell + offset));
+                if (found == first_in_cell.end())
+                    continue;
+                for (uint32_t j = found->second; j != NONE; j = next_in_cell[j])
+                    if (Weldable((*vertices)[j], v, distance))
+                    {
+                        weld[i] = j;
+                        report.welded_vertices_++;
+                        break;
+                    }
+            }
+
+            if (weld[i] == i)
+            {
+                auto head = first_in_cell.emplace(CellKey(cell), i);
+                if (!head.second)
+                {
+                    next_in_cell[i] = head.first->second;
+                    head.first->second = i;
+                }
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < vertices->size(); i++)
+            weld[i] = i;
+    }
+
+    struct Triangle
+    {
+        uint32_t code_;
+        std::array<glm::u32, 3> vertices_;
+    };
+    std::vector<Triangle> triangles;
+    std::unordered_set<std::array<glm::u32, 3>, TriangleHash> seen;
+
+    for (size_t i = 0; i + 2 < indices->size(); i += 3)
+    {
+        std::array<glm::u32, 3> t = {weld[(*indices)[i]], weld[(*indices)[i + 1]],
+                                     weld[(*indices)[i + 2]]};
+        glm::vec3 p0 = (*vertices)[t[0]].pos_, p1 = (*vertices)[t[1]].pos_,
+                  p2 = (*vertices)[t[2]].pos_;
+        glm::vec3 e1 = p1 - p0, e2 = p2 - p0;
+        float sine_times_lengths = glm::length(glm::cross(e1, e2));
+        if (sine_times_lengths <= MIN_SINE * glm::length(e1) * glm::length(e2))
+        {
+            report.degenerate_triangles_++;
+            continue;
+        }
+
+        // either winding, the kd-tree doesn't tell the faces apart
+        std::array<glm::u32, 3> sorted = t;
+        std::sort(sorted.begin(), sorted.end());
+        if (!seen.insert(sorted).second)
+        {
+            report.duplicate_triangles_++;
+            continue;
+        }
+
+        glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+        glm::vec3 unit = (centroid - lower) / glm::max(extent, glm::vec3(1e-30f));
+        triangles.push_back({MortonCode(unit), t});
+    }
+
+    std::stable_sort(triangles.begin(), triangles.end(),
+                     [](const Triangle &a, const Triangle &b) {
+                         return a.code_ < b.code_;
+                     });
+
+    std::vector<uint32_t> renumber(vertices->size(), NONE);
+    std::vector<Vertex> ordered_vertices;
+    std::vector<glm::u32> ordered_indices;
+    ordered_indices.reserve(triangles.size() * 3);
+    for (const auto &triangle : triangles)
+        for (glm::u32 v : triangle.vertices_)
+        {
+            if (renumber[v] == NONE)
+            {
+                renumber[v] = ordered_vertices.size();
+                ordered_vertices.push_back((*vertices)[v]);
+            }
+            ordered_indices.push_back(renumber[v]);
+        }
+
+    report.unused_vertices_ =
+        vertices->size() - report.welded_vertices_ - ordered_vertices.size();
+    *vertices = std::move(ordered_vertices);
+    *indices = std::move(ordered_indices);
+    return report;
+}
@@ -0,0 +1,68 @@
+
+#include "integrator.h"
+#include "bdpt.h"
+#include "config.h"
+#include "exceptions.h"
+#include "pathtracer.h"
+#include "photon_mapper.h"
+#include "spectral_pathtracer.h"
+
+extern std::string S(glm::vec3 in);
+
+Integrator::Integrator(const Scene &scene, const RayCaster &raycaster)
+    : scene_(scene), raycaster_(raycaster)
+{
+}
+
+void Integrator::SetCamera(glm::vec3, glm::mat4, Film &) {}
+
+void Integrator::StartPass(uint32_t) {}
+
+SurfaceInteraction Integrator::Interact(const TriangleIntersection &intersection,
+                                       const TriangleIndices &surface, float footprint) const
+{
+    const auto &submesh = scene_.mesh_->submeshes_[surface.object_id_];
+    return scene_.mesh_->material_table_.Interact(
+        surface.object_id_, intersection.global_pos_, intersection.normal_,
+        intersection.barycentric_pos_, submesh.GetVertex(surface.t1_),
+        submesh.GetVertex(surface.t2_), submesh.GetVertex(surface.t3_), footprint);
+}
+
+void Integrator::RecordAOV(PixelAOV *aov, glm::vec3 dir, const SurfaceInteraction &si,
+                           float dist) const
+{
+    aov->albedo_ = si.albedo_;
+    aov->normal_ =
+        glm::dot(si.shading_normal_, dir) > 0.0f ? -si.shading_normal_ : si.shading_normal_;
+    aov->depth_ = dist;
+}
+
+boost::optional<int> Integrator::DebugTrace(glm::vec3 camera_pos, glm::vec3 dir) const
+{
+    RandomSampler sampler(Config::inst().GetOption<int>("seed"));
+    sampler.StartPixelSample(0, 0, 0);
+    auto result = Trace(camera_pos, dir, sampler);
+
+    Log("Integrator").Info() << "Randiance from debug ray: " << S(result);
+
+    if (auto result = raycaster_.Trace(camera_pos, dir))
+        return result->second.object_id_;
+    else
+        return boost::none;
+}
+
+std::unique_ptr<Integrator> MakeIntegrator(const Scene &scene, const RayCaster &raycaster)
+{
+    auto name = Config::inst().GetOption<std::string>("integrator");
+
+    if (name == "path")
+        return std::make_unique<PathTracer>(scene, raycaster);
+    if (name == "photon")
+        return std::make_unique<PhotonMapper>(scene, raycaster);
+    if (name == "bdpt")
+        return std::make_unique<BidirectionalPathTracer>(scene, raycaster);
+    if (name == "spectral")
+        return std::make_unique<SpectralPathTracer>(scene, raycaster);
+
+    throw Exception("Unknown integrator: " + name);
+}
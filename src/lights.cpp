@@ -1,6 +1,12 @@
 
+#include <OpenEXR/ImfRgbaFile.h>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <glm/gtc/constants.hpp>
+
 #include "lights.h"
 #include "config.h"
+#include "exceptions.h"
 
 AreaLight::AreaLight(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, const Material &mat)
     : p1_(p1), p2_(p2), p3_(p3), material_(mat)
@@ -11,8 +17,8 @@ AreaLight::AreaLight(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, const Material &m
 std::pair<glm::vec3, glm::vec3> AreaLight::Sample(glm::vec3 target,
                                                   Sampler &sampler) const
 {
-    float a, b;
-    std::tie(a, b) = sampler.SamplePair();
+    auto u = sampler.Get2D();
+    float a = u.x, b = u.y;
     if (a + b > 1.0f)
     {
         a = 1.0f - a;
@@ -24,6 +30,180 @@ std::pair<glm::vec3, glm::vec3> AreaLight::Sample(glm::vec3 target,
 
 float AreaLight::GetArea() const { return area_; }
 
-Skybox::Skybox() : radiance_(Config::inst().GetOption<glm::vec3>("sky")) {}
+glm::vec3 AreaLight::GetNormal() const
+{
+    return glm::normalize(glm::cross(p2_ - p1_, p3_ - p1_));
+}
+
+glm::vec3 AreaLight::GetEmission() const { return material_.Emission(); }
+
+LightDistribution::LightDistribution(const std::vector<AreaLight> &lights)
+{
+    float total_power = 0.0f;
+    for (const auto &light : lights)
+    {
+        glm::vec3 emission = light.GetEmission();
+        total_power += light.GetArea() * std::max(emission.x, std::max(emission.y, emission.z));
+        cdf_.push_back(total_power);
+    }
+}
+
+bool LightDistribution::Empty() const { return cdf_.empty() || cdf_.back() == 0.0f; }
+
+uint32_t LightDistribution::Sample(float u, float *pdf) const
+{
+    uint32_t light_id = std::min<size_t>(
+        std::upper_bound(cdf_.begin(), cdf_.end(), u * cdf_.back()) - cdf_.begin(),
+        cdf_.size() - 1);
+
+    *pdf = (cdf_[light_id] - (light_id > 0 ? cdf_[light_id - 1] : 0.0f)) / cdf_.back();
+    return light_id;
+}
+
+float LightDistribution::AreaPdf(glm::vec3 emission) const
+{
+    if (Empty())
+        return 0.0f;
+
+    return std::max(emission.x, std::max(emission.y, emission.z)) / cdf_.back();
+}
+
+Skybox::Skybox()
+    : radiance_(Config::inst().GetOption<glm::vec3>("sky")), width_(0), height_(0)
+{
+    auto path = Config::inst().GetOption<std::string>("sky_map");
+    if (path != "")
+    {
+        LoadMap(path, Config::inst().GetOption<float>("sky_map_scale"));
+        BuildDistribution();
+    }
+}
+
+void Skybox::LoadMap(const std::string &path, float scale)
+{
+    STRONG_ASSERT(boost::filesystem::exists(path), "Environment map " + path + " not found!");
+
+    Imf::RgbaInputFile file(path.c_str());
+    Imath::Box2i window = file.dataWindow();
+    width_ = window.max.x - window.min.x + 1;
+    height_ = window.max.y - window.min.y + 1;
+
+    std::vector<Imf::Rgba> pixels(width_ * height_);
+    file.setFrameBuffer(pixels.data() - window.min.x - window.min.y * width_, 1, width_);
+    file.readPixels(window.min.y, window.max.y);
+
+    map_.resize(width_ * height_);
+    for (uint32_t i = 0; i < width_ * height_; i++)
+        map_[i] = glm::vec3(pixels[i].r, pixels[i].g, pixels[i].b) * scale;
+}
+
+void Skybox::BuildDistribution()
+{
+    row_cdf_.resize(height_);
+    column_cdf_.resize(width_ * height_);
+
+    float total = 0.0f;
+    for (uint32_t y = 0; y < height_; y++)
+    {
+        // rows near the poles cover less of the sphere
+        float sin_theta = std::sin(glm::pi<float>() * (float(y) + 0.5f) / float(height_));
+        float row_sum = 0.0f;
+
+        for (uint32_t x = 0; x < width_; x++)
+        {
+            glm::vec3 texel = map_[y * width_ + x];
+            row_sum += (0.2126f * texel.x + 0.7152f * texel.y + 0.0722f * texel.z) * sin_theta;
+            column_cdf_[y * width_ + x] = row_sum;
+        }
+
+        total += row_sum;
+        row_cdf_[y] = total;
+    }
+}
+
+bool Skybox::HasMap() const { return !map_.empty(); }
+
+uint32_t Skybox::Texel(glm::vec3 dir) const
+{
+    float theta = std::acos(glm::clamp(dir.y, -1.0f, 1.0f));
+    float phi = std::atan2(dir.z, dir.x);
+    if (phi < 0.0f)
+        phi += 2.0f * glm::pi<float>();
+
+    uint32_t x = std::min(uint32_t(phi / (2.0f * glm::pi<float>()) * float(width_)), width_ - 1);
+    uint32_t y = std::min(uint32_t(theta / glm::pi<float>() * float(height_)), height_ - 1);
+    return y * width_ + x;
+}
+
+glm::vec3 Skybox::Sample(glm::vec3 dir) const
+{
+    if (map_.empty())
+        return radiance_;
+
+    return map_[Texel(dir)];
+}
+
+glm::vec3 Skybox::SampleDirection(glm::vec2 u, float *pdf) const
+{
+    if (map_.empty() || row_cdf_.back() <= 0.0f)
+    {
+        // uniform over the sphere
+        float cos_theta = 1.0f - 2.0f * u.y;
+        float sin_theta = std::sqrt(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+        float phi = 2.0f * glm::pi<float>() * u.x;
+
+        *pdf = map_.empty() ? 1.0f / (4.0f * glm::pi<float>()) : 0.0f;
+        return glm::vec3(sin_theta * std::cos(phi), cos_theta, sin_theta * std::sin(phi));
+    }
+
+    // the row first, then the column within it, both continuous inside the texel
+    float row_target = u.y * row_cdf_.back();
+    uint32_t y = std::min<size_t>(
+        std::upper_bound(row_cdf_.begin(), row_cdf_.end(), row_target) - row_cdf_.begin(),
+        height_ - 1);
+    float row_start = y > 0 ? row_cdf_[y - 1] : 0.0f;
+    float row_sum = row_cdf_[y] - row_start;
+
+    auto row = column_cdf_.begin() + y * width_;
+    float column_target = (row_target - row_start) / row_sum * row[width_ - 1];
+    uint32_t x = std::min<size_t>(
+        std::upper_bound(row, row + width_, column_target) - row, width_ - 1);
+    float column_start = x > 0 ? row[x - 1] : 0.0f;
+    float texel_weight = row[x] - column_start;
+
+    float v = (float(y) + glm::clamp((row_target - row_start) / row_sum, 0.0f, 1.0f)) /
+              float(height_);
+    float s = (float(x) + glm::clamp((column_target - column_start) / texel_weight, 0.0f,
+                                     1.0f)) /
+              float(width_);
+    v = std::min(v, 1.0f - 1e-6f);
+    s = std::min(s, 1.0f - 1e-6f);
+
+    float theta = glm::pi<float>() * v, phi = 2.0f * glm::pi<float>() * s;
+    glm::vec3 dir(std::sin(theta) * std::cos(phi), std::cos(theta),
+                  std::sin(theta) * std::sin(phi));
+
+    *pdf = Pdf(dir);
+    return dir;
+}
+
+float Skybox::Pdf(glm::vec3 dir) const
+{
+    if (map_.empty())
+        return 1.0f / (4.0f * glm::pi<float>());
+    if (row_cdf_.back() <= 0.0f)
+        return 0.0f;
+
+    uint32_t texel = Texel(dir);
+    uint32_t x = texel % width_;
+    float texel_weight = column_cdf_[texel] - (x > 0 ? column_cdf_[texel - 1] : 0.0f);
+
+    // density over the unit square of the map, then over the sphere
+    float density = texel_weight / row_cdf_.back() * float(width_ * height_);
+    // not from dir.y, which rounds to +-1 well before the poles
+    float sin_theta = glm::length(glm::vec2(dir.x, dir.z));
+    if (sin_theta == 0.0f)
+        return 0.0f;
 
-glm::vec3 Skybox::Sample(glm::vec3) const { return radiance_; }
\ No newline at end of file
+    return density / (2.0f * glm::pi<float>() * glm::pi<float>() * sin_theta);
+}
\ No newline at end of file
@@ -1,4 +1,9 @@
 
 #include "lwmath.h"
 
-float lerp(float t, float v1, float v2) { return (1.0f - t) * v1 + t * v2; }
\ No newline at end of file
+namespace lwmath
+{
+
+float lerp(float t, float v1, float v2) { return (1.0f - t) * v1 + t * v2; }
+
+} // namespace lwmath
\ No newline at end of file
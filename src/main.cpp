@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "log.h"
+#include "task_graph.h"
 #include "view_opengl.h"
 #include "view_raytracer.h"
 
@@ -14,24 +15,37 @@ int main(int argc, char **argv)
     Log log("main");
     log.Info() << "Ray tracer demo";
 
-    Config::inst().Load(argc, argv);
+    // Startup as tasks: the import, then the texture decode alongside the acceleration
+    // structure and the integrator, while the main thread opens the OpenGL preview and
+    // uploads the geometry. The graph outlives none of what its tasks refer to.
+    std::unique_ptr<RayCaster> raycaster;
+    std::unique_ptr<Integrator> integrator;
+    TaskGraph startup;
 
-    auto config_path = Config::inst().GetOption<std::string>("config");
-    if (config_path != "")
-        Config::inst().Load(config_path);
+    auto configuration = startup.Add(
+        "configuration",
+        [&]() {
+            Config::inst().Load(argc, argv);
 
-    auto rtc_path = Config::inst().GetOption<std::string>("rtc_file");
-    if (rtc_path != "")
-        scene.point_lights_ = Config::inst().LoadRTC(rtc_path);
+            auto config_path = Config::inst().GetOption<std::string>("config");
+            if (config_path != "")
+                Config::inst().Load(config_path);
 
-    Config::inst().Load(argc, argv);
+            auto rtc_path = Config::inst().GetOption<std::string>("rtc_file");
+            if (rtc_path != "")
+                scene.point_lights_ = Config::inst().LoadRTC(rtc_path);
 
-    LoggingSingleton::inst().SetConsoleVerbosity(
-        Config::inst().GetOption<bool>("verbose"));
-    LoggingSingleton::inst().AddLogFile(
-        Config::inst().GetOption<std::string>("log_file"));
+            Config::inst().Load(argc, argv);
 
-    Config::inst().DumpSettings();
+            LoggingSingleton::inst().SetConsoleVerbosity(
+                Config::inst().GetOption<bool>("verbose"));
+            LoggingSingleton::inst().AddLogFile(
+                Config::inst().GetOption<std::string>("log_file"));
+
+            Config::inst().DumpSettings();
+        },
+        {}, true);
+    startup.Wait(configuration);
 
     //====================
     scene.skybox_ = Skybox();
@@ -39,45 +53,88 @@ int main(int argc, char **argv)
     bool interactive = Config::inst().GetOption<bool>("interactive");
     glm::vec3 ambient_rgb_ = Config::inst().GetOption<glm::vec3>("ambient_light");
 
-    if (!interactive)
-        putenv((char *)"SDL_VIDEODRIVER=dummy");
-    SDL2pp::SDL sdl_(SDL_INIT_VIDEO);
-
     if (scene.point_lights_.size() > 0)
         scene.ambient_light_ = {ambient_rgb_};
     else
         scene.ambient_light_ = {1.0f, 1.0f, 1.0f};
 
-    scene.mesh_ =
-        std::make_unique<Mesh>(Config::inst().GetOption<string>("scene"), scene);
-    // scene.renderables_.push_back(new Mesh("res/view_test/cornell_box.obj"));
-    /*
-        scene.point_lights_.push_back({
-            glm::vec3(278.0f, 448.0f, 279.5f),
-            glm::vec3(0.7f, 0.7f, 0.7f),
-        });
-        */
-    // scene.point_lights_.push_back({
-    //    glm::vec3(100.0f, 220.0f, 100.5f),
-    //    glm::vec3(0.8f, 0.8f, 0.8f),
-    //});
-
-    ViewRayCaster vis_rt(scene);
+    auto import = startup.Add("import", [&]() {
+        scene.mesh_ =
+            std::make_unique<Mesh>(Config::inst().GetOption<string>("scene"), scene);
+    });
+    // the mesh decodes the textures on threads of its own, the task waits for them
+    auto texture_decode = startup.Add(
+        "texture decode", [&]() { scene.mesh_->WaitForTextures(); }, {import});
+    auto acceleration_structure = startup.Add(
+        "acceleration structure",
+        [&]() { raycaster = std::make_unique<RayCaster>(scene.mesh_); }, {import});
+    auto integrator_setup = startup.Add(
+        "integrator", [&]() { integrator = MakeIntegrator(scene, *raycaster); },
+        {acceleration_structure});
+
+    // before the workers start: putenv races with any thread reading the environment,
+    // and the texture decode loads the images through SDL
+    if (!interactive)
+        putenv((char *)"SDL_VIDEODRIVER=dummy");
+    SDL2pp::SDL sdl_(SDL_INIT_VIDEO);
 
-    if (interactive)
-    {
-        ViewOpenGL vis_gl(
-            (scene.mesh_->GetUpperBound() - scene.mesh_->GetLowerBound()).x / 100.0f);
+    // the most tasks running at once, the import being alone
+    startup.Start(2);
 
-        scene.mesh_->SetupForOpenGL();
+    // the windows of the ray tracer's preview are created on the main thread too
+    std::unique_ptr<ViewRayCaster> vis_rt;
+    auto raytracer_preview = startup.Add(
+        "ray tracer preview",
+        [&]() {
+            vis_rt = std::make_unique<ViewRayCaster>(std::move(raycaster),
+                                                     std::move(integrator));
+        },
+        {integrator_setup}, true);
 
+    if (interactive)
+    {
+        std::unique_ptr<ViewOpenGL> vis_gl;
+        auto window = startup.Add(
+            "OpenGL preview",
+            [&]() {
+                vis_gl = std::make_unique<ViewOpenGL>(
+                    (scene.mesh_->GetUpperBound() - scene.mesh_->GetLowerBound()).x /
+                    100.0f);
+            },
+            {import}, true);
+        auto geometry_upload = startup.Add(
+            "geometry upload", [&]() { scene.mesh_->SetupGeometryForOpenGL(); }, {window},
+            true);
+        auto texture_upload = startup.Add(
+            "texture upload", [&]() { scene.mesh_->SetupTexturesForOpenGL(); },
+            {geometry_upload, texture_decode}, true);
+
+        startup.Wait(geometry_upload);
+
+        // the geometry is drawn right away, the textures and the ray tracer join in
+        // when their tasks are done
+        bool textures_uploaded = false, timings_logged = false;
         bool exit_requested = false;
         while (!exit_requested)
         {
-            vis_gl.Render(scene);
-            vis_rt.Render();
+            if (!textures_uploaded && startup.Done(texture_decode))
+            {
+                startup.Wait(texture_upload);
+                textures_uploaded = true;
+            }
+            if (!vis_rt && startup.Done(integrator_setup))
+                startup.Wait(raytracer_preview);
+            if (!timings_logged && textures_uploaded && vis_rt)
+            {
+                startup.LogTimings();
+                timings_logged = true;
+            }
 
-            while (auto action = vis_gl.DequeueAction())
+            vis_gl->Render(scene);
+            if (vis_rt)
+                vis_rt->Render();
+
+            while (auto action = vis_gl->DequeueAction())
             {
                 switch (*action)
                 {
@@ -85,16 +142,18 @@ int main(int argc, char **argv)
                     exit_requested = true;
                     break;
                 case ViewOpenGL::TakePicture:
-                    vis_rt.TakePicture(vis_gl.GetCameraPos(), vis_gl.GetMVP(), scene);
+                    startup.Wait(raytracer_preview);
+                    vis_rt->TakePicture(vis_gl->GetCameraPos(), vis_gl->GetMVP(), scene);
                     break;
                 case ViewOpenGL::OneShot:
                 {
-                    auto inv_mvp = glm::inverse(vis_gl.GetMVP());
+                    startup.Wait(raytracer_preview);
+                    auto inv_mvp = glm::inverse(vis_gl->GetMVP());
                     glm::vec4 ray_r(0.0f, 0.0f, 1.0f, 1.0f);
 
                     auto target = inv_mvp * ray_r;
-                    auto object_hit = vis_rt.pathtracer_.DebugTrace(
-                        vis_gl.GetCameraPos(), glm::normalize(target));
+                    auto object_hit = vis_rt->integrator_->DebugTrace(
+                        vis_gl->GetCameraPos(), glm::normalize(target));
 
                     if (object_hit)
                         log.Info() << "Oneshot hit object " << *object_hit;
@@ -112,7 +171,12 @@ int main(int argc, char **argv)
     }
     else
     {
+        startup.Wait(raytracer_preview);
+        startup.Wait(texture_decode);
+        startup.LogTimings();
+
         CameraManager camera_manager(1.0f);
-        vis_rt.TakePicture(camera_manager.GetCameraPos(), camera_manager.GetMVP(), scene);
+        vis_rt->TakePicture(camera_manager.GetCameraPos(), camera_manager.GetMVP(),
+                            scene);
     }
-}
\ No newline at end of file
+}
@@ -7,37 +7,58 @@
 #include "log.h"
 #include "mesh.h"
 
-glm::vec3 GetDiffuse(const Vertex &v1, const Vertex &v2, const Vertex &v3,
-                     glm::vec3 bary_cords, const Texture &tex)
+#include <cmath>
+
+namespace
+{
+
+// same test as aiColor3D::IsBlack, the descriptions keep the raw colours of the file
+bool IsBlack(const glm::vec3 &color)
+{
+    const float epsilon = 10e-3f;
+    return std::fabs(color.x) < epsilon && std::fabs(color.y) < epsilon &&
+           std::fabs(color.z) < epsilon;
+}
+
+} // namespace
+
+MaterialFromAssimp::MaterialFromAssimp(const MaterialDescription &description,
+                                       TextureManager &textures)
+    : diffuse_color_(description.diffuse_), reflective_color_(description.reflective_)
 {
-    glm::vec2 uv(0.0f, 0.0f);
-    uv += v1.tex_ * bary_cords.x;
-    uv += v2.tex_ * bary_cords.y;
-    uv += v3.tex_ * bary_cords.z;
+    parameter_correction_ = Config::inst().GetOption<float>("material_parameter_factor");
+
+    if (!IsBlack(description.emission_))
+        emission_ = description.emission_;
 
-    return tex.GetPixel(uv);
+    if (!IsBlack(description.specular_))
+        specular_color_ = description.specular_;
+
+    texture_used_ = !description.texture_.empty();
+    // untextured materials bind the fallback texture in the OpenGL preview
+    texture_ = textures.Acquire(texture_used_ ? description.texture_ : "res/fail.png");
 }
 
-MaterialFromAssimp::MaterialFromAssimp(aiMaterial *material, std::string dir)
+MaterialDescription MaterialFromAssimp::Describe(aiMaterial *material,
+                                                 const std::string &dir)
 {
+    MaterialDescription description;
+
     aiColor3D diff_color;
     material->Get(AI_MATKEY_COLOR_DIFFUSE, diff_color);
-    diffuse_color_ = glm::vec3(diff_color.r, diff_color.g, diff_color.b);
-    parameter_correction_ = Config::inst().GetOption<float>("material_parameter_factor");
+    description.diffuse_ = glm::vec3(diff_color.r, diff_color.g, diff_color.b);
 
     aiColor3D emission_color, reflective_color, specular_color;
     material->Get(AI_MATKEY_COLOR_EMISSIVE, emission_color);
     material->Get(AI_MATKEY_COLOR_AMBIENT, reflective_color);
     material->Get(AI_MATKEY_COLOR_SPECULAR, specular_color);
 
-    reflective_color_ =
+    description.reflective_ =
         glm::vec3(reflective_color.r, reflective_color.g, reflective_color.b);
-
-    if (!emission_color.IsBlack())
-        emission_ = glm::vec3(emission_color.r, emission_color.g, emission_color.b);
-
-    if (!specular_color.IsBlack())
-        specular_color_ = glm::vec3(specular_color.r, specular_color.g, specular_color.b);
+    description.emission_ =
+        glm::vec3(emission_color.r, emission_color.g, emission_color.b);
+    description.specular_ =
+        glm::vec3(specular_color.r, specular_color.g, specular_color.b);
 
     if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0)
     {
@@ -50,73 +71,37 @@ MaterialFromAssimp::MaterialFromAssimp(aiMaterial *material, std::string dir)
                                      NULL, NULL)))
             ;
 
-        std::string full_path = dir + "/" + path.data;
-        texture_ = std::make_unique<Texture>(GL_TEXTURE_2D, full_path);
-
-        Log("Material").Info() << "Loaded texture " << full_path;
-        texture_used_ = true;
-        return;
+        description.texture_ = dir + "/" + path.data;
+        Log("Material").Info() << "Using texture " << description.texture_;
     }
     else
     {
         Log("Material").Warning() << "No diffuse texture found!";
-        texture_ = std::make_unique<Texture>(GL_TEXTURE_2D, "res/fail.png");
-        texture_used_ = false;
-        return;
     }
-}
 
-glm::vec3 MaterialFromAssimp::BRDF(glm::vec3 from, glm::vec3 p, glm::vec3 to,
-                                   glm::vec3 normal, glm::vec3 barycentric,
-                                   const Vertex &p1, const Vertex &p2,
-                                   const Vertex &p3) const
-{
-    glm::vec3 kd;
-    if (texture_used_)
-        kd = GetDiffuse(p1, p2, p3, barycentric, *texture_);
-    else
-        kd = glm::vec3(1.0f, 1.0f, 1.0f);
-
-    glm::vec3 surface_to_source = from - p;
-    glm::vec3 specular_dir =
-        2.0f * glm::dot<3, float, glm::qualifier::highp>(normal, surface_to_source) *
-            normal -
-        surface_to_source;
-
-    float glossy_term =
-        std::max(0.0f, glm::dot<3, float, glm::qualifier::highp>(to - p, specular_dir) /
-                           glm::length(specular_dir) / glm::length(to - p));
-
-    STRONG_ASSERT(glossy_term <= 1.01f)
-    return std::pow(glossy_term, 15.0f) * reflective_color_ * parameter_correction_ +
-           diffuse_color_ * kd * parameter_correction_;
+    return description;
 }
 
-Material::Reflection MaterialFromAssimp::SampleF(glm::vec3 position, glm::vec3 normal,
-                                                 glm::vec3 in_dir, glm::vec3 barycentric,
-                                                 const Vertex &p1, const Vertex &p2,
-                                                 const Vertex &p3, Sampler &s) const
+MaterialRecord MaterialFromAssimp::Record() const
 {
-    auto dir = s.SampleDirection(normal);
-
-    return {.radiance_ = BRDF(position + in_dir, position, position + dir, normal,
-                              barycentric, p1, p2, p3),
-            .pdf_ = 1.0f / (2.0f * glm::pi<float>()),
-            .dir_ = dir};
+    MaterialRecord record;
+    record.albedo_ = diffuse_color_;
+    record.glossy_ = reflective_color_ * parameter_correction_;
+    record.specular_ =
+        specular_color_ ? *specular_color_ * parameter_correction_ : glm::vec3(0.0f);
+    record.emission_ = Emission();
+    record.parameter_correction_ = parameter_correction_;
+    record.texture_ = -1;
+    record.kind_ =
+        record.glossy_ == glm::vec3(0.0f) ? BSDFKind::Lambertian : BSDFKind::Phong;
+    record.has_specular_ = HasSpecular();
+    record.emissive_ = IsEmissive();
+    return record;
 }
 
-Material::Reflection
-MaterialFromAssimp::SampleSpecular(glm::vec3 position, glm::vec3 normal, glm::vec3 in_dir,
-                                   glm::vec3 barycentric, const Vertex &p1,
-                                   const Vertex &p2, const Vertex &p3, Sampler &s) const
+const Texture *MaterialFromAssimp::DiffuseTexture() const
 {
-    glm::vec3 specular_dir =
-        2.0f * glm::dot<3, float, glm::qualifier::highp>(normal, -in_dir) * normal -
-        -in_dir;
-
-    return {.radiance_ = *specular_color_ * parameter_correction_,
-            .pdf_ = 1.0f,
-            .dir_ = specular_dir};
+    return texture_used_ ? texture_ : nullptr;
 }
 
 void MaterialFromAssimp::SetupForOpenGL()
@@ -0,0 +1,73 @@
+
+#include "material_table.h"
+#include "mesh.h"
+#include "texture.h"
+
+uint32_t MaterialTable::AddMaterial(MaterialRecord record, const Texture *texture)
+{
+    record.texture_ = -1;
+    if (texture)
+    {
+        record.texture_ = int32_t(textures_.size());
+        textures_.push_back(texture);
+    }
+
+    records_.push_back(record);
+    return uint32_t(records_.size() - 1);
+}
+
+void MaterialTable::AddObject(uint32_t record)
+{
+    STRONG_ASSERT(record < records_.size());
+    object_records_.push_back(record);
+}
+
+SurfaceInteraction MaterialTable::Interact(uint32_t object_id, glm::vec3 position,
+                                           glm::vec3 normal, glm::vec3 barycentric,
+                                           const Vertex &p1, const Vertex &p2,
+                                           const Vertex &p3, float footprint) const
+{
+    const MaterialRecord &record = GetRecord(object_id);
+
+    SurfaceInteraction si;
+    si.position_ = position;
+    // the mirror and glossy directions need a unit normal, ray caster hits have one
+    // already and change by rounding only
+    si.normal_ = glm::normalize(normal);
+    si.shading_normal_ = glm::normalize(p1.norm_ * barycentric.x + p2.norm_ * barycentric.y +
+                                        p3.norm_ * barycentric.z);
+    si.barycentric_ = barycentric;
+    si.uv_ = p1.tex_ * barycentric.x + p2.tex_ * barycentric.y + p3.tex_ * barycentric.z;
+
+    si.albedo_ = record.albedo_;
+    if (record.texture_ >= 0)
+    {
+        const Texture &texture = *textures_[record.texture_];
+        if (footprint > 0.0f)
+        {
+            // texels per unit of length on the triangle, from the ratio of its areas
+            // in texel and world space (Akenine-Moller et al. 2019)
+            glm::vec2 duv1 = p2.tex_ - p1.tex_, duv2 = p3.tex_ - p1.tex_;
+            float texel_area = std::abs(duv1.x * duv2.y - duv1.y * duv2.x) *
+                               float(texture.GetWidth()) * float(texture.GetHeight());
+            float world_area =
+                glm::length(glm::cross(p2.pos_ - p1.pos_, p3.pos_ - p1.pos_));
+
+            float lod = world_area > 0.0f
+                            ? std::log2(footprint * std::sqrt(texel_area / world_area))
+                            : 0.0f;
+            si.albedo_ *= texture.Sample(si.uv_, lod);
+        }
+        else
+        {
+            si.albedo_ *= texture.GetPixel(si.uv_);
+        }
+    }
+    si.diffuse_ = si.albedo_ * record.parameter_correction_;
+    si.glossy_ = record.glossy_;
+
+    si.kind_ = record.kind_;
+    si.record_ = &record;
+
+    return si;
+}
@@ -0,0 +1,48 @@
+#include <vector>
+
+#include "config.h"
+#include "film.h"
+#include "log.h"
+
+using std::string;
+
+// Sums partial renders of one job (each rendered with its own --seed) into one image.
+// usage: merge_renders <output> <checkpoint> [<checkpoint>]* [--iso=<value>]
+int main(int argc, char **argv)
+{
+    Log log("merge");
+    std::vector<string> checkpoints;
+    std::vector<char *> options = {argv[0]};
+
+    for (int arg_i = 1; arg_i < argc; arg_i++)
+    {
+        if (string(argv[arg_i]).find("--") == 0)
+            options.push_back(argv[arg_i]);
+        else
+            checkpoints.push_back(argv[arg_i]);
+    }
+
+    if (checkpoints.size() < 2)
+    {
+        log.Error() << "usage: " << argv[0]
+                    << " <output> <checkpoint> [<checkpoint>]* [--iso=<value>]";
+        return 1;
+    }
+
+    Config::inst().Load(options.size(), options.data());
+
+    string output = checkpoints[0];
+    Film merged = Film::LoadCheckpoint(checkpoints[1]);
+
+    for (unsigned int i = 2; i < checkpoints.size(); i++)
+    {
+        if (!merged.Merge(Film::LoadCheckpoint(checkpoints[i])))
+            log.Warning() << "Skipping " << checkpoints[i];
+    }
+
+    log.Info() << "Merged renders of " << merged.GetSeeds().size()
+               << " seeds. Saving to: " << output << ".exr and " << output << ".lwcp";
+
+    merged.SaveCheckpoint(output + ".lwcp");
+    merged.WriteEXR(output + ".exr", Config::inst().GetOption<float>("iso"));
+}
@@ -2,6 +2,8 @@
 #include "mesh.h"
 #include "config.h"
 #include "exceptions.h"
+#include "geometry_preprocessing.h"
+#include "scene_cache.h"
 
 // https://stackoverflow.com/questions/29184311/how-to-rotate-a-skinned-models-bones-in-c-using-assimp
 inline glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4 &from)
@@ -28,23 +30,58 @@ inline glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4 &from)
     return to;
 }
 
-Mesh::MeshEntry::MeshEntry(std::vector<Vertex> &&Vertices,
-                           std::vector<glm::u32> &&Indices, Material &mat)
-    : vertices_(std::move(Vertices)), indices_(std::move(Indices)), material_(mat){};
+namespace
+{
+
+// the objects of the node and its children, in draw order
+void FlattenNodes(const aiNode *node, glm::mat4 transform,
+                  std::vector<SceneDescription::Draw> *draws)
+{
+    transform = transform * aiMatrix4x4ToGlm(node->mTransformation);
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        draws->push_back({transform, node->mMeshes[i]});
+
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+        FlattenNodes(node->mChildren[i], transform, draws);
+}
+
+// of the geometry_preprocessing option, negative when it's off
+float WeldTolerance()
+{
+    if (!Config::inst().GetOption<bool>("geometry_preprocessing"))
+        return -1.0f;
+    return std::max(0.0f, Config::inst().GetOption<float>("weld_tolerance"));
+}
+
+} // namespace
+
+Mesh::MeshEntry::MeshEntry(Span<const Vertex> vertices, Span<const glm::u32> indices,
+                           Material &mat, bool compact)
+    : vertices_(compact ? Span<const Vertex>() : vertices), indices_(indices),
+      compact_(compact ? CompactVertices(vertices) : CompactVertices()), material_(mat){};
 
 void Mesh::MeshEntry::SetupForOpenGL()
 {
+    // the preview draws full precision vertices, compact ones are decoded for the upload
+    std::vector<Vertex> decoded;
+    Span<const Vertex> vertices = vertices_;
+    if (!compact_.Empty())
+    {
+        decoded.reserve(compact_.Size());
+        for (uint32_t i = 0; i < compact_.Size(); i++)
+            decoded.push_back(compact_.Decode(i));
+        vertices = decoded;
+    }
+
     glGenBuffers(1, &VB);
     glBindBuffer(GL_ARRAY_BUFFER, VB);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices_.size(), &vertices_[0],
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(),
                  GL_STATIC_DRAW);
 
     glGenBuffers(1, &IB);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices_.size(),
                  &indices_[0], GL_STATIC_DRAW);
-
-    material_.SetupForOpenGL();
 }
 
 Mesh::MeshEntry::~MeshEntry()
@@ -63,19 +100,9 @@ Mesh::Mesh(std::string filename, Scene &scene)
       upper_bound_(std::numeric_limits<float>::min(), std::numeric_limits<float>::min(),
                    std::numeric_limits<float>::min())
 {
-    const aiScene *ai_scene = importer_.ReadFile(
-        filename.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-                              aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
-
-    STRONG_ASSERT(ai_scene,
-                  "Error parsing " + filename + " : " + importer_.GetErrorString());
-
     std::string::size_type slash = filename.find_last_of("/");
     std::string dir;
 
-    log_.Info() << "Scene has textures? " << ai_scene->HasTextures();
-    log_.Info() << "Scene has lights? " << ai_scene->HasLights();
-
     if (slash == std::string::npos)
         dir = ".";
     else if (slash == 0)
@@ -83,22 +110,75 @@ Mesh::Mesh(std::string filename, Scene &scene)
     else
         dir = filename.substr(0, slash);
 
-    for (unsigned int i = 0; i < ai_scene->mNumMaterials; i++)
-        materials_.emplace_back(ai_scene->mMaterials[i], dir);
+    std::string cache_path = filename + ".lwsc";
+    bool use_cache = Config::inst().GetOption<bool>("scene_cache");
+    if (use_cache && ReadSceneCache(cache_path, filename, dir, &description_) &&
+        description_.weld_tolerance_ == WeldTolerance())
+    {
+        log_.Info() << "Mapped the scene cache " << cache_path;
+    }
+    else
+    {
+        description_ = Import(filename, dir);
+        if (use_cache && WriteSceneCache(cache_path, filename, dir, description_))
+        {
+            // the geometry is viewed in the file written, the imported copy is freed
+            SceneDescription mapped;
+            if (ReadSceneCache(cache_path, filename, dir, &mapped))
+                description_ = std::move(mapped);
+        }
+        else if (use_cache)
+        {
+            log_.Warning() << "Couldn't write the scene cache " << cache_path
+                           << ", keeping the geometry in memory";
+        }
+    }
+
+    for (const auto &material : description_.materials_)
+        materials_.emplace_back(material, textures_);
+    log_.Info() << materials_.size() << " materials share " << textures_.Size()
+                << " textures";
+    // decodes while the geometry and the acceleration structure are built
+    textures_.Prefetch();
+
+    for (const auto &material : materials_)
+        material_table_.AddMaterial(material.Record(), material.DiffuseTexture());
 
-    for (unsigned int i = 0; i < ai_scene->mNumMeshes; i++)
+    bool compact = Config::inst().GetOption<bool>("compact_vertices");
+    size_t full_bytes = 0, compact_bytes = 0;
+    submeshes_.reserve(description_.objects_.size());
+    for (const auto &object : description_.objects_)
     {
-        auto &material = materials_[ai_scene->mMeshes[i]->mMaterialIndex];
-        submeshes_.emplace_back(
-            InitMesh(ai_scene->mMeshes[i], scene.area_lights_, material));
+        STRONG_ASSERT(object.material_ < materials_.size());
+        material_table_.AddObject(object.material_);
+        submeshes_.emplace_back(InitMesh(object, scene.area_lights_, compact));
+        full_bytes += object.vertices_.size() * sizeof(Vertex);
+        compact_bytes += submeshes_.back().compact_.Bytes();
     }
 
-    scene_ = ai_scene;
+    if (compact)
+    {
+        // The full precision vertices are only referenced by the submeshes built above.
+        // From the scene cache they are mapped pages concurrent renders share, the
+        // compact copy replacing them is private to this process.
+        for (auto &object : description_.objects_)
+            object.vertices_ = Span<const Vertex>();
+        description_.imported_vertices_.clear();
+        description_.imported_vertices_.shrink_to_fit();
+        log_.Info() << "Compact vertices take " << compact_bytes / 1024
+                    << " KiB instead of " << full_bytes / 1024 << " KiB";
+    }
 }
 
 Mesh::~Mesh() {}
 
 void Mesh::SetupForOpenGL()
+{
+    SetupGeometryForOpenGL();
+    SetupTexturesForOpenGL();
+}
+
+void Mesh::SetupGeometryForOpenGL()
 {
     for (auto &submesh : submeshes_)
     {
@@ -106,25 +186,96 @@ void Mesh::SetupForOpenGL()
     }
 }
 
-Mesh::MeshEntry Mesh::InitMesh(const aiMesh *mesh, std::vector<AreaLight> &lights,
-                               const Material &material)
+void Mesh::SetupTexturesForOpenGL()
 {
-    std::vector<Vertex> Vertices;
-    std::vector<glm::u32> Indices;
+    for (auto &material : materials_)
+        material.SetupForOpenGL();
+}
 
-    const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+void Mesh::WaitForTextures() { textures_.Wait(); }
+
+SceneDescription Mesh::Import(const std::string &filename, const std::string &dir)
+{
+    // the scene is freed with the importer once converted
+    Assimp::Importer importer;
+    const aiScene *ai_scene = importer.ReadFile(
+        filename.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+                              aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
+
+    STRONG_ASSERT(ai_scene,
+                  "Error parsing " + filename + " : " + importer.GetErrorString());
+
+    log_.Info() << "Scene has textures? " << ai_scene->HasTextures();
+    log_.Info() << "Scene has lights? " << ai_scene->HasLights();
+
+    SceneDescription description;
+    description.weld_tolerance_ = WeldTolerance();
+    PreprocessingReport report;
+    size_t triangles = 0;
 
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    for (unsigned int i = 0; i < ai_scene->mNumMaterials; i++)
+        description.materials_.push_back(
+            MaterialFromAssimp::Describe(ai_scene->mMaterials[i], dir));
+
+    const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+    for (unsigned int m = 0; m < ai_scene->mNumMeshes; m++)
     {
-        const aiVector3D *pPos = &(mesh->mVertices[i]);
-        const aiVector3D *pNormal = &(mesh->mNormals[i]);
-        const aiVector3D *pTexCoord =
-            mesh->HasTextureCoords(0) ? &(mesh->mTextureCoords[0][i]) : &Zero3D;
+        const aiMesh *mesh = ai_scene->mMeshes[m];
+        std::vector<Vertex> vertices;
+        std::vector<glm::u32> indices;
+
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            const aiVector3D *pPos = &(mesh->mVertices[i]);
+            const aiVector3D *pNormal = &(mesh->mNormals[i]);
+            const aiVector3D *pTexCoord =
+                mesh->HasTextureCoords(0) ? &(mesh->mTextureCoords[0][i]) : &Zero3D;
+
+            vertices.push_back({glm::vec3(pPos->x, pPos->y, pPos->z),
+                                glm::vec2(pTexCoord->x, pTexCoord->y),
+                                glm::vec3(pNormal->x, pNormal->y, pNormal->z)});
+        }
+
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace &Face = mesh->mFaces[i];
+            assert(Face.mNumIndices == 3);
+            indices.push_back(Face.mIndices[0]);
+            indices.push_back(Face.mIndices[1]);
+            indices.push_back(Face.mIndices[2]);
+        }
+
+        triangles += indices.size() / 3;
+        if (description.weld_tolerance_ >= 0.0f)
+            report +=
+                PreprocessGeometry(&vertices, &indices, description.weld_tolerance_);
+
+        // the arrays keep their buffers when moved, the spans stay valid
+        description.imported_vertices_.push_back(std::move(vertices));
+        description.imported_indices_.push_back(std::move(indices));
+        description.objects_.push_back({mesh->mMaterialIndex,
+                                        description.imported_vertices_.back(),
+                                        description.imported_indices_.back()});
+    }
+
+    if (description.weld_tolerance_ >= 0.0f)
+        log_.Info() << "Preprocessing welded " << report.welded_vertices_
+                    << " vertices, dropped " << report.degenerate_triangles_
+                    << " degenerate and " << report.duplicate_triangles_
+                    << " duplicate triangles of " << triangles << " and "
+                    << report.unused_vertices_ << " unused vertices";
+
+    FlattenNodes(ai_scene->mRootNode, glm::mat4(1.0f), &description.draws_);
+    return description;
+}
 
-        Vertex v = {glm::vec3(pPos->x, pPos->y, pPos->z),
-                    glm::vec2(pTexCoord->x, pTexCoord->y),
-                    glm::vec3(pNormal->x, pNormal->y, pNormal->z)};
+Mesh::MeshEntry Mesh::InitMesh(const SceneDescription::Object &object,
+                               std::vector<AreaLight> &lights, bool compact)
+{
+    const Material &material = materials_[object.material_];
 
+    for (const auto &v : object.vertices_)
+    {
         for (int i = 0; i < 3; i++)
         {
             if (v.pos_[i] < lower_bound_[i])
@@ -132,44 +283,34 @@ Mesh::MeshEntry Mesh::InitMesh(const aiMesh *mesh, std::vector<AreaLight> &light
             else if (v.pos_[i] > upper_bound_[i])
                 upper_bound_[i] = v.pos_[i];
         }
-
-        Vertices.push_back(v);
     }
 
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
-    {
-        const aiFace &Face = mesh->mFaces[i];
-        assert(Face.mNumIndices == 3);
-        Indices.push_back(Face.mIndices[0]);
-        Indices.push_back(Face.mIndices[1]);
-        Indices.push_back(Face.mIndices[2]);
+    MeshEntry entry(object.vertices_, object.indices_, materials_[object.material_],
+                    compact);
 
-        if (material.IsEmissive())
-        {
-            lights.emplace_back(Vertices[Face.mIndices[0]].pos_,
-                                Vertices[Face.mIndices[1]].pos_,
-                                Vertices[Face.mIndices[2]].pos_, material);
-        }
+    if (material.IsEmissive())
+    {
+        // the surface the rays hit, light samples off the quantized one would be
+        // shadowed by it or float above it
+        PositionStream positions = entry.Positions();
+        const auto &indices = object.indices_;
+        for (size_t i = 0; i < indices.size(); i += 3)
+            lights.emplace_back(positions[indices[i]], positions[indices[i + 1]],
+                                positions[indices[i + 2]], material);
     }
 
-    return MeshEntry(std::move(Vertices), std::move(Indices),
-                     materials_[mesh->mMaterialIndex]);
+    return entry;
 }
 
-void Mesh::RenderByOpenGL(OpenGLRenderingContext context, aiNode *node)
+void Mesh::RenderByOpenGL(OpenGLRenderingContext context)
 {
-    if (node == nullptr)
-        node = scene_->mRootNode;
-
-    context.vp = context.vp * aiMatrix4x4ToGlm(node->mTransformation);
-
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
 
-    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    for (const auto &draw : description_.draws_)
     {
-        auto &obj = submeshes_[node->mMeshes[i]];
+        auto &obj = submeshes_[draw.object_];
 
         glBindBuffer(GL_ARRAY_BUFFER, obj.VB);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
@@ -181,7 +322,8 @@ void Mesh::RenderByOpenGL(OpenGLRenderingContext context, aiNode *node)
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj.IB);
 
-        glUniformMatrix4fv(context.mvp_id_, 1, GL_FALSE, &context.vp[0][0]);
+        glm::mat4 mvp = context.vp * draw.transform_;
+        glUniformMatrix4fv(context.mvp_id_, 1, GL_FALSE, &mvp[0][0]);
 
         obj.material_.BindForOpenGL(context, GL_TEXTURE0);
         glDrawElements(GL_TRIANGLES, obj.indices_.size(), GL_UNSIGNED_INT, 0);
@@ -190,11 +332,6 @@ void Mesh::RenderByOpenGL(OpenGLRenderingContext context, aiNode *node)
     glDisableVertexAttribArray(0);
     glDisableVertexAttribArray(1);
     glDisableVertexAttribArray(2);
-
-    for (unsigned int i = 0; i < node->mNumChildren; i++)
-    {
-        RenderByOpenGL(context, node->mChildren[i]);
-    }
 }
 
 Material &Mesh::GetMaterial(uint32_t obj_index_)
@@ -0,0 +1,312 @@
+
+#include <glm/gtc/constants.hpp>
+
+#include "path_guiding.h"
+
+const int MAX_DIRECTIONAL_DEPTH = 20;
+
+namespace
+{
+
+void AtomicAdd(std::atomic<float> &target, float value)
+{
+    float current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value,
+                                         std::memory_order_relaxed))
+        ;
+}
+
+glm::vec2 DirectionToSquare(glm::vec3 dir)
+{
+    float cos_theta = glm::clamp(dir.z, -1.0f, 1.0f);
+    float phi = std::atan2(dir.y, dir.x);
+    if (phi < 0.0f)
+        phi += 2.0f * glm::pi<float>();
+
+    return glm::min(glm::vec2((cos_theta + 1.0f) * 0.5f, phi / (2.0f * glm::pi<float>())),
+                    glm::vec2(1.0f - 1e-7f));
+}
+
+glm::vec3 SquareToDirection(glm::vec2 p)
+{
+    float cos_theta = 2.0f * p.x - 1.0f;
+    float sin_theta = std::sqrt(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+    float phi = 2.0f * glm::pi<float>() * p.y;
+
+    return glm::vec3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+}
+
+// quadrant q covers x half (q & 1) and y half (q >> 1), p is moved into it
+int Quadrant(glm::vec2 &p)
+{
+    int q = 0;
+    for (int axis = 0; axis < 2; axis++)
+    {
+        if (p[axis] >= 0.5f)
+        {
+            q |= 1 << axis;
+            p[axis] = p[axis] * 2.0f - 1.0f;
+        }
+        else
+        {
+            p[axis] = p[axis] * 2.0f;
+        }
+    }
+    return q;
+}
+
+} // namespace
+
+DirectionalDistribution::Node::Node() : children_{{0, 0, 0, 0}}
+{
+    for (auto &sum : sum_)
+        sum.store(0.0f, std::memory_order_relaxed);
+}
+
+DirectionalDistribution::Node::Node(const Node &other) { *this = other; }
+
+DirectionalDistribution::Node &DirectionalDistribution::Node::operator=(const Node &other)
+{
+    for (int q = 0; q < 4; q++)
+        sum_[q].store(other.sum_[q].load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+    children_ = other.children_;
+    return *this;
+}
+
+DirectionalDistribution::DirectionalDistribution() : nodes_(1) {}
+
+void DirectionalDistribution::Record(glm::vec3 dir, float value)
+{
+    if (!(value > 0.0f) || std::isinf(value))
+        return;
+
+    glm::vec2 p = DirectionToSquare(dir);
+    uint32_t node_id = 0;
+
+    while (true)
+    {
+        int q = Quadrant(p);
+        if (nodes_[node_id].children_[q] == 0)
+        {
+            AtomicAdd(nodes_[node_id].sum_[q], value);
+            return;
+        }
+        node_id = nodes_[node_id].children_[q];
+    }
+}
+
+float DirectionalDistribution::Accumulate(uint32_t node_id)
+{
+    float total = 0.0f;
+    for (int q = 0; q < 4; q++)
+    {
+        if (uint32_t child = nodes_[node_id].children_[q])
+            nodes_[node_id].sum_[q].store(Accumulate(child), std::memory_order_relaxed);
+        total += nodes_[node_id].sum_[q].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void DirectionalDistribution::Accumulate() { Accumulate(0); }
+
+float DirectionalDistribution::Total() const
+{
+    float total = 0.0f;
+    for (const auto &sum : nodes_[0].sum_)
+        total += sum.load(std::memory_order_relaxed);
+    return total;
+}
+
+glm::vec3 DirectionalDistribution::Sample(glm::vec2 u) const
+{
+    glm::vec2 origin(0.0f), size(1.0f);
+    uint32_t node_id = 0;
+
+    while (true)
+    {
+        const Node &node = nodes_[node_id];
+        float s[4];
+        for (int q = 0; q < 4; q++)
+            s[q] = node.sum_[q].load(std::memory_order_relaxed);
+
+        if (s[0] + s[1] + s[2] + s[3] <= 0.0f)
+            break;
+
+        // pick the x half, then the y half inside it, reusing the random numbers
+        float left = s[0] + s[2], right = s[1] + s[3];
+        int x_bit = u.x * (left + right) < left ? 0 : 1;
+        u.x = x_bit == 0 ? u.x * (left + right) / left
+                         : (u.x * (left + right) - left) / right;
+
+        float bottom = s[x_bit], top = s[x_bit + 2];
+        int y_bit = u.y * (bottom + top) < bottom ? 0 : 1;
+        u.y = y_bit == 0 ? u.y * (bottom + top) / bottom
+                         : (u.y * (bottom + top) - bottom) / top;
+
+        u = glm::clamp(u, glm::vec2(0.0f), glm::vec2(1.0f - 1e-7f));
+
+        size *= 0.5f;
+        origin += glm::vec2(float(x_bit), float(y_bit)) * size;
+
+        int q = x_bit | (y_bit << 1);
+        if (node.children_[q] == 0)
+            break;
+        node_id = node.children_[q];
+    }
+
+    return SquareToDirection(origin + u * size);
+}
+
+float DirectionalDistribution::Pdf(glm::vec3 dir) const
+{
+    glm::vec2 p = DirectionToSquare(dir);
+    float density = 1.0f;
+    uint32_t node_id = 0;
+
+    while (true)
+    {
+        const Node &node = nodes_[node_id];
+        float total = 0.0f;
+        for (const auto &sum : node.sum_)
+            total += sum.load(std::memory_order_relaxed);
+
+        if (total <= 0.0f)
+            break;
+
+        int q = Quadrant(p);
+        density *= 4.0f * node.sum_[q].load(std::memory_order_relaxed) / total;
+
+        if (node.children_[q] == 0)
+            break;
+        node_id = node.children_[q];
+    }
+
+    // the square maps onto the 4 pi steradians uniformly
+    return density / (4.0f * glm::pi<float>());
+}
+
+void DirectionalDistribution::RefineNode(uint32_t node_id,
+                                         const DirectionalDistribution &source,
+                                         int source_id, float energy, float total,
+                                         float threshold, int depth)
+{
+    for (int q = 0; q < 4; q++)
+    {
+        int source_child = -1;
+        float child_energy = energy / 4.0f;
+        if (source_id >= 0)
+        {
+            child_energy = source.nodes_[source_id].sum_[q].load(std::memory_order_relaxed);
+            if (source.nodes_[source_id].children_[q] != 0)
+                source_child = source.nodes_[source_id].children_[q];
+        }
+
+        if (depth < MAX_DIRECTIONAL_DEPTH && child_energy > threshold * total)
+        {
+            uint32_t child_id = nodes_.size();
+            nodes_.emplace_back();
+            nodes_[node_id].children_[q] = child_id;
+
+            RefineNode(child_id, source, source_child, child_energy, total, threshold,
+                       depth + 1);
+        }
+    }
+}
+
+DirectionalDistribution DirectionalDistribution::Refined(float threshold) const
+{
+    DirectionalDistribution ret;
+    float total = Total();
+
+    if (total > 0.0f)
+        ret.RefineNode(0, *this, 0, total, total, threshold, 1);
+
+    return ret;
+}
+
+GuidingField::Region::Region() : samples_(0) {}
+
+GuidingField::Region::Region(const Region &other)
+    : sampling_(other.sampling_), training_(other.training_),
+      samples_(other.samples_.load(std::memory_order_relaxed))
+{
+}
+
+GuidingField::GuidingField(glm::vec3 lower_bound, glm::vec3 upper_bound,
+                           uint32_t spatial_threshold, float directional_threshold)
+    : lower_bound_(lower_bound), upper_bound_(upper_bound),
+      spatial_threshold_(spatial_threshold), directional_threshold_(directional_threshold)
+{
+    Reset();
+}
+
+void GuidingField::Reset()
+{
+    nodes_ = {Node{0, {0, 0}, 0}};
+    regions_.clear();
+    regions_.push_back(std::make_unique<Region>());
+}
+
+void GuidingField::Refine(uint32_t pass)
+{
+    for (auto &region : regions_)
+        region->training_.Accumulate();
+
+    // split busy regions, the loop reaches the new nodes too
+    uint32_t threshold = uint32_t(float(spatial_threshold_) * std::sqrt(std::ldexp(1.0f, pass)));
+    for (uint32_t i = 0; i < nodes_.size(); i++)
+    {
+        if (nodes_[i].children_[0] != 0)
+            continue;
+
+        Region &region = *regions_[nodes_[i].region_];
+        uint32_t samples = region.samples_.load(std::memory_order_relaxed);
+        if (samples <= threshold)
+            continue;
+
+        region.samples_.store(samples / 2, std::memory_order_relaxed);
+        regions_.push_back(std::make_unique<Region>(region));
+
+        uint8_t child_axis = (nodes_[i].axis_ + 1) % 3;
+        uint32_t first_child = nodes_.size();
+        nodes_.push_back(Node{child_axis, {0, 0}, nodes_[i].region_});
+        nodes_.push_back(Node{child_axis, {0, 0}, uint32_t(regions_.size() - 1)});
+
+        nodes_[i].children_[0] = first_child;
+        nodes_[i].children_[1] = first_child + 1;
+    }
+
+    for (auto &region : regions_)
+    {
+        region->sampling_ = region->training_;
+        region->training_ = region->sampling_.Refined(directional_threshold_);
+        region->samples_.store(0, std::memory_order_relaxed);
+    }
+}
+
+GuidingField::Region &GuidingField::GetRegion(glm::vec3 position) const
+{
+    glm::vec3 p = glm::clamp((position - lower_bound_) / (upper_bound_ - lower_bound_),
+                             glm::vec3(0.0f), glm::vec3(1.0f - 1e-7f));
+    uint32_t node_id = 0;
+
+    while (nodes_[node_id].children_[0] != 0)
+    {
+        const Node &node = nodes_[node_id];
+        if (p[node.axis_] < 0.5f)
+        {
+            p[node.axis_] *= 2.0f;
+            node_id = node.children_[0];
+        }
+        else
+        {
+            p[node.axis_] = p[node.axis_] * 2.0f - 1.0f;
+            node_id = node.children_[1];
+        }
+    }
+
+    return *regions_[nodes_[node_id].region_];
+}
+
+size_t GuidingField::GetRegionCount() const { return regions_.size(); }
@@ -5,12 +5,49 @@
 extern std::string S(glm::vec4 in);
 extern std::string S(glm::vec3 in);
 
-PathTracer::PathTracer(const Scene &scene)
-    : scene_(scene), raycaster_(scene.mesh_),
+PathTracer::PathTracer(const Scene &scene, const RayCaster &raycaster)
+    : Integrator(scene, raycaster),
       recursion_level_(Config::inst().GetOption<int>("recursion")),
       max_reflections_(Config::inst().GetOption<int>("max_reflections")),
-      roulette_factor_(Config::inst().GetOption<float>("roulette_factor"))
+      roulette_factor_(Config::inst().GetOption<float>("roulette_factor")),
+      radiance_cache_depth_(Config::inst().GetOption<int>("radiance_cache_depth")),
+      guiding_fraction_(Config::inst().GetOption<float>("guiding_fraction")),
+      lights_(scene.area_lights_),
+      restir_candidates_(Config::inst().GetOption<int>("restir_candidates")),
+      restir_neighbors_(Config::inst().GetOption<int>("restir_neighbors")),
+      restir_radius_(Config::inst().GetOption<float>("restir_radius")),
+      restir_history_(Config::inst().GetOption<int>("restir_history")),
+      mip_mapping_(Config::inst().GetOption<bool>("mip_mapping"))
 {
+    if (Config::inst().GetOption<bool>("restir") && !lights_.Empty())
+    {
+        reservoirs_ = std::make_unique<ReservoirGrid>();
+
+        // a single pass renders every pixel at once, no neighbour is done before it
+        if (restir_neighbors_ > 0 && !Config::inst().GetOption<bool>("progressive"))
+            log_.Warning() << "ReSTIR reuses candidates of neighbouring pixels only with "
+                              "--progressive=1, each pixel reuses its own only.";
+    }
+
+    if (Config::inst().GetOption<bool>("path_guiding"))
+    {
+        guiding_ = std::make_unique<GuidingField>(
+            scene.mesh_->GetLowerBound(), scene.mesh_->GetUpperBound(),
+            Config::inst().GetOption<int>("guiding_spatial_threshold"),
+            Config::inst().GetOption<float>("guiding_directional_threshold"));
+    }
+
+    if (Config::inst().GetOption<bool>("radiance_cache"))
+    {
+        float diagonal =
+            glm::length(scene.mesh_->GetUpperBound() - scene.mesh_->GetLowerBound());
+
+        radiance_cache_ = std::make_unique<RadianceCache>(
+            Config::inst().GetOption<int>("radiance_cache_size_log2"),
+            Config::inst().GetOption<float>("radiance_cache_min_cell") * diagonal,
+            Config::inst().GetOption<float>("radiance_cache_cell_angle"),
+            Config::inst().GetOption<int>("radiance_cache_min_samples"));
+    }
 }
 
 glm::vec3 PathTracer::FIL(boost::optional<glm::vec3> light) const
@@ -21,26 +58,142 @@ glm::vec3 PathTracer::FIL(boost::optional<glm::vec3> light) const
         return glm::vec3(0.0f, 0.0f, 0.0f);
 }
 
-glm::vec3 PathTracer::Trace(glm::vec3 camera_pos, glm::vec3 dir) const
+void PathTracer::SetCamera(glm::vec3 camera_pos, glm::mat4 inv_mvp, Film &film)
 {
-    Sampler s;
-    return Trace(camera_pos, dir, true, glm::vec3(1.0f, 1.0f, 1.0f), s, recursion_level_);
+    PinholeCamera camera(camera_pos, inv_mvp);
+    if (mip_mapping_)
+        pixel_spread_ = camera.PixelSpread(film.GetWidth(), film.GetHeight());
+    if (reservoirs_)
+        reservoirs_->Resize(film.GetWidth(), film.GetHeight());
 }
 
-boost::optional<int> PathTracer::DebugTrace(glm::vec3 camera_pos, glm::vec3 dir) const
+void PathTracer::StartPass(uint32_t pass)
 {
-    auto result = Trace(camera_pos, dir);
+    if (reservoirs_)
+    {
+        if (pass == 0)
+            reservoirs_->Clear();
+        else
+            reservoirs_->StartPass();
+    }
 
-    log_.Info() << "Randiance from debug ray: " << S(result);
+    // a new picture, possibly from another place
+    if (radiance_cache_ && pass == 0)
+        radiance_cache_->Clear();
 
-    if (auto result = raycaster_.Trace(camera_pos, dir))
-        return result->second.object_id_;
-    else
-        return boost::none;
+    if (guiding_)
+    {
+        if (pass == 0)
+        {
+            guiding_->Reset();
+        }
+        else
+        {
+            guiding_->Refine(pass);
+            log_.Info() << "Path guiding uses " << guiding_->GetRegionCount()
+                        << " regions.";
+        }
+    }
+}
+
+glm::vec3 PathTracer::Trace(glm::vec3 camera_pos, glm::vec3 dir, Sampler &sampler,
+                            PixelAOV *aov, const glm::uvec2 *pixel) const
+{
+    // the reservoir of another pixel may belong to another thread
+    bool resampled = reservoirs_ && pixel && pixel->x < reservoirs_->GetWidth() &&
+                     pixel->y < reservoirs_->GetHeight();
+
+    return Trace(camera_pos, dir, true, sampler, recursion_level_, camera_pos,
+                 {0.0f, pixel_spread_}, aov, resampled ? pixel : nullptr);
+}
+
+glm::vec3 PathTracer::ResampledDirectLight(glm::uvec2 pixel, glm::vec3 origin,
+                                           const TriangleIntersection &intersection,
+                                           const SurfaceInteraction &si,
+                                           Sampler &sampler) const
+{
+    glm::vec3 position = si.position_;
+    glm::vec3 normal = si.normal_;
+    float source_cosine = glm::abs(glm::dot(glm::normalize(position - origin), normal));
+
+    if (glm::dot(normal, origin - position) < 0.0f)
+        normal = -normal;
+
+    // the unshadowed integrand of the light loop in Trace
+    auto contribution = [&](const LightCandidate &light) {
+        glm::vec3 to_light = light.position_ - position;
+        float dist_sq = glm::dot(to_light, to_light);
+        if (dist_sq == 0.0f)
+            return glm::vec3();
+
+        float light_cosine = glm::abs(glm::dot(to_light, normal)) / std::sqrt(dist_sq);
+        return EvaluateBSDF(si, light.position_, origin) * light.emission_ *
+               light_cosine * source_cosine / (dist_sq * glm::pi<float>() * glm::pi<float>());
+    };
+    auto target_pdf = [&](const LightCandidate &light) {
+        glm::vec3 c = contribution(light);
+        return (c.x + c.y + c.z) / 3.0f;
+    };
+
+    // cheap candidates first: lights picked by power, no shadow rays
+    Reservoir reservoir;
+    for (int i = 0; i < restir_candidates_; i++)
+    {
+        float light_pdf;
+        const auto &light = scene_.area_lights_[lights_.Sample(sampler.Get1D(), &light_pdf)];
+        auto light_sample = light.Sample(position, sampler);
+
+        LightCandidate candidate = {light_sample.first, light.GetNormal(), light_sample.second};
+        float target = target_pdf(candidate);
+        reservoir.Update(candidate, target * light.GetArea() / light_pdf, target,
+                         sampler.Get1D());
+    }
+
+    // then the history of this pixel and a few neighbours from the previous pass
+    uint32_t max_count = restir_history_ * restir_candidates_;
+    Reservoir &history = reservoirs_->Current(pixel.x, pixel.y);
+    if (history.Compatible(normal, intersection.dist_))
+        reservoir.Merge(history, target_pdf(history.sample_), sampler.Get1D(), max_count);
+
+    for (int i = 0; i < restir_neighbors_; i++)
+    {
+        glm::vec2 u = sampler.Get2D();
+        float radius = restir_radius_ * std::sqrt(u.x);
+        float phi = 2.0f * glm::pi<float>() * u.y;
+
+        const Reservoir *neighbor =
+            reservoirs_->Previous(int(pixel.x) + int(std::round(radius * std::cos(phi))),
+                                  int(pixel.y) + int(std::round(radius * std::sin(phi))));
+        if (neighbor && neighbor->Compatible(normal, intersection.dist_))
+            reservoir.Merge(*neighbor, target_pdf(neighbor->sample_), sampler.Get1D(),
+                            max_count);
+    }
+
+    reservoir.normal_ = normal;
+    reservoir.depth_ = intersection.dist_;
+
+    glm::vec3 ret = glm::vec3();
+    float weight = reservoir.ContributionWeight();
+    if (weight > 0.0f)
+    {
+        glm::vec3 to_light = reservoir.sample_.position_ - position;
+        float dist = glm::length(to_light);
+        auto shadowhit = raycaster_.Trace(position, to_light / dist);
+
+        if (!shadowhit || shadowhit->first.dist_ > dist * 0.999f)
+            ret = contribution(reservoir.sample_) * weight;
+        else
+            // occluded candidates are not handed on
+            reservoir.weight_sum_ = 0.0f;
+    }
+
+    history = reservoir;
+    return ret;
 }
 
 glm::vec3 PathTracer::Trace(glm::vec3 origin, glm::vec3 dir, bool include_emission,
-                            glm::vec3 beta, Sampler &sampler, int32_t depth) const
+                            Sampler &sampler, int32_t depth, glm::vec3 camera_pos,
+                            RayCone cone, PixelAOV *aov, const glm::uvec2 *pixel) const
 {
     if (depth == -1)
         return glm::vec3();
@@ -51,24 +204,46 @@ glm::vec3 PathTracer::Trace(glm::vec3 origin, glm::vec3 dir, bool include_emissi
         glm::vec3 ret(0.0f);
         auto intersection = intersection_raw->first;
         auto surface = intersection_raw->second;
-        auto &material = scene_.mesh_->GetMaterial(surface.object_id_);
-        const auto &vertices = scene_.mesh_->submeshes_[surface.object_id_].vertices_;
 
-        float source_cosine = glm::abs(glm::dot<3, float, glm::qualifier::highp>(
-            dir, glm::normalize(intersection.normal_)));
+        float source_cosine =
+            glm::abs(glm::dot(dir, glm::normalize(intersection.normal_)));
 
-        if (include_emission)
-            ret += material.Emission() * beta;
+        // the cone is stretched along the surface at grazing angles
+        cone = cone.Propagate(intersection.dist_);
+        float footprint = cone.width_ / std::max(source_cosine, 1e-3f);
+        SurfaceInteraction si = Interact(intersection, surface, footprint);
+        const MaterialRecord &material = *si.record_;
 
-        for (int i = 0; i < max_reflections_; i++)
+        if (aov)
+            RecordAOV(aov, dir, si, intersection.dist_);
+
+        glm::vec3 emission = include_emission ? material.emission_ : glm::vec3();
+
+        // deep vertices end with the cached estimate if there is one
+        int bounce = recursion_level_ - depth;
+        glm::vec3 cache_normal = si.normal_;
+        if (glm::dot(cache_normal, dir) > 0.0f)
+            cache_normal = -cache_normal;
+
+        if (radiance_cache_ && bounce >= radiance_cache_depth_)
+        {
+            if (auto cached = radiance_cache_->Lookup(intersection.global_pos_,
+                                                      cache_normal, camera_pos))
+                return emission + *cached;
+        }
+
+        if (pixel)
+            ret += ResampledDirectLight(*pixel, origin, intersection, si, sampler);
+
+        for (int i = 0; i < max_reflections_ && !pixel; i++)
         {
             for (const auto &light : scene_.area_lights_)
             {
                 auto incoming_light = light.Sample(intersection.global_pos_, sampler);
 
-                float light_cosine = glm::abs(glm::dot<3, float, glm::qualifier::highp>(
+                float light_cosine = glm::abs(glm::dot(
                     glm::normalize(incoming_light.first - intersection.global_pos_),
-                    glm::normalize(intersection.normal_)));
+                    si.normal_));
 
                 auto shadowhit = raycaster_.Trace(
                     intersection.global_pos_,
@@ -85,71 +260,121 @@ glm::vec3 PathTracer::Trace(glm::vec3 origin, glm::vec3 dir, bool include_emissi
                     float g = light_cosine * source_cosine /
                               (dist * dist * glm::pi<float>() * glm::pi<float>());
 
-                    ret += material.BRDF(incoming_light.first, intersection.global_pos_,
-                                         origin, intersection.normal_,
-                                         intersection.barycentric_pos_,
-                                         vertices[surface.t1_], vertices[surface.t2_],
-                                         vertices[surface.t3_]) *
-                           incoming_light.second * beta * g * light.GetArea() /
+                    ret += EvaluateBSDF(si, incoming_light.first, origin) *
+                           incoming_light.second * g * light.GetArea() /
                            float(max_reflections_);
                 }
             }
         }
 
         // SAMPLE SKY
-        glm::vec3 skybox_dir = sampler.SampleDirection(intersection.normal_);
-        if (!raycaster_.Trace(intersection.global_pos_, skybox_dir))
+        if (scene_.skybox_.HasMap())
         {
-            ret += beta * scene_.skybox_.Sample(skybox_dir) *
-                   material.BRDF(intersection.global_pos_ + skybox_dir,
-                                 intersection.global_pos_, origin, intersection.normal_,
-                                 intersection.barycentric_pos_, vertices[surface.t1_],
-                                 vertices[surface.t2_], vertices[surface.t3_]);
+            // the estimator below with the environment map's own distribution
+            float sky_pdf;
+            glm::vec3 skybox_dir = scene_.skybox_.SampleDirection(sampler.Get2D(), &sky_pdf);
+            if (sky_pdf > 0.0f && glm::dot(skybox_dir, intersection.normal_) > 0.0f &&
+                !raycaster_.Trace(intersection.global_pos_, skybox_dir))
+            {
+                ret += scene_.skybox_.Sample(skybox_dir) *
+                       EvaluateBSDF(si, intersection.global_pos_ + skybox_dir, origin) /
+                       (2.0f * glm::pi<float>() * sky_pdf);
+            }
+        }
+        else
+        {
+            glm::vec3 skybox_dir = sampler.SampleDirection(intersection.normal_);
+            if (!raycaster_.Trace(intersection.global_pos_, skybox_dir))
+            {
+                ret += scene_.skybox_.Sample(skybox_dir) *
+                       EvaluateBSDF(si, intersection.global_pos_ + skybox_dir, origin);
+            }
         }
 
         // SAMPLE MANY REFLECTIONS
+        GuidingField::Region *region =
+            guiding_ ? &guiding_->GetRegion(intersection.global_pos_) : nullptr;
+        bool guided = region && region->sampling_.Total() > 0.0f;
+
+        // the width at half maximum of the Phong lobe, cos^15, the narrower of the two
+        RayCone rough_cone = cone.Scatter(0.6f);
+
         for (int i = 0; i < max_reflections_; i++)
         {
-            auto reflection =
-                material.SampleF(intersection.global_pos_, intersection.normal_, dir,
-                                 intersection.barycentric_pos_, vertices[surface.t1_],
-                                 vertices[surface.t2_], vertices[surface.t3_], sampler);
+            BSDFSample reflection;
+            if (guided && sampler.Get1D() < guiding_fraction_)
+            {
+                glm::vec3 guided_dir = region->sampling_.Sample(sampler.Get2D());
+                reflection = {EvaluateBSDF(si, intersection.global_pos_ + dir,
+                                            intersection.global_pos_ + guided_dir),
+                              0.0f, guided_dir};
+            }
+            else
+            {
+                reflection = SampleBSDF(si, dir, sampler);
+            }
 
-            glm::vec3 new_beta = beta * reflection.radiance_ / reflection.pdf_;
+            if (guided)
+            {
+                // one-sample MIS, balance heuristic
+                float material_pdf = BSDFPdf(si, dir, reflection.dir_);
+                if (material_pdf == 0.0f)
+                    continue;
+
+                reflection.pdf_ =
+                    guiding_fraction_ * region->sampling_.Pdf(reflection.dir_) +
+                    (1.0f - guiding_fraction_) * material_pdf;
+            }
+
+            glm::vec3 weight = reflection.radiance_ / reflection.pdf_;
 
             float p = std::max(reflection.radiance_.x,
                                std::max(reflection.radiance_.y, reflection.radiance_.z)) *
                       roulette_factor_;
             p = std::min(1.0f, p);
-            if (sampler.Sample() > p)
+            if (sampler.Get1D() > p)
             {
                 // log_.Info() << "Terminating at " << depth;
                 continue;
             }
-            new_beta *= 1.0f / p;
+            weight *= 1.0f / p;
+
+            glm::vec3 incoming = Trace(intersection.global_pos_, reflection.dir_, false,
+                                       sampler, depth - 1, camera_pos, rough_cone);
+
+            if (region)
+            {
+                region->training_.Record(reflection.dir_,
+                                         (incoming.x + incoming.y + incoming.z) / 3.0f /
+                                             reflection.pdf_);
+                region->samples_.fetch_add(1, std::memory_order_relaxed);
+            }
 
-            ret += Trace(intersection.global_pos_, reflection.dir_, false, new_beta,
-                         sampler, depth - 1) /
-                   float(max_reflections_);
+            ret += weight * incoming / float(max_reflections_);
         }
 
-        if (material.HasSpecular())
+        if (material.has_specular_)
         {
-            auto reflection = material.SampleSpecular(
-                intersection.global_pos_, intersection.normal_, dir,
-                intersection.barycentric_pos_, vertices[surface.t1_],
-                vertices[surface.t2_], vertices[surface.t3_], sampler);
+            auto reflection = SampleSpecularBSDF(si, dir);
 
-            glm::vec3 new_beta = beta * reflection.radiance_ / reflection.pdf_;
-
-            ret += Trace(intersection.global_pos_, reflection.dir_, true, new_beta,
-                         sampler, depth - 1);
+            ret += reflection.radiance_ / reflection.pdf_ *
+                   Trace(intersection.global_pos_, reflection.dir_, true, sampler,
+                         depth - 1, camera_pos, cone);
         }
 
-        return ret;
+        // Only vertices up to the lookup depth are cached: deeper ones have less of
+        // the recursion left and would darken the estimate.
+        if (radiance_cache_ && bounce >= 1 && bounce <= radiance_cache_depth_)
+            radiance_cache_->Insert(intersection.global_pos_, cache_normal, camera_pos,
+                                    ret);
+
+        return emission + ret;
     }
     else
     {
-        return beta * scene_.skybox_.Sample(dir);
+        if (aov)
+            *aov = {scene_.skybox_.Sample(dir), glm::vec3(), 0.0f};
+
+        return scene_.skybox_.Sample(dir);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,339 @@
+
+#include <thread>
+
+#include "config.h"
+#include "exceptions.h"
+#include "photon_mapper.h"
+
+namespace
+{
+
+float MaxComponent(glm::vec3 v) { return std::max(v.x, std::max(v.y, v.z)); }
+
+// normalized geometric normal facing against dir
+glm::vec3 FacingNormal(const TriangleIntersection &intersection, glm::vec3 dir)
+{
+    glm::vec3 normal = glm::normalize(intersection.normal_);
+    return glm::dot(normal, dir) > 0.0f ? -normal : normal;
+}
+
+} // namespace
+
+glm::ivec3 PhotonGrid::Cell(glm::vec3 position) const
+{
+    return glm::ivec3(glm::floor(position / cell_size_));
+}
+
+uint32_t PhotonGrid::Hash(glm::ivec3 cell) const
+{
+    return (uint32_t(cell.x) * 73856093u ^ uint32_t(cell.y) * 19349663u ^
+            uint32_t(cell.z) * 83492791u) &
+           mask_;
+}
+
+size_t PhotonGrid::Size() const { return photons_.size(); }
+
+void PhotonGrid::Build(std::vector<Photon> &&photons, float radius)
+{
+    // a lookup sphere never touches more than two cells along an axis
+    cell_size_ = 2.0f * radius;
+
+    uint32_t buckets = 1;
+    while (buckets < 2 * photons.size())
+        buckets *= 2;
+    mask_ = buckets - 1;
+
+    // counting sort by bucket
+    std::vector<uint32_t> hashes(photons.size());
+    cell_start_.assign(buckets + 1, 0);
+
+    for (unsigned int i = 0; i < photons.size(); i++)
+    {
+        hashes[i] = Hash(Cell(photons[i].position_));
+        cell_start_[hashes[i] + 1]++;
+    }
+
+    for (uint32_t b = 0; b < buckets; b++)
+        cell_start_[b + 1] += cell_start_[b];
+
+    std::vector<uint32_t> fill(cell_start_.begin(), cell_start_.end() - 1);
+    photons_.resize(photons.size());
+    for (unsigned int i = 0; i < photons.size(); i++)
+        photons_[fill[hashes[i]]++] = photons[i];
+}
+
+PhotonMapper::PhotonMapper(const Scene &scene, const RayCaster &raycaster)
+    : Integrator(scene, raycaster),
+      recursion_level_(Config::inst().GetOption<int>("recursion")),
+      photons_per_pass_(Config::inst().GetOption<int>("photons_per_pass")),
+      initial_radius_(
+          Config::inst().GetOption<float>("photon_radius") *
+          glm::length(scene.mesh_->GetUpperBound() - scene.mesh_->GetLowerBound())),
+      alpha_(Config::inst().GetOption<float>("photon_alpha")),
+      final_gather_rays_(Config::inst().GetOption<int>("photon_final_gather")),
+      max_photon_bounces_(Config::inst().GetOption<int>("photon_max_bounces")),
+      threads_(Config::inst().GetOption<int>("threads")),
+      seed_(Config::inst().GetOption<int>("seed")), lights_(scene.area_lights_),
+      radius_(initial_radius_)
+{
+    if (lights_.Empty())
+        log_.Warning() << "No area lights, the photon maps will be empty.";
+}
+
+std::vector<Photon> PhotonMapper::ShootPhotons(uint32_t first, uint32_t last,
+                                               uint32_t pass) const
+{
+    std::vector<Photon> photons;
+    RandomSampler sampler(seed_);
+
+    for (uint32_t i = first; i < last; i++)
+    {
+        sampler.StartLightSample(i, pass);
+
+        // pick a light proportionally to its power
+        float light_pdf;
+        const auto &light = scene_.area_lights_[lights_.Sample(sampler.Get1D(), &light_pdf)];
+
+        // lights are two-sided, the side is picked at random
+        glm::vec3 position = light.Sample(glm::vec3(), sampler).first;
+        glm::vec3 normal = sampler.Get1D() < 0.5f ? light.GetNormal() : -light.GetNormal();
+        glm::vec3 dir = sampler.SampleCosineDirection(normal);
+
+        glm::vec3 power = light.GetEmission() * light.GetArea() * 2.0f *
+                          glm::pi<float>() / (light_pdf * float(photons_per_pass_));
+        bool specular_only = true;
+
+        for (int bounce = 0; bounce < max_photon_bounces_; bounce++)
+        {
+            auto intersection_raw = raycaster_.Trace(position, dir);
+            if (!intersection_raw)
+                break;
+
+            auto intersection = intersection_raw->first;
+            auto surface = intersection_raw->second;
+            SurfaceInteraction si = Interact(intersection, surface);
+            const MaterialRecord &material = *si.record_;
+            glm::vec3 surface_normal = FacingNormal(intersection, dir);
+
+            uint32_t type = bounce == 0 ? Photon::Direct
+                                        : (specular_only ? Photon::Caustic : Photon::Indirect);
+            photons.push_back({intersection.global_pos_, power, dir, type});
+
+            // specular surfaces reflect diffusely too, one of the lobes is followed
+            float diffuse_weight = 1.0f;
+            if (material.has_specular_)
+            {
+                diffuse_weight = 2.0f;
+                if (sampler.Get1D() < 0.5f)
+                {
+                    auto reflection = SampleSpecularBSDF(si, dir);
+
+                    power *= 2.0f * reflection.radiance_ / reflection.pdf_;
+                    position = intersection.global_pos_;
+                    dir = reflection.dir_;
+                    continue;
+                }
+            }
+
+            glm::vec3 new_dir = sampler.SampleCosineDirection(surface_normal);
+            // f * cos / pdf, with the cosine pdf the cosine cancels out
+            glm::vec3 throughput = EvaluateBSDF(si, intersection.global_pos_ - dir,
+                                                 intersection.global_pos_ + new_dir) *
+                                   diffuse_weight;
+
+            float survival = std::min(1.0f, MaxComponent(throughput));
+            if (sampler.Get1D() >= survival)
+                break;
+
+            power *= throughput / survival;
+            position = intersection.global_pos_;
+            dir = new_dir;
+            specular_only = false;
+        }
+    }
+
+    return photons;
+}
+
+void PhotonMapper::StartPass(uint32_t pass)
+{
+    // r_{i+1}^2 = r_i^2 * (i + alpha) / (i + 1)
+    float radius_sq = initial_radius_ * initial_radius_;
+    for (uint32_t i = 1; i <= pass; i++)
+        radius_sq *= (float(i) + alpha_) / float(i + 1);
+    radius_ = std::sqrt(radius_sq);
+
+    if (lights_.Empty())
+    {
+        grid_.Build({}, radius_);
+        return;
+    }
+
+    std::vector<std::vector<Photon>> results(threads_);
+    std::vector<std::thread> threads;
+    uint32_t per_thread = (photons_per_pass_ + threads_ - 1) / threads_;
+
+    for (int t = 0; t < threads_; t++)
+    {
+        threads.emplace_back([&, t]() {
+            results[t] = ShootPhotons(std::min(photons_per_pass_, t * per_thread),
+                                      std::min(photons_per_pass_, (t + 1) * per_thread),
+                                      pass);
+        });
+    }
+
+    std::vector<Photon> photons;
+    for (int t = 0; t < threads_; t++)
+    {
+        threads[t].join();
+        photons.insert(photons.end(), results[t].begin(), results[t].end());
+    }
+
+    grid_.Build(std::move(photons), radius_);
+    log_.Info() << "Pass " << pass << ": stored " << grid_.Size()
+                << " photons, radius " << radius_;
+}
+
+glm::vec3 PhotonMapper::Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                              PixelAOV *aov, const glm::uvec2 *) const
+{
+    return Trace(origin, dir, sampler, recursion_level_, aov);
+}
+
+glm::vec3 PhotonMapper::Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                              int32_t depth, PixelAOV *aov) const
+{
+    if (depth == -1)
+        return glm::vec3();
+
+    auto intersection_raw = raycaster_.Trace(origin, dir);
+    if (!intersection_raw)
+    {
+        if (aov)
+            *aov = {scene_.skybox_.Sample(dir), glm::vec3(), 0.0f};
+
+        return scene_.skybox_.Sample(dir);
+    }
+
+    auto intersection = intersection_raw->first;
+    auto surface = intersection_raw->second;
+    SurfaceInteraction si = Interact(intersection, surface);
+    const MaterialRecord &material = *si.record_;
+    glm::vec3 normal = FacingNormal(intersection, dir);
+
+    if (aov)
+        RecordAOV(aov, dir, si, intersection.dist_);
+
+    // camera paths only continue through specular bounces, emission is never sampled
+    // explicitly for them
+    glm::vec3 ret = material.emission_;
+    ret += DirectLight(origin, normal, si, sampler);
+
+    if (final_gather_rays_ > 0)
+    {
+        // caustics are too sharp for final gathering
+        ret += EstimateRadiance(origin, normal, si, Photon::Caustic);
+
+        glm::vec3 gathered = glm::vec3();
+        for (int i = 0; i < final_gather_rays_; i++)
+        {
+            glm::vec3 gather_dir = sampler.SampleCosineDirection(normal);
+            auto gather_hit = raycaster_.Trace(intersection.global_pos_, gather_dir);
+            if (!gather_hit)
+                continue;
+
+            glm::vec3 brdf = EvaluateBSDF(si, intersection.global_pos_ + gather_dir, origin);
+
+            // f * L * cos / pdf with f = brdf / pi and pdf = cos / pi
+            gathered += brdf * EstimateRadiance(intersection.global_pos_,
+                                                FacingNormal(gather_hit->first, gather_dir),
+                                                Interact(gather_hit->first, gather_hit->second),
+                                                Photon::Direct | Photon::Caustic |
+                                                    Photon::Indirect);
+        }
+        ret += gathered / float(final_gather_rays_);
+    }
+    else
+    {
+        ret += EstimateRadiance(origin, normal, si, Photon::Caustic | Photon::Indirect);
+    }
+
+    if (material.has_specular_)
+    {
+        auto reflection = SampleSpecularBSDF(si, dir);
+
+        ret += reflection.radiance_ / reflection.pdf_ *
+               Trace(intersection.global_pos_, reflection.dir_, sampler, depth - 1,
+                     nullptr);
+    }
+
+    return ret;
+}
+
+glm::vec3 PhotonMapper::DirectLight(glm::vec3 viewer, glm::vec3 normal,
+                                    const SurfaceInteraction &si, Sampler &sampler) const
+{
+    const glm::vec3 p = si.position_;
+    glm::vec3 ret = glm::vec3();
+
+    for (const auto &light : scene_.area_lights_)
+    {
+        auto light_sample = light.Sample(p, sampler);
+        glm::vec3 to_light = light_sample.first - p;
+        float dist = glm::length(to_light);
+        to_light /= dist;
+
+        float surface_cosine = glm::dot(normal, to_light);
+        if (surface_cosine <= 0.0f)
+            continue;
+
+        auto shadowhit = raycaster_.Trace(p, to_light);
+        if (shadowhit &&
+            shadowhit->first.dist_ < dist - (32.0f * std::numeric_limits<float>::epsilon()))
+            continue;
+
+        float light_cosine = std::abs(glm::dot(light.GetNormal(), to_light));
+        glm::vec3 brdf = EvaluateBSDF(si, light_sample.first, viewer) / glm::pi<float>();
+
+        ret += brdf * light_sample.second * surface_cosine * light_cosine *
+               light.GetArea() / (dist * dist);
+    }
+
+    // one sky sample, uniform over the hemisphere unless there is a map to follow
+    glm::vec3 sky_dir;
+    float sky_pdf = 1.0f / (2.0f * glm::pi<float>());
+    if (scene_.skybox_.HasMap())
+        sky_dir = scene_.skybox_.SampleDirection(sampler.Get2D(), &sky_pdf);
+    else
+        sky_dir = sampler.SampleDirection(normal);
+
+    if (sky_pdf > 0.0f && glm::dot(normal, sky_dir) > 0.0f && !raycaster_.Trace(p, sky_dir))
+    {
+        glm::vec3 brdf = EvaluateBSDF(si, p + sky_dir, viewer) / glm::pi<float>();
+        ret += brdf * scene_.skybox_.Sample(sky_dir) * glm::dot(normal, sky_dir) / sky_pdf;
+    }
+
+    return ret;
+}
+
+glm::vec3 PhotonMapper::EstimateRadiance(glm::vec3 viewer, glm::vec3 normal,
+                                         const SurfaceInteraction &si, uint32_t types) const
+{
+    const glm::vec3 p = si.position_;
+    glm::vec3 flux = glm::vec3();
+
+    // all photons are shaded by the same reflection model, picked once
+    DispatchBSDF(si.kind_, [&](auto kind) {
+        grid_.ForEachPhoton(p, radius_, [&](const Photon &photon) {
+            // photons arriving from the other side of the surface don't count
+            if (!(photon.type_ & types) || glm::dot(photon.dir_, normal) >= 0.0f)
+                return;
+
+            flux += EvaluateBSDF<decltype(kind)::value>(si, p - photon.dir_, viewer) *
+                    photon.power_;
+        });
+    });
+
+    // f = brdf / pi, divided by the disc area
+    return flux / (glm::pi<float>() * glm::pi<float>() * radius_ * radius_);
+}
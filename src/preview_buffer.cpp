@@ -0,0 +1,25 @@
+
+#include "preview_buffer.h"
+
+PreviewBuffer::PreviewBuffer(uint32_t rx, uint32_t ry)
+    : rx_(rx), ry_(ry), pixels_(size_t(rx) * ry, 0)
+{
+}
+
+void PreviewBuffer::SetPixel(uint32_t x, uint32_t y, glm::vec3 radiance, float iso)
+{
+    auto readout = glm::clamp(radiance * iso, 0.0f, 1.0f);
+    uint32_t r = float(0xff) * readout.x;
+    uint32_t g = float(0xff) * readout.y;
+    uint32_t b = float(0xff) * readout.z;
+    uint32_t a = 0xff;
+
+    pixels_[y * rx_ + x] = b | g << 8 | r << 16 | a << 24;
+}
+
+void PreviewBuffer::Update(const Film &film, float iso)
+{
+    for (uint32_t y = 0; y < ry_; y++)
+        for (uint32_t x = 0; x < rx_; x++)
+            SetPixel(x, y, film.GetPixel(x, y), iso);
+}
@@ -0,0 +1,111 @@
+
+#include <cmath>
+
+#include "lwmath.h"
+#include "radiance_cache.h"
+
+const int MAX_PROBES = 8;
+const double FIXED_POINT_SCALE = 65536.0;
+
+RadianceCache::RadianceCache(uint32_t size_log2, float min_cell_size, float cell_angle,
+                             uint32_t min_samples)
+    : mask_((1u << size_log2) - 1), min_cell_size_(min_cell_size),
+      cell_angle_(cell_angle), min_samples_(std::max(1u, min_samples)),
+      entries_(new Entry[1u << size_log2])
+{
+    Clear();
+}
+
+void RadianceCache::Clear()
+{
+    for (uint32_t i = 0; i <= mask_; i++)
+    {
+        entries_[i].key_.store(0, std::memory_order_relaxed);
+        for (int c = 0; c < 3; c++)
+            entries_[i].sum_[c].store(0, std::memory_order_relaxed);
+        entries_[i].count_.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t RadianceCache::Key(glm::vec3 position, glm::vec3 normal,
+                            glm::vec3 camera_pos) const
+{
+    // power of two cell sizes, so neighbouring levels nest
+    float wanted_size = glm::length(position - camera_pos) * cell_angle_;
+    int level = std::max(0, int(std::floor(std::log2(wanted_size / min_cell_size_))));
+    float cell_size = std::ldexp(min_cell_size_, level);
+
+    glm::ivec3 cell = glm::ivec3(glm::floor(position / cell_size));
+
+    // dominant axis and its sign
+    glm::vec3 abs_normal = glm::abs(normal);
+    int axis = abs_normal.x > abs_normal.y ? (abs_normal.x > abs_normal.z ? 0 : 2)
+                                           : (abs_normal.y > abs_normal.z ? 1 : 2);
+    int direction = axis * 2 + (normal[axis] < 0.0f ? 1 : 0);
+
+    uint64_t key = lwmath::mix64(uint64_t(uint32_t(cell.x)) ^ (uint64_t(level) << 32));
+    key = lwmath::mix64(key ^ uint64_t(uint32_t(cell.y)) ^ (uint64_t(direction) << 32));
+    key = lwmath::mix64(key ^ uint64_t(uint32_t(cell.z)));
+
+    return key == 0 ? 1 : key;
+}
+
+void RadianceCache::Insert(glm::vec3 position, glm::vec3 normal, glm::vec3 camera_pos,
+                           glm::vec3 radiance)
+{
+    if (!(radiance.x >= 0.0f && radiance.y >= 0.0f && radiance.z >= 0.0f))
+        return;
+
+    uint64_t key = Key(position, normal, camera_pos);
+
+    for (int probe = 0; probe < MAX_PROBES; probe++)
+    {
+        Entry &entry = entries_[(key + probe) & mask_];
+
+        uint64_t current = entry.key_.load(std::memory_order_relaxed);
+        if (current == 0 &&
+            entry.key_.compare_exchange_strong(current, key, std::memory_order_relaxed))
+            current = key;
+
+        if (current != key)
+            continue;
+
+        for (int c = 0; c < 3; c++)
+            entry.sum_[c].fetch_add(uint64_t(double(radiance[c]) * FIXED_POINT_SCALE),
+                                    std::memory_order_relaxed);
+        entry.count_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // the neighbourhood is full, the sample is dropped
+}
+
+boost::optional<glm::vec3> RadianceCache::Lookup(glm::vec3 position, glm::vec3 normal,
+                                                 glm::vec3 camera_pos) const
+{
+    uint64_t key = Key(position, normal, camera_pos);
+
+    for (int probe = 0; probe < MAX_PROBES; probe++)
+    {
+        const Entry &entry = entries_[(key + probe) & mask_];
+        uint64_t current = entry.key_.load(std::memory_order_relaxed);
+
+        if (current == 0)
+            return boost::none;
+        if (current != key)
+            continue;
+
+        // the sums may be a sample ahead of the count, that is fine for an estimate
+        uint32_t count = entry.count_.load(std::memory_order_relaxed);
+        if (count < min_samples_)
+            return boost::none;
+
+        glm::vec3 ret;
+        for (int c = 0; c < 3; c++)
+            ret[c] = float(double(entry.sum_[c].load(std::memory_order_relaxed)) /
+                           FIXED_POINT_SCALE / double(count));
+        return ret;
+    }
+
+    return boost::none;
+}
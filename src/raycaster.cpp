@@ -111,8 +111,8 @@ RayCaster::RayCaster(std::shared_ptr<Mesh> mesh)
 {
     std::vector<TriangleIndices> indices_vector;
 
-    uint16_t submesh_id = 0;
-    for (auto submesh : mesh_->submeshes_)
+    uint32_t submesh_id = 0;
+    for (const auto &submesh : mesh_->submeshes_)
     {
         STRONG_ASSERT(submesh.indices_.size() % 3 == 0);
         log_.Info() << "Loading submesh with " << submesh.indices_.size() / 3
@@ -144,14 +144,19 @@ RayCaster::RayCaster(std::shared_ptr<Mesh> mesh)
                 << ", average depth: " << float(total_depth_) / float(leafs_);
 }
 
-float TriangleArea(const Vertex &v1, const Vertex &v2, const Vertex &v3)
+float TriangleArea(glm::vec3 v1, glm::vec3 v2, glm::vec3 v3)
 {
-    glm::vec3 ab = v2.pos_ - v1.pos_;
-    glm::vec3 ac = v3.pos_ - v1.pos_;
+    glm::vec3 ab = v2 - v1;
+    glm::vec3 ac = v3 - v1;
 
     return glm::length(glm::cross(ab, ac)) / 2.0f;
 }
 
+float TriangleArea(const Vertex &v1, const Vertex &v2, const Vertex &v3)
+{
+    return TriangleArea(v1.pos_, v2.pos_, v3.pos_);
+}
+
 std::vector<TriangleIndices>::iterator
 RayCaster::SurfaceAreaHeuristic(std::vector<TriangleIndices>::iterator left,
                                 std::vector<TriangleIndices>::iterator right,
@@ -182,7 +187,7 @@ RayCaster::SurfaceAreaHeuristic(std::vector<TriangleIndices>::iterator left,
             if (iter == right)
                 break;
 
-            const std::vector<Vertex> &mv = mesh_->submeshes_[iter->object_id_].vertices_;
+            const auto mv = mesh_->submeshes_[iter->object_id_].Positions();
 
             float current_area =
                 TriangleArea(mv[iter->t1_], mv[iter->t2_], mv[iter->t3_]);
@@ -268,11 +273,11 @@ void RayCaster::KDTreeConstructStep(unsigned int position,
             // sah disabled, just use mean
             pivot = table_start + ((table_end - table_start) / 2);
 
-        const std::vector<Vertex> &mv = mesh_->submeshes_[pivot->object_id_].vertices_;
+        const auto mv = mesh_->submeshes_[pivot->object_id_].Positions();
 
-        split = std::max(std::max(mv[pivot->t1_].pos_[split_dimension],
-                                  mv[pivot->t2_].pos_[split_dimension]),
-                         mv[pivot->t3_].pos_[split_dimension]);
+        split = std::max(
+            std::max(mv[pivot->t1_][split_dimension], mv[pivot->t2_][split_dimension]),
+            mv[pivot->t3_][split_dimension]);
 
         std::vector<TriangleIndices> carry_left, carry_right;
 
@@ -376,13 +381,13 @@ RayCaster::CheckKdLeaf(const glm::vec3 &lower_bound, const glm::vec3 &upper_boun
 
     for (int i = indices_start_index; i < indices_start_index + leaf.indices_no_; i += 1)
     {
-        const auto &mv = mesh_->submeshes_[indices_[i].object_id_].vertices_;
-        const auto &vertex1 = mv[indices_[i].t1_];
-        const auto &vertex2 = mv[indices_[i].t2_];
-        const auto &vertex3 = mv[indices_[i].t3_];
+        const auto mv = mesh_->submeshes_[indices_[i].object_id_].Positions();
+        const glm::vec3 vertex1 = mv[indices_[i].t1_];
+        const glm::vec3 vertex2 = mv[indices_[i].t2_];
+        const glm::vec3 vertex3 = mv[indices_[i].t3_];
 
-        if (auto intersection = RayIntersectsTriangle(origin, direction, vertex1.pos_,
-                                                      vertex2.pos_, vertex3.pos_))
+        if (auto intersection =
+                RayIntersectsTriangle(origin, direction, vertex1, vertex2, vertex3))
         {
             if (intersection->dist_ < intersection_dist_so_far &&
                 PointInAABB(intersection->global_pos_, lower_bound - EPSILON3,
@@ -400,39 +405,34 @@ RayCaster::CheckKdLeaf(const glm::vec3 &lower_bound, const glm::vec3 &upper_boun
 
 float RayCaster::TriangleMax(int dim, const TriangleIndices &i1)
 {
-    const auto &mv = mesh_->submeshes_[i1.object_id_].vertices_;
+    const auto mv = mesh_->submeshes_[i1.object_id_].Positions();
 
-    return std::max(std::max(mv[i1.t1_].pos_[dim], mv[i1.t2_].pos_[dim]),
-                    mv[i1.t3_].pos_[dim]);
+    return std::max(std::max(mv[i1.t1_][dim], mv[i1.t2_][dim]), mv[i1.t3_][dim]);
 }
 
 bool RayCaster::CompareIndices(int dim, bool min, const TriangleIndices &i1,
                                const TriangleIndices &i2) const
 {
-    const auto &mv1 = mesh_->submeshes_[i1.object_id_].vertices_;
-    const auto &mv2 = mesh_->submeshes_[i2.object_id_].vertices_;
+    const auto mv1 = mesh_->submeshes_[i1.object_id_].Positions();
+    const auto mv2 = mesh_->submeshes_[i2.object_id_].Positions();
 
     if (min)
-        return std::min(std::min(mv1[i1.t1_].pos_[dim], mv1[i1.t2_].pos_[dim]),
-                        mv1[i1.t3_].pos_[dim]) <
-               std::min(std::min(mv2[i2.t1_].pos_[dim], mv2[i2.t2_].pos_[dim]),
-                        mv2[i2.t3_].pos_[dim]);
+        return std::min(std::min(mv1[i1.t1_][dim], mv1[i1.t2_][dim]), mv1[i1.t3_][dim]) <
+               std::min(std::min(mv2[i2.t1_][dim], mv2[i2.t2_][dim]), mv2[i2.t3_][dim]);
     else
-        return std::max(std::max(mv1[i1.t1_].pos_[dim], mv1[i1.t2_].pos_[dim]),
-                        mv1[i1.t3_].pos_[dim]) <
-               std::max(std::max(mv2[i2.t1_].pos_[dim], mv2[i2.t2_].pos_[dim]),
-                        mv2[i2.t3_].pos_[dim]);
+        return std::max(std::max(mv1[i1.t1_][dim], mv1[i1.t2_][dim]), mv1[i1.t3_][dim]) <
+               std::max(std::max(mv2[i2.t1_][dim], mv2[i2.t2_][dim]), mv2[i2.t3_][dim]);
 }
 
 bool RayCaster::CompareIndicesToAAPlane(int dim, bool min, const TriangleIndices &i1,
                                         float plane) const
 {
-    const auto &mv1 = mesh_->submeshes_[i1.object_id_].vertices_;
+    const auto mv1 = mesh_->submeshes_[i1.object_id_].Positions();
 
     if (min)
-        return std::min(std::min(mv1[i1.t1_].pos_[dim], mv1[i1.t2_].pos_[dim]),
-                        mv1[i1.t3_].pos_[dim]) < plane;
+        return std::min(std::min(mv1[i1.t1_][dim], mv1[i1.t2_][dim]), mv1[i1.t3_][dim]) <
+               plane;
     else
-        return std::max(std::max(mv1[i1.t1_].pos_[dim], mv1[i1.t2_].pos_[dim]),
-                        mv1[i1.t3_].pos_[dim]) < plane;
+        return std::max(std::max(mv1[i1.t1_][dim], mv1[i1.t2_][dim]), mv1[i1.t3_][dim]) <
+               plane;
 }
\ No newline at end of file
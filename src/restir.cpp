@@ -0,0 +1,75 @@
+
+#include <algorithm>
+#include <cmath>
+
+#include "restir.h"
+
+bool Reservoir::Update(const LightCandidate &candidate, float weight, float target_pdf,
+                       float u)
+{
+    count_++;
+    if (!(weight > 0.0f))
+        return false;
+
+    weight_sum_ += weight;
+    if (u * weight_sum_ >= weight)
+        return false;
+
+    sample_ = candidate;
+    target_pdf_ = target_pdf;
+    return true;
+}
+
+bool Reservoir::Merge(const Reservoir &other, float target_pdf, float u, uint32_t max_count)
+{
+    uint32_t count = std::min(other.count_, max_count);
+    if (count == 0)
+        return false;
+
+    bool kept =
+        Update(other.sample_, target_pdf * other.ContributionWeight() * float(count),
+               target_pdf, u);
+    count_ += count - 1;
+    return kept;
+}
+
+float Reservoir::ContributionWeight() const
+{
+    if (count_ == 0 || target_pdf_ <= 0.0f)
+        return 0.0f;
+
+    return weight_sum_ / (float(count_) * target_pdf_);
+}
+
+bool Reservoir::Compatible(glm::vec3 normal, float depth) const
+{
+    return count_ > 0 && glm::dot(normal, normal_) > 0.9f &&
+           std::abs(depth - depth_) < 0.1f * depth;
+}
+
+ReservoirGrid::ReservoirGrid() : width_(0), height_(0) {}
+
+void ReservoirGrid::Resize(uint32_t width, uint32_t height)
+{
+    width_ = width;
+    height_ = height;
+    current_.assign(width * height, Reservoir());
+    previous_.assign(width * height, Reservoir());
+}
+
+void ReservoirGrid::Clear() { Resize(width_, height_); }
+
+void ReservoirGrid::StartPass() { previous_ = current_; }
+
+uint32_t ReservoirGrid::GetWidth() const { return width_; }
+uint32_t ReservoirGrid::GetHeight() const { return height_; }
+
+Reservoir &ReservoirGrid::Current(uint32_t x, uint32_t y) { return current_[y * width_ + x]; }
+
+const Reservoir *ReservoirGrid::Previous(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= int(width_) || y >= int(height_))
+        return nullptr;
+
+    return &previous_[y * width_ + x];
+}
@@ -0,0 +1,55 @@
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "lwmath.h"
+#include "rgb2spec.h"
+#include "spectrum.h"
+
+SigmoidPolynomial RGBToSigmoidPolynomial(glm::vec3 rgb)
+{
+    const int res = RGB2SPEC_RESOLUTION;
+    rgb = glm::clamp(rgb, glm::vec3(0.0f), glm::vec3(1.0f));
+
+    // grey is a constant, black and white lie at infinity
+    if (rgb.x == rgb.y && rgb.y == rgb.z)
+    {
+        float v = rgb.x;
+        float c2 = v == 0.0f   ? -std::numeric_limits<float>::infinity()
+                   : v == 1.0f ? std::numeric_limits<float>::infinity()
+                               : (v - 0.5f) / std::sqrt(v * (1.0f - v));
+        return {0.0f, 0.0f, c2};
+    }
+
+    int brightest = rgb.x > rgb.y ? (rgb.x > rgb.z ? 0 : 2) : (rgb.y > rgb.z ? 1 : 2);
+    float z = rgb[brightest];
+    float x = rgb[(brightest + 1) % 3] * float(res - 1) / z;
+    float y = rgb[(brightest + 2) % 3] * float(res - 1) / z;
+
+    int xi = std::min(int(x), res - 2), yi = std::min(int(y), res - 2);
+    const float *scale_end = RGB2SPEC_SCALE + res;
+    int zi = int(std::upper_bound(RGB2SPEC_SCALE, scale_end, z) - RGB2SPEC_SCALE) - 1;
+    zi = std::max(0, std::min(zi, res - 2));
+
+    float dx = x - float(xi), dy = y - float(yi);
+    float dz = (z - RGB2SPEC_SCALE[zi]) / (RGB2SPEC_SCALE[zi + 1] - RGB2SPEC_SCALE[zi]);
+
+    auto cell = [&](int i, int j, int k) {
+        int index = ((brightest * res + zi + k) * res + yi + j) * res + xi + i;
+        return RGB2SPEC_DATA + index * 3;
+    };
+
+    // trilinear, along x, then y, then z
+    float c[3];
+    for (int n = 0; n < 3; n++)
+    {
+        auto row = [&](int j, int k) {
+            return lwmath::lerp(dx, cell(0, j, k)[n], cell(1, j, k)[n]);
+        };
+        c[n] = lwmath::lerp(dz, lwmath::lerp(dy, row(0, 0), row(1, 0)),
+                            lwmath::lerp(dy, row(0, 1), row(1, 1)));
+    }
+
+    return {c[0], c[1], c[2]};
+}
@@ -0,0 +1,204 @@
+
+// Build-time generator of the RGB to spectrum coefficient table (Jakob & Hanika 2019,
+// "A Low-Dimensional Function Space for Efficient Spectral Upsampling").
+//
+// For every colour on a grid over (brightest component, the other two relative to it),
+// Gauss-Newton finds the sigmoid polynomial spectrum that renders to that colour
+// through CIEMatching and XYZToRGB, exactly as SpectrumToRGB sees it. Neighbouring
+// cells start from each other's solution, walking away from a mid brightness.
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "spectrum.h"
+
+namespace
+{
+
+const int RES = RGB2SPEC_RESOLUTION;
+const int RANGE = SPECTRUM_LAMBDA_END - SPECTRUM_LAMBDA_START;
+
+using Coefficients = std::array<double, 3>;
+
+// colour matching functions at 1 nm steps
+std::vector<glm::vec3> cie_table;
+// XYZToRGB is linear, its columns are kept in double for the finite differences
+std::array<glm::vec3, 3> xyz_to_rgb;
+
+double Sigmoid(double x) { return 0.5 + x / (2.0 * std::sqrt(1.0 + x * x)); }
+
+std::array<double, 3> Residual(const Coefficients &c, const std::array<double, 3> &target)
+{
+    double x = 0.0, y = 0.0, z = 0.0;
+    for (int i = 0; i < RANGE; i++)
+    {
+        double t = (double(i) + 0.5) / double(RANGE);
+        double s = Sigmoid((c[0] * t + c[1]) * t + c[2]);
+        x += cie_table[i].x * s;
+        y += cie_table[i].y * s;
+        z += cie_table[i].z * s;
+    }
+
+    std::array<double, 3> residual;
+    for (int n = 0; n < 3; n++)
+        residual[n] = xyz_to_rgb[0][n] * x + xyz_to_rgb[1][n] * y + xyz_to_rgb[2][n] * z -
+                      target[n];
+    return residual;
+}
+
+// solves a x = b with partial pivoting, false if a is singular
+bool Solve(std::array<std::array<double, 3>, 3> a, std::array<double, 3> b,
+           std::array<double, 3> *x)
+{
+    for (int col = 0; col < 3; col++)
+    {
+        int pivot = col;
+        for (int row = col + 1; row < 3; row++)
+            if (std::abs(a[row][col]) > std::abs(a[pivot][col]))
+                pivot = row;
+        if (std::abs(a[pivot][col]) < 1e-15)
+            return false;
+
+        std::swap(a[col], a[pivot]);
+        std::swap(b[col], b[pivot]);
+
+        for (int row = col + 1; row < 3; row++)
+        {
+            double factor = a[row][col] / a[col][col];
+            for (int k = col; k < 3; k++)
+                a[row][k] -= factor * a[col][k];
+            b[row] -= factor * b[col];
+        }
+    }
+
+    for (int row = 2; row >= 0; row--)
+    {
+        double sum = b[row];
+        for (int k = row + 1; k < 3; k++)
+            sum -= a[row][k] * (*x)[k];
+        (*x)[row] = sum / a[row][row];
+    }
+    return true;
+}
+
+void GaussNewton(const std::array<double, 3> &target, Coefficients &c)
+{
+    const double eps = 1e-5;
+
+    for (int iteration = 0; iteration < 15; iteration++)
+    {
+        auto residual = Residual(c, target);
+        double norm = std::sqrt(residual[0] * residual[0] + residual[1] * residual[1] +
+                                residual[2] * residual[2]);
+        if (norm < 1e-6)
+            break;
+
+        std::array<std::array<double, 3>, 3> jacobian;
+        for (int j = 0; j < 3; j++)
+        {
+            Coefficients low = c, high = c;
+            low[j] -= eps;
+            high[j] += eps;
+            auto r_low = Residual(low, target), r_high = Residual(high, target);
+            for (int i = 0; i < 3; i++)
+                jacobian[i][j] = (r_high[i] - r_low[i]) / (2.0 * eps);
+        }
+
+        std::array<double, 3> step;
+        if (!Solve(jacobian, residual, &step))
+            break;
+
+        for (int j = 0; j < 3; j++)
+            c[j] -= step[j];
+
+        // keep the sigmoid away from numerically flat regions
+        double max = std::max(std::abs(c[0]), std::max(std::abs(c[1]), std::abs(c[2])));
+        if (max > 200.0)
+            for (int j = 0; j < 3; j++)
+                c[j] *= 200.0 / max;
+    }
+}
+
+double SmoothStep(double x) { return x * x * (3.0 - 2.0 * x); }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        std::fprintf(stderr, "usage: %s <output.cpp>\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < RANGE; i++)
+        cie_table.push_back(CIEMatching(float(SPECTRUM_LAMBDA_START + i) + 0.5f));
+    for (int n = 0; n < 3; n++)
+    {
+        glm::vec3 axis = glm::vec3();
+        axis[n] = 1.0f;
+        xyz_to_rgb[n] = XYZToRGB(axis);
+    }
+
+    // brightness steps are denser near black and white
+    std::vector<double> scale(RES);
+    for (int k = 0; k < RES; k++)
+        scale[k] = SmoothStep(SmoothStep(double(k) / double(RES - 1)));
+
+    std::vector<float> data(3 * RES * RES * RES * 3);
+    for (int l = 0; l < 3; l++)
+    {
+        for (int j = 0; j < RES; j++)
+        {
+            double y = double(j) / double(RES - 1);
+            for (int i = 0; i < RES; i++)
+            {
+                double x = double(i) / double(RES - 1);
+
+                auto solve = [&](int k, Coefficients &c) {
+                    std::array<double, 3> rgb;
+                    rgb[l] = scale[k];
+                    rgb[(l + 1) % 3] = x * scale[k];
+                    rgb[(l + 2) % 3] = y * scale[k];
+                    GaussNewton(rgb, c);
+
+                    int index = (((l * RES + k) * RES + j) * RES + i) * 3;
+                    for (int n = 0; n < 3; n++)
+                        data[index + n] = float(c[n]);
+                };
+
+                const int start = RES / 5;
+                Coefficients c = {{0.0, 0.0, 0.0}};
+                for (int k = start; k < RES; k++)
+                    solve(k, c);
+
+                c = {{0.0, 0.0, 0.0}};
+                for (int k = start; k >= 0; k--)
+                    solve(k, c);
+            }
+        }
+    }
+
+    FILE *out = std::fopen(argv[1], "w");
+    if (!out)
+    {
+        std::perror(argv[1]);
+        return 1;
+    }
+
+    std::fprintf(out, "// generated by rgb2spec_gen, do not edit\n\n#include \"rgb2spec.h\"\n\n");
+    std::fprintf(out, "const float RGB2SPEC_SCALE[RGB2SPEC_RESOLUTION] = {\n");
+    for (int k = 0; k < RES; k++)
+        std::fprintf(out, "    %.9g,\n", scale[k]);
+    std::fprintf(out, "};\n\nconst float RGB2SPEC_DATA[3 * RGB2SPEC_RESOLUTION * "
+                      "RGB2SPEC_RESOLUTION * RGB2SPEC_RESOLUTION * 3] = {\n");
+    for (size_t n = 0; n < data.size(); n++)
+        std::fprintf(out, "%s%.9g,%s", n % 6 == 0 ? "    " : " ", data[n],
+                     n % 6 == 5 ? "\n" : "");
+    std::fprintf(out, "};\n");
+
+    std::fclose(out);
+    return 0;
+}
@@ -1,19 +1,260 @@
 
+#include <map>
+#include <mutex>
+#include <random>
+
+#include "config.h"
+#include "exceptions.h"
+#include "lwmath.h"
 #include "sampler.h"
 
-Sampler::Sampler() : mt_(rd_()), dist_(0.0f, 1.0f) {}
+using lwmath::mix64;
+
+namespace
+{
+
+const float ONE_MINUS_EPSILON = 0.99999994f;
+const int PMJ02_TABLES = 64;
+
+uint64_t HashDimension(uint32_t x, uint32_t y, uint32_t dimension, uint32_t seed)
+{
+    return mix64(((uint64_t(x) << 32) | y) ^ mix64((uint64_t(dimension) << 32) | seed));
+}
+
+uint32_t ReverseBits(uint32_t v)
+{
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+// Nested uniform (Owen) scrambling, Laine-Karras style hash with constants by N. Vegdahl
+uint32_t OwenScramble(uint32_t v, uint32_t seed)
+{
+    v = ReverseBits(v);
+    v ^= v * 0x3d20adeau;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56u;
+    v ^= v * 0x53a22864u;
+    return ReverseBits(v);
+}
+
+// second Sobol dimension, the first one is just ReverseBits(index)
+uint32_t SobolSecondDimension(uint32_t index)
+{
+    uint32_t ret = 0;
+    for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+    {
+        if (index & 1)
+            ret ^= v;
+    }
+    return ret;
+}
+
+void PCG4D(uint32_t &x, uint32_t &y, uint32_t &z, uint32_t &w)
+{
+    x = x * 1664525u + 1013904223u;
+    y = y * 1664525u + 1013904223u;
+    z = z * 1664525u + 1013904223u;
+    w = w * 1664525u + 1013904223u;
+
+    x += y * w;
+    y += z * x;
+    z += x * y;
+    w += y * z;
 
-float Sampler::Sample() { return dist_(mt_); }
+    x ^= x >> 16;
+    y ^= y >> 16;
+    z ^= z >> 16;
+    w ^= w >> 16;
+
+    x += y * w;
+    y += z * x;
+    z += x * y;
+    w += y * z;
+}
 
-std::pair<float, float> Sampler::SamplePair()
+float FixedToFloat(uint32_t v)
 {
-    return std::make_pair(Sample(), Sample());
+    return std::min(float(v) * 2.3283064365386963e-10f, ONE_MINUS_EPSILON);
 }
 
+// See "Progressive Multi-Jittered Sample Sequences", Christensen et al. 2018
+class PMJ02Generator
+{
+    std::mt19937 mt_;
+    std::uniform_real_distribution<float> dist_;
+
+    std::vector<glm::vec2> samples_;
+    // one table per elementary interval shape of the current 2N points
+    std::vector<std::vector<bool>> occupied_;
+
+    void MarkOccupied(glm::vec2 p, int nn)
+    {
+        int shape = 0;
+        for (int xdivs = nn, ydivs = 1; xdivs > 0; xdivs /= 2, ydivs *= 2, shape++)
+            occupied_[shape][int(ydivs * p.y) * xdivs + int(xdivs * p.x)] = true;
+    }
+
+    bool IsOccupied(glm::vec2 p, int nn)
+    {
+        int shape = 0;
+        for (int xdivs = nn, ydivs = 1; xdivs > 0; xdivs /= 2, ydivs *= 2, shape++)
+        {
+            if (occupied_[shape][int(ydivs * p.y) * xdivs + int(xdivs * p.x)])
+                return true;
+        }
+        return false;
+    }
+
+    void MarkAllOccupied(int n)
+    {
+        int shapes = 1;
+        for (int nn = 2 * n; nn > 1; nn /= 2)
+            shapes++;
+
+        occupied_.assign(shapes, std::vector<bool>(2 * n, false));
+        for (int i = 0; i < n; i++)
+            MarkOccupied(samples_[i], 2 * n);
+    }
+
+    // A new point in subquadrant (x_half, y_half) of the cell (i, j) of an n x n grid,
+    // not sharing any elementary interval with the first `samples` points.
+    glm::vec2 GeneratePoint(int i, int j, int x_half, int y_half, int n, int samples)
+    {
+        int nn = 2 * samples;
+        int strata_per_half = nn / (2 * n);
+        int x_first = (2 * i + x_half) * strata_per_half;
+        int y_first = (2 * j + y_half) * strata_per_half;
+
+        // the finest x and y strata are checked up front, the rest by rejection
+        std::vector<int> free_x, free_y;
+        for (int k = 0; k < strata_per_half; k++)
+        {
+            if (!occupied_[0][x_first + k])
+                free_x.push_back(x_first + k);
+            if (!occupied_[occupied_.size() - 1][y_first + k])
+                free_y.push_back(y_first + k);
+        }
+
+        STRONG_ASSERT(!free_x.empty() && !free_y.empty());
+
+        while (true)
+        {
+            int x = free_x[std::min(int(dist_(mt_) * free_x.size()), int(free_x.size()) - 1)];
+            int y = free_y[std::min(int(dist_(mt_) * free_y.size()), int(free_y.size()) - 1)];
+            glm::vec2 p(std::min((x + dist_(mt_)) / nn, ONE_MINUS_EPSILON),
+                        std::min((y + dist_(mt_)) / nn, ONE_MINUS_EPSILON));
+
+            if (!IsOccupied(p, nn))
+            {
+                MarkOccupied(p, nn);
+                return p;
+            }
+        }
+    }
+
+    void GetCell(glm::vec2 p, int n, int &i, int &j, int &x_half, int &y_half)
+    {
+        i = int(n * p.x);
+        j = int(n * p.y);
+        x_half = int(2.0f * (n * p.x - i));
+        y_half = int(2.0f * (n * p.y - j));
+    }
+
+    // n = 4^k points -> 2n points
+    void ExtendEven(int n)
+    {
+        int grid = std::lround(std::sqrt(n));
+        int i, j, x_half, y_half;
+
+        MarkAllOccupied(n);
+        for (int s = 0; s < n; s++)
+        {
+            GetCell(samples_[s], grid, i, j, x_half, y_half);
+            samples_[n + s] = GeneratePoint(i, j, 1 - x_half, 1 - y_half, grid, n);
+        }
+    }
+
+    // n = 2 * 4^k points -> 2n points
+    void ExtendOdd(int n)
+    {
+        int grid = std::lround(std::sqrt(n / 2));
+        int i, j, x_half, y_half;
+        std::vector<int> x_halves(n / 2), y_halves(n / 2);
+
+        MarkAllOccupied(n);
+        for (int s = 0; s < n / 2; s++)
+        {
+            GetCell(samples_[s], grid, i, j, x_half, y_half);
+
+            if (dist_(mt_) > 0.5f)
+                x_half = 1 - x_half;
+            else
+                y_half = 1 - y_half;
+
+            x_halves[s] = x_half;
+            y_halves[s] = y_half;
+            samples_[n + s] = GeneratePoint(i, j, x_half, y_half, grid, n);
+        }
+
+        for (int s = 0; s < n / 2; s++)
+        {
+            GetCell(samples_[s], grid, i, j, x_half, y_half);
+            samples_[n + n / 2 + s] =
+                GeneratePoint(i, j, 1 - x_halves[s], 1 - y_halves[s], grid, n);
+        }
+    }
+
+  public:
+    PMJ02Generator(uint32_t seed) : mt_(seed), dist_(0.0f, 1.0f) {}
+
+    // size has to be a power of two
+    std::vector<glm::vec2> Generate(int size)
+    {
+        samples_.assign(size, glm::vec2());
+        samples_[0] = glm::vec2(dist_(mt_), dist_(mt_));
+
+        for (int n = 1; n < size; n *= 4)
+        {
+            ExtendEven(n);
+            if (2 * n < size)
+                ExtendOdd(2 * n);
+        }
+
+        return samples_;
+    }
+};
+
+const std::vector<std::vector<glm::vec2>> &PMJ02Tables(uint32_t size)
+{
+    static std::mutex mutex;
+    static std::map<uint32_t, std::vector<std::vector<glm::vec2>>> tables;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &ret = tables[size];
+
+    if (ret.empty())
+    {
+        Log("Sampler").Info() << "Generating " << PMJ02_TABLES << " PMJ02 tables of "
+                              << size << " points.";
+        for (int i = 0; i < PMJ02_TABLES; i++)
+            ret.push_back(PMJ02Generator(i).Generate(size));
+    }
+
+    return ret;
+}
+
+} // namespace
+
 glm::vec3 Sampler::SampleDirection()
 {
-    float theta = 2.0f * M_PI * Sample();
-    float phi = glm::acos(1.0f - 2.0f * Sample());
+    auto u = Get2D();
+    float theta = 2.0f * M_PI * u.x;
+    float phi = glm::acos(1.0f - 2.0f * u.y);
     return glm::vec3(glm::sin(phi) * glm::cos(theta), glm::sin(phi) * glm::sin(theta),
                      glm::cos(phi));
 }
@@ -29,4 +270,124 @@ glm::vec3 Sampler::SampleDirection(glm::vec3 normal)
     {
         return -dir;
     }
-}
\ No newline at end of file
+}
+
+glm::vec3 Sampler::SampleCosineDirection(glm::vec3 normal)
+{
+    auto u = Get2D();
+    glm::vec3 tangent = std::abs(normal.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f)
+                                                  : glm::vec3(1.0f, 0.0f, 0.0f);
+    tangent = glm::normalize(glm::cross(normal, tangent));
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+
+    float r = std::sqrt(u.x);
+    float phi = 2.0f * M_PI * u.y;
+
+    return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) +
+           normal * std::sqrt(std::max(0.0f, 1.0f - u.x));
+}
+
+RandomSampler::RandomSampler(uint32_t seed) : seed_hash_(mix64(seed)), stream_(0) {}
+
+void RandomSampler::StartPixelSample(uint32_t x, uint32_t y, uint32_t sample_index)
+{
+    STRONG_ASSERT(x < 65536 && y < 65536, "RandomSampler pixels are 16 bits per axis");
+    stream_ = uint32_t(seed_hash_);
+    pixel_ = y << 16 | x;
+    sample_index_ = sample_index;
+    dimension_ = 0;
+}
+
+void RandomSampler::StartLightSample(uint32_t path, uint32_t pass)
+{
+    stream_ = uint32_t(seed_hash_ >> 32);
+    pixel_ = pass;
+    sample_index_ = path;
+    dimension_ = 0;
+}
+
+float RandomSampler::Get1D()
+{
+    uint32_t x = pixel_, y = stream_, z = sample_index_, w = dimension_++;
+    PCG4D(x, y, z, w);
+    return FixedToFloat(x);
+}
+
+glm::vec2 RandomSampler::Get2D()
+{
+    uint32_t x = pixel_, y = stream_, z = sample_index_, w = dimension_;
+    dimension_ += 2;
+    PCG4D(x, y, z, w);
+    return glm::vec2(FixedToFloat(x), FixedToFloat(y));
+}
+
+SobolSampler::SobolSampler(uint32_t seed) : seed_(seed) {}
+
+void SobolSampler::StartPixelSample(uint32_t x, uint32_t y, uint32_t sample_index)
+{
+    x_ = x;
+    y_ = y;
+    sample_index_ = sample_index;
+    dimension_ = 0;
+}
+
+float SobolSampler::Get1D()
+{
+    uint64_t hash = HashDimension(x_, y_, dimension_++, seed_);
+    uint32_t index = OwenScramble(sample_index_, hash);
+
+    return FixedToFloat(OwenScramble(ReverseBits(index), hash >> 32));
+}
+
+glm::vec2 SobolSampler::Get2D()
+{
+    uint64_t hash = HashDimension(x_, y_, dimension_, seed_);
+    uint32_t index = OwenScramble(sample_index_, hash);
+    dimension_ += 2;
+
+    return glm::vec2(FixedToFloat(OwenScramble(ReverseBits(index), hash >> 32)),
+                     FixedToFloat(OwenScramble(SobolSecondDimension(index), mix64(hash))));
+}
+
+PMJ02Sampler::PMJ02Sampler(uint32_t seed, uint32_t samples_per_pixel)
+    : seed_(seed), tables_(PMJ02Tables(std::max(
+                       16u, 1u << uint32_t(std::ceil(std::log2(samples_per_pixel))))))
+{
+}
+
+void PMJ02Sampler::StartPixelSample(uint32_t x, uint32_t y, uint32_t sample_index)
+{
+    x_ = x;
+    y_ = y;
+    sample_index_ = sample_index;
+    dimension_ = 0;
+}
+
+float PMJ02Sampler::Get1D() { return Get2D().x; }
+
+glm::vec2 PMJ02Sampler::Get2D()
+{
+    uint64_t hash = HashDimension(x_, y_, dimension_++, seed_);
+    const auto &table = tables_[hash % tables_.size()];
+    glm::vec2 p = table[sample_index_ % table.size()];
+
+    // random digital shift, keeps the points in their elementary intervals
+    uint32_t shift_x = hash >> 32, shift_y = mix64(hash);
+    return glm::vec2(FixedToFloat(uint32_t(p.x * 4294967296.0) ^ shift_x),
+                     FixedToFloat(uint32_t(p.y * 4294967296.0) ^ shift_y));
+}
+
+std::unique_ptr<Sampler> MakeSampler(uint32_t seed)
+{
+    auto type = Config::inst().GetOption<std::string>("sampler");
+
+    if (type == "sobol")
+        return std::make_unique<SobolSampler>(seed);
+    if (type == "pmj02")
+        return std::make_unique<PMJ02Sampler>(
+            seed, Config::inst().GetOption<int>("samples_per_pixel"));
+    if (type == "random")
+        return std::make_unique<RandomSampler>(seed);
+
+    throw Exception("Unknown sampler: " + type);
+}
@@ -0,0 +1,326 @@
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <vector>
+
+#include "mapped_file.h"
+#include "scene_cache.h"
+
+namespace
+{
+
+// Scene cache layout (native endianness, every field 4 byte aligned):
+//   char[4] magic, uint32 version, uint64 source size, int64 source mtime in ns,
+//   uint64 source hash, uint64 material libraries hash, uint32 materials,
+//   uint32 objects, uint32 draws, uint32 material libraries, float weld tolerance,
+//   per material library: uint32 length, char[length] path as in the source, padded
+//     to 4 bytes
+//   per material: vec3 diffuse, reflective, specular, emission, uint32 length,
+//     char[length] texture path relative to the scene directory, padded to 4 bytes
+//   per object: uint32 material, uint32 vertices, uint32 indices, Vertex[vertices],
+//     uint32[indices]
+//   per draw: mat4 transform, uint32 object
+const char SCENE_CACHE_MAGIC[4] = {'L', 'W', 'S', 'C'};
+// bumped whenever the layout or the import post-processing changes
+const uint32_t SCENE_CACHE_VERSION = 3;
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex isn't packed");
+
+struct Header
+{
+    char magic_[4];
+    uint32_t version_;
+    uint64_t source_size_;
+    int64_t source_mtime_;
+    uint64_t source_hash_;
+    uint64_t libraries_hash_;
+    uint32_t materials_;
+    uint32_t objects_;
+    uint32_t draws_;
+    uint32_t libraries_;
+    float weld_tolerance_;
+};
+
+// in nanoseconds, edits within a second of each other have different times
+int64_t ModificationTime(const std::string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return -1;
+    return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// FNV-1a, continued from hash to chain several files
+uint64_t HashFile(const std::string &path, uint64_t hash = 14695981039346656037ull)
+{
+    MappedFile file(path);
+    for (size_t i = 0; i < file.Size(); i++)
+        hash = (hash ^ uint8_t(file.Data()[i])) * 1099511628211ull;
+    return hash;
+}
+
+// the mtllib lines of a Wavefront file; Assimp takes the materials from these, the
+// cache has to notice edits to them as well as to the source
+std::vector<std::string> MaterialLibraries(const std::string &source)
+{
+    std::vector<std::string> libraries;
+    std::string extension = boost::filesystem::extension(source);
+    if (!boost::algorithm::iequals(extension, ".obj"))
+        return libraries;
+
+    std::ifstream in(source);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        boost::algorithm::trim(line);
+        if (line.size() > 6 && line.compare(0, 6, "mtllib") == 0 &&
+            std::isspace((unsigned char)line[6]))
+            libraries.push_back(boost::algorithm::trim_copy(line.substr(6)));
+    }
+    return libraries;
+}
+
+// missing libraries hash like empty ones, Assimp imports default materials for both
+uint64_t HashLibraries(const std::vector<std::string> &libraries, const std::string &dir)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const auto &library : libraries)
+        hash = HashFile(library[0] == '/' ? library : dir + "/" + library, hash);
+    return hash;
+}
+
+// reads the mapped file front to back, failing once past its end; arrays are viewed in
+// place
+class Reader
+{
+    const MappedFile &file_;
+    size_t offset_ = 0;
+    bool good_ = true;
+
+  public:
+    explicit Reader(const MappedFile &file) : file_(file) {}
+
+    bool Good() const { return good_; }
+    bool AtEnd() const { return offset_ == file_.Size(); }
+    size_t Remaining() const { return file_.Size() - offset_; }
+
+    void Read(void *target, size_t bytes)
+    {
+        good_ = good_ && bytes <= file_.Size() - offset_;
+        if (!good_ || bytes == 0)
+            return;
+        std::memcpy(target, file_.Data() + offset_, bytes);
+        offset_ += (bytes + 3) & ~size_t(3);
+    }
+
+    template <typename T> Span<const T> View(uint32_t count)
+    {
+        static_assert(alignof(T) <= 4, "The file only aligns to 4 bytes");
+        size_t bytes = size_t(count) * sizeof(T);
+        good_ = good_ && bytes <= file_.Size() - offset_;
+        if (!good_)
+            return Span<const T>();
+
+        Span<const T> ret(reinterpret_cast<const T *>(file_.Data() + offset_), count);
+        offset_ += (bytes + 3) & ~size_t(3);
+        return ret;
+    }
+};
+
+// the indices a damaged or tampered file may hold, out of range they'd be read blindly
+bool Consistent(const SceneDescription &scene)
+{
+    for (const auto &object : scene.objects_)
+    {
+        if (object.material_ >= scene.materials_.size() ||
+            object.indices_.size() % 3 != 0)
+            return false;
+        for (glm::u32 index : object.indices_)
+            if (index >= object.vertices_.size())
+                return false;
+    }
+
+    for (const auto &draw : scene.draws_)
+        if (draw.object_ >= scene.objects_.size())
+            return false;
+    return true;
+}
+
+void Write(std::ofstream &out, const void *data, size_t bytes)
+{
+    static const char padding[4] = {};
+    out.write((const char *)data, bytes);
+    out.write(padding, ((bytes + 3) & ~size_t(3)) - bytes);
+}
+
+} // namespace
+
+bool ReadSceneCache(const std::string &path, const std::string &source,
+                    const std::string &dir, SceneDescription *scene)
+{
+    namespace fs = boost::filesystem;
+    if (!fs::exists(path))
+        return false;
+
+    MappedFile file(path);
+    Reader in(file);
+    Header header;
+    in.Read(&header, sizeof(Header));
+    if (!in.Good() || !std::equal(header.magic_, header.magic_ + 4, SCENE_CACHE_MAGIC) ||
+        header.version_ != SCENE_CACHE_VERSION ||
+        header.source_size_ != uint64_t(fs::file_size(source)))
+        return false;
+    // hashing the source costs a read of it, still far less than an import
+    int64_t mtime = ModificationTime(source);
+    if (header.source_mtime_ != mtime && header.source_hash_ != HashFile(source))
+        return false;
+
+    // smallest size of each entry, counts the rest of the file can't hold are damage and
+    // would otherwise be allocated before the reads fail
+    uint64_t least_bytes = uint64_t(header.libraries_) * 4 +
+                           uint64_t(header.materials_) * (4 * sizeof(glm::vec3) + 4) +
+                           uint64_t(header.objects_) * 3 * sizeof(uint32_t) +
+                           uint64_t(header.draws_) * (sizeof(glm::mat4) + 4);
+    if (least_bytes > in.Remaining())
+        return false;
+
+    // the libraries are small, unlike the source they're hashed on every read
+    std::vector<std::string> libraries(header.libraries_);
+    for (auto &library : libraries)
+    {
+        uint32_t length = 0;
+        in.Read(&length, sizeof(uint32_t));
+        auto name = in.View<char>(length);
+        library.assign(name.begin(), name.end());
+    }
+    if (!in.Good() || header.libraries_hash_ != HashLibraries(libraries, dir))
+        return false;
+
+    SceneDescription ret;
+    ret.weld_tolerance_ = header.weld_tolerance_;
+    ret.materials_.resize(header.materials_);
+    for (auto &material : ret.materials_)
+    {
+        glm::vec3 colours[4];
+        uint32_t length = 0;
+        in.Read(colours, sizeof(colours));
+        in.Read(&length, sizeof(uint32_t));
+
+        auto texture = in.View<char>(length);
+        material.diffuse_ = colours[0];
+        material.reflective_ = colours[1];
+        material.specular_ = colours[2];
+        material.emission_ = colours[3];
+        if (length > 0)
+            material.texture_ = dir + "/" + std::string(texture.begin(), texture.end());
+    }
+
+    ret.objects_.resize(header.objects_);
+    for (auto &object : ret.objects_)
+    {
+        uint32_t counts[3] = {};
+        in.Read(counts, sizeof(counts));
+        object.material_ = counts[0];
+        object.vertices_ = in.View<Vertex>(counts[1]);
+        object.indices_ = in.View<glm::u32>(counts[2]);
+    }
+
+    ret.draws_.resize(header.draws_);
+    for (auto &draw : ret.draws_)
+    {
+        in.Read(&draw.transform_, sizeof(glm::mat4));
+        in.Read(&draw.object_, sizeof(uint32_t));
+    }
+
+    if (!in.Good() || !in.AtEnd() || !Consistent(ret))
+        return false;
+
+    // the source was touched but not changed, later runs then skip the hash; failing
+    // to update it only costs them the hash again
+    if (header.source_mtime_ != mtime)
+    {
+        std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(offsetof(Header, source_mtime_));
+        out.write((const char *)&mtime, sizeof(int64_t));
+    }
+
+    ret.file_ = std::move(file);
+    *scene = std::move(ret);
+    return true;
+}
+
+bool WriteSceneCache(const std::string &path, const std::string &source,
+                     const std::string &dir, const SceneDescription &scene)
+{
+    namespace fs = boost::filesystem;
+
+    Header header;
+    // no stray bytes in the padding
+    std::memset(&header, 0, sizeof(Header));
+    std::copy(SCENE_CACHE_MAGIC, SCENE_CACHE_MAGIC + 4, header.magic_);
+    header.version_ = SCENE_CACHE_VERSION;
+    header.source_size_ = fs::file_size(source);
+    header.source_mtime_ = ModificationTime(source);
+    header.source_hash_ = HashFile(source);
+    std::vector<std::string> libraries = MaterialLibraries(source);
+    header.libraries_hash_ = HashLibraries(libraries, dir);
+    header.materials_ = scene.materials_.size();
+    header.objects_ = scene.objects_.size();
+    header.draws_ = scene.draws_.size();
+    header.libraries_ = libraries.size();
+    header.weld_tolerance_ = scene.weld_tolerance_;
+
+    // write aside and rename, concurrent renders never map a partial file
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        Write(out, &header, sizeof(Header));
+
+        for (const auto &library : libraries)
+        {
+            uint32_t length = library.size();
+            Write(out, &length, sizeof(uint32_t));
+            Write(out, library.data(), length);
+        }
+
+        for (const auto &material : scene.materials_)
+        {
+            glm::vec3 colours[4] = {material.diffuse_, material.reflective_,
+                                    material.specular_, material.emission_};
+            std::string texture = material.texture_;
+            if (texture.compare(0, dir.size() + 1, dir + "/") == 0)
+                texture = texture.substr(dir.size() + 1);
+            uint32_t length = texture.size();
+
+            Write(out, colours, sizeof(colours));
+            Write(out, &length, sizeof(uint32_t));
+            Write(out, texture.data(), length);
+        }
+
+        for (const auto &object : scene.objects_)
+        {
+            uint32_t counts[3] = {object.material_, uint32_t(object.vertices_.size()),
+                                  uint32_t(object.indices_.size())};
+            Write(out, counts, sizeof(counts));
+            Write(out, object.vertices_.data(), sizeof(Vertex) * object.vertices_.size());
+            Write(out, object.indices_.data(), sizeof(glm::u32) * object.indices_.size());
+        }
+
+        for (const auto &draw : scene.draws_)
+        {
+            Write(out, &draw.transform_, sizeof(glm::mat4));
+            Write(out, &draw.object_, sizeof(uint32_t));
+        }
+
+        if (!out.good())
+            return false;
+    }
+
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
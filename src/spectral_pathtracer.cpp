@@ -0,0 +1,193 @@
+
+#include <glm/gtc/constants.hpp>
+
+#include "config.h"
+#include "spectral_pathtracer.h"
+
+namespace
+{
+
+float PowerHeuristic(float pdf, float other_pdf)
+{
+    return pdf * pdf / (pdf * pdf + other_pdf * other_pdf);
+}
+
+} // namespace
+
+SpectralPathTracer::SpectralPathTracer(const Scene &scene, const RayCaster &raycaster)
+    : Integrator(scene, raycaster),
+      max_depth_(Config::inst().GetOption<int>("spectral_max_depth")),
+      lights_(scene.area_lights_)
+{
+    log_.Info() << "Tracing " << SPECTRUM_HERO_WAVELENGTHS
+                << " wavelengths per path between " << SPECTRUM_LAMBDA_START << " and "
+                << SPECTRUM_LAMBDA_END << " nm.";
+}
+
+SampledSpectrum SpectralPathTracer::F(const ShadingPoint &point, glm::vec3 dir,
+                                      const HeroWavelengths &lambda) const
+{
+    if (glm::dot(point.normal_, dir) <= 0.0f)
+        return SampledSpectrum();
+
+    glm::vec3 brdf =
+        EvaluateBSDF(point.si_, point.viewer_, point.position_ + dir) /
+        glm::pi<float>();
+    return RGBToSpectrum(brdf, lambda);
+}
+
+float SpectralPathTracer::Pdf(const ShadingPoint &point, glm::vec3 dir) const
+{
+    float cosine = glm::dot(point.normal_, dir);
+    if (cosine <= 0.0f)
+        return 0.0f;
+
+    // the specular lobe is picked half of the time
+    float lobe = point.si_.record_->has_specular_ ? 0.5f : 1.0f;
+    return lobe * cosine / glm::pi<float>();
+}
+
+SampledSpectrum SpectralPathTracer::SampleLight(const ShadingPoint &point,
+                                                const HeroWavelengths &lambda,
+                                                Sampler &sampler) const
+{
+    float pick_pdf;
+    const auto &light = scene_.area_lights_[lights_.Sample(sampler.Get1D(), &pick_pdf)];
+    auto light_sample = light.Sample(point.position_, sampler);
+
+    glm::vec3 to_light = light_sample.first - point.position_;
+    float dist = glm::length(to_light);
+    glm::vec3 dir = to_light / dist;
+
+    float surface_cosine = glm::dot(point.normal_, dir);
+    float light_cosine = glm::abs(glm::dot(light.GetNormal(), dir));
+    if (surface_cosine <= 0.0f || light_cosine == 0.0f)
+        return SampledSpectrum();
+
+    float light_pdf = pick_pdf / light.GetArea() * dist * dist / light_cosine;
+    SampledSpectrum ret = F(point, dir, lambda) * RGBToSpectrum(light_sample.second, lambda) *
+                          (surface_cosine * PowerHeuristic(light_pdf, Pdf(point, dir)) /
+                           light_pdf);
+    if (ret.IsBlack())
+        return ret;
+
+    auto shadowhit = raycaster_.Trace(point.position_, dir);
+    if (shadowhit && shadowhit->first.dist_ < dist * 0.999f)
+        return SampledSpectrum();
+
+    return ret;
+}
+
+SampledSpectrum SpectralPathTracer::SampleSky(const ShadingPoint &point,
+                                              const HeroWavelengths &lambda,
+                                              Sampler &sampler) const
+{
+    float sky_pdf;
+    glm::vec3 dir = scene_.skybox_.SampleDirection(sampler.Get2D(), &sky_pdf);
+
+    float surface_cosine = glm::dot(point.normal_, dir);
+    if (sky_pdf == 0.0f || surface_cosine <= 0.0f)
+        return SampledSpectrum();
+
+    SampledSpectrum ret = F(point, dir, lambda) *
+                          RGBToSpectrum(scene_.skybox_.Sample(dir), lambda) *
+                          (surface_cosine * PowerHeuristic(sky_pdf, Pdf(point, dir)) / sky_pdf);
+    if (ret.IsBlack() || raycaster_.Trace(point.position_, dir))
+        return SampledSpectrum();
+
+    return ret;
+}
+
+glm::vec3 SpectralPathTracer::Trace(glm::vec3 origin, glm::vec3 dir, Sampler &sampler,
+                                    PixelAOV *aov, const glm::uvec2 *) const
+{
+    HeroWavelengths lambda(sampler.Get1D());
+    SampledSpectrum L(0.0f), beta(1.0f);
+
+    // emission seen through the camera or a mirror has no light sample to compete with
+    bool specular = true;
+    float bounce_pdf = 0.0f;
+
+    for (int depth = 0;; depth++)
+    {
+        auto intersection_raw = raycaster_.Trace(origin, dir);
+        if (!intersection_raw)
+        {
+            glm::vec3 sky = scene_.skybox_.Sample(dir);
+            float weight = 1.0f;
+            if (!specular && scene_.skybox_.HasMap())
+                weight = PowerHeuristic(bounce_pdf, scene_.skybox_.Pdf(dir));
+
+            L += beta * RGBToSpectrum(sky, lambda) * weight;
+            if (aov && depth == 0)
+                *aov = {sky, glm::vec3(), 0.0f};
+            break;
+        }
+
+        auto intersection = intersection_raw->first;
+        auto surface = intersection_raw->second;
+        SurfaceInteraction si = Interact(intersection, surface);
+        const MaterialRecord &material = *si.record_;
+
+        if (aov && depth == 0)
+            RecordAOV(aov, dir, si, intersection.dist_);
+
+        ShadingPoint point = {si.position_, si.normal_, origin, si};
+        if (glm::dot(point.normal_, dir) > 0.0f)
+            point.normal_ = -point.normal_;
+
+        if (material.emissive_)
+        {
+            float weight = 1.0f;
+            if (!specular)
+            {
+                float light_pdf = lights_.AreaPdf(material.emission_) * intersection.dist_ *
+                                  intersection.dist_ / glm::abs(glm::dot(point.normal_, dir));
+                weight = PowerHeuristic(bounce_pdf, light_pdf);
+            }
+            L += beta * RGBToSpectrum(material.emission_, lambda) * weight;
+        }
+
+        if (depth == max_depth_)
+            break;
+
+        if (!lights_.Empty())
+            L += beta * SampleLight(point, lambda, sampler);
+        if (scene_.skybox_.HasMap())
+            L += beta * SampleSky(point, lambda, sampler);
+
+        glm::vec3 new_dir;
+        if (material.has_specular_ && sampler.Get1D() < 0.5f)
+        {
+            auto reflection = SampleSpecularBSDF(point.si_, dir);
+
+            new_dir = reflection.dir_;
+            beta *= RGBToSpectrum(2.0f * reflection.radiance_ / reflection.pdf_, lambda);
+            specular = true;
+        }
+        else
+        {
+            new_dir = sampler.SampleCosineDirection(point.normal_);
+            bounce_pdf = Pdf(point, new_dir);
+            if (bounce_pdf == 0.0f)
+                break;
+
+            beta *= F(point, new_dir, lambda) *
+                    (glm::dot(point.normal_, new_dir) / bounce_pdf);
+            specular = false;
+        }
+
+        if (depth >= 3)
+        {
+            float survival = std::min(1.0f, beta.MaxValue());
+            if (sampler.Get1D() >= survival)
+                break;
+            beta *= 1.0f / survival;
+        }
+
+        origin = point.position_;
+        dir = new_dir;
+    }
+
+    return SpectrumToRGB(L, lambda);
+}
@@ -1,6 +1,35 @@
 
 #include "spectrum.h"
 
+namespace
+{
+
+// piecewise Gaussian with different widths left and right of the peak
+float Lobe(float lambda, float mean, float sigma_low, float sigma_high)
+{
+    float t = (lambda - mean) / (lambda < mean ? sigma_low : sigma_high);
+    return std::exp(-0.5f * t * t);
+}
+
+glm::vec3 XYZToLinearSRGB(glm::vec3 xyz)
+{
+    return glm::vec3(3.2404542f * xyz.x - 1.5371385f * xyz.y - 0.4985314f * xyz.z,
+                     -0.9692660f * xyz.x + 1.8760108f * xyz.y + 0.0415560f * xyz.z,
+                     0.0556434f * xyz.x - 0.2040259f * xyz.y + 1.0572252f * xyz.z);
+}
+
+// colour of the flat spectrum of 1 over the rendered range
+glm::vec3 FlatSpectrumRGB()
+{
+    glm::vec3 xyz = glm::vec3();
+    for (int lambda = SPECTRUM_LAMBDA_START; lambda < SPECTRUM_LAMBDA_END; lambda++)
+        xyz += CIEMatching(float(lambda) + 0.5f);
+
+    return XYZToLinearSRGB(xyz);
+}
+
+} // namespace
+
 float VisibleSpectrum::AverageSpectrumSamples(float lambda_low, float lambda_high,
                                               const std::vector<LightSample> &samples)
 {
@@ -40,4 +69,21 @@ float VisibleSpectrum::AverageSpectrumSamples(float lambda_low, float lambda_hig
     }
 
     return ret / span;
-}
\ No newline at end of file
+}
+
+glm::vec3 CIEMatching(float lambda)
+{
+    return glm::vec3(1.056f * Lobe(lambda, 599.8f, 37.9f, 31.0f) +
+                         0.362f * Lobe(lambda, 442.0f, 16.0f, 26.7f) -
+                         0.065f * Lobe(lambda, 501.1f, 20.4f, 26.2f),
+                     0.821f * Lobe(lambda, 568.8f, 46.9f, 40.5f) +
+                         0.286f * Lobe(lambda, 530.9f, 16.3f, 31.1f),
+                     1.217f * Lobe(lambda, 437.0f, 11.8f, 36.0f) +
+                         0.681f * Lobe(lambda, 459.0f, 26.0f, 13.8f));
+}
+
+glm::vec3 XYZToRGB(glm::vec3 xyz)
+{
+    static const glm::vec3 white = FlatSpectrumRGB();
+    return XYZToLinearSRGB(xyz) / white;
+}
@@ -0,0 +1,220 @@
+
+#include <algorithm>
+#include <sstream>
+
+#include "exceptions.h"
+#include "task_graph.h"
+
+TaskGraph::~TaskGraph()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+TaskGraph::Task TaskGraph::Add(const std::string &name, std::function<void()> work,
+                               const std::vector<Task> &dependencies, bool main_thread)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Task task = Task(nodes_.size());
+
+    Node node;
+    node.name_ = name;
+    node.work_ = std::move(work);
+    node.main_thread_ = main_thread;
+    node.state_ = State::Waiting;
+    node.remaining_ = 0;
+    node.dependencies_ = dependencies;
+
+    for (Task dependency : dependencies)
+    {
+        STRONG_ASSERT(dependency < task, "Tasks depend on tasks added before them");
+        Node &other = nodes_[dependency];
+        if (other.state_ == State::Done)
+        {
+            if (other.error_ && !node.error_)
+                node.error_ = other.error_;
+        }
+        else
+        {
+            node.remaining_++;
+            other.dependents_.push_back(task);
+        }
+    }
+    nodes_.push_back(std::move(node));
+
+    if (nodes_[task].remaining_ == 0)
+    {
+        if (nodes_[task].error_)
+            Finish(task, nodes_[task].error_);
+        else
+        {
+            nodes_[task].state_ = State::Ready;
+            if (!main_thread)
+                ready_.push_back(task);
+            changed_.notify_all();
+        }
+    }
+    return task;
+}
+
+void TaskGraph::Start(size_t threads)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    STRONG_ASSERT(workers_.empty(), "The task graph is already started");
+
+    for (size_t t = 0; t < std::max<size_t>(1, threads); t++)
+        workers_.emplace_back([this]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true)
+            {
+                changed_.wait(lock, [this]() { return stopping_ || !ready_.empty(); });
+                if (stopping_)
+                    return;
+
+                Task task = ready_.front();
+                ready_.pop_front();
+                Run(task, lock);
+            }
+        });
+}
+
+void TaskGraph::Run(Task task, std::unique_lock<std::mutex> &lock)
+{
+    // nodes_ may grow while the task runs, nothing refers into it meanwhile
+    nodes_[task].state_ = State::Running;
+    nodes_[task].start_ = Clock::now();
+    std::function<void()> work = std::move(nodes_[task].work_);
+
+    lock.unlock();
+    std::exception_ptr error;
+    try
+    {
+        work();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    lock.lock();
+
+    Finish(task, error);
+}
+
+void TaskGraph::Finish(Task task, std::exception_ptr error)
+{
+    Node &node = nodes_[task];
+    node.state_ = State::Done;
+    node.end_ = Clock::now();
+    node.error_ = error;
+
+    for (Task dependent : node.dependents_)
+    {
+        Node &other = nodes_[dependent];
+        if (error && !other.error_)
+            other.error_ = error;
+        if (--other.remaining_ > 0)
+            continue;
+
+        // the failure of a dependency fails the task without running it
+        if (other.error_)
+            Finish(dependent, other.error_);
+        else
+        {
+            other.state_ = State::Ready;
+            if (!other.main_thread_)
+                ready_.push_back(dependent);
+        }
+    }
+    changed_.notify_all();
+}
+
+bool TaskGraph::Done(Task task) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    STRONG_ASSERT(task < nodes_.size());
+    return nodes_[task].state_ == State::Done;
+}
+
+void TaskGraph::Wait(Task task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    STRONG_ASSERT(task < nodes_.size());
+
+    // nobody else runs the main thread tasks on the way, waiting for them only would
+    // never end
+    while (nodes_[task].state_ != State::Done)
+    {
+        Task next;
+        if (NextMainThreadTask(task, &next))
+            Run(next, lock);
+        else
+            changed_.wait(lock);
+    }
+    if (nodes_[task].error_)
+        std::rethrow_exception(nodes_[task].error_);
+}
+
+bool TaskGraph::NextMainThreadTask(Task task, Task *next) const
+{
+    // dependencies have smaller ids, a pass downwards visits each after its dependents
+    std::vector<bool> needed(task + 1, false);
+    needed[task] = true;
+    for (Task t = task + 1; t-- > 0;)
+    {
+        const Node &node = nodes_[t];
+        if (!needed[t] || node.state_ == State::Done)
+            continue;
+        if (node.main_thread_ && node.state_ == State::Ready)
+        {
+            *next = t;
+            return true;
+        }
+        for (Task dependency : node.dependencies_)
+            needed[dependency] = true;
+    }
+    return false;
+}
+
+void TaskGraph::LogTimings() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto ms = [](Clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    };
+
+    // the tasks overlap where their sum exceeds the time they took together
+    Clock::time_point last = created_;
+    Clock::duration sum(0);
+    for (const auto &node : nodes_)
+    {
+        if (node.state_ != State::Done || node.start_ == Clock::time_point())
+            continue;
+        last = std::max(last, node.end_);
+        sum += node.end_ - node.start_;
+    }
+    log_.Info() << "Startup took " << ms(last - created_) << " ms, its tasks " << ms(sum)
+                << " ms:";
+
+    for (const auto &node : nodes_)
+    {
+        std::stringstream line;
+        line << "  " << node.name_ << (node.main_thread_ ? " (main thread): " : ": ");
+        if (node.state_ == State::Done && node.start_ == Clock::time_point())
+            line << "skipped, a dependency failed";
+        else if (node.state_ == State::Done)
+            line << ms(node.start_ - created_) << " - " << ms(node.end_ - created_)
+                 << " ms" << (node.error_ ? ", failed" : "");
+        else if (node.state_ == State::Running)
+            line << "running since " << ms(node.start_ - created_) << " ms";
+        else
+            line << "not started";
+        log_.Info() << line.str();
+    }
+}
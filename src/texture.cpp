@@ -1,81 +1,270 @@
 
 
 #include <SDL2/SDL_surface.h>
+#include <SDL2pp/Surface.hh>
+#include <algorithm>
 #include <boost/filesystem.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
+#include "config.h"
 #include "exceptions.h"
 #include "texture.h"
+#include "texture_cache.h"
+#include "texture_codec.h"
 
-int modulo(int x, int y) { return (x % y + y) % y; }
+namespace
+{
 
-glm::vec3 GetPixel(SDL_Surface *surface, int x, int y)
+// Repeats x over [0, period). Power of two sizes, most textures, take a mask, which in
+// two's complement wraps negative coordinates too. Other sizes take the remainder, it
+// keeps the sign of negative coordinates and the arithmetic shift turns that into a
+// mask adding one period.
+int Wrap(int x, uint32_t period)
 {
-    int bpp = surface->format->BytesPerPixel;
-    /* Here p is the address to the pixel we want to retrieve */
-    Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch + x * bpp;
+    if ((period & (period - 1)) == 0)
+        return x & int(period - 1);
+
+    x %= int(period);
+    return x + (int(period) & (x >> 31));
+}
 
-    switch (bpp)
+// bound in place of textures not uploaded yet, the preview shows the plain diffuse
+// colours until they are
+GLuint PlaceholderTexture(GLenum target)
+{
+    static GLuint texture = 0;
+    if (texture == 0)
     {
-    case 1:
-        return glm::vec3(float(*p) / float(0xff), float(*p) / float(0xff),
-                         float(*p) / float(0xff));
-        break;
-
-    case 2:
-        STRONG_ASSERT(0);
-        break;
-
-    case 3:
-        return glm::vec3(float(p[0]) / float(0xff), float(p[1]) / float(0xff),
-                         float(p[2]) / float(0xff));
-        break;
-
-    case 4:
-        return glm::vec3(float(p[0]) / float(0xff), float(p[1]) / float(0xff),
-                         float(p[2]) / float(0xff));
-        break;
-
-    default:
-        STRONG_ASSERT(0);
-        return glm::vec3();
+        const uint32_t white = 0xffffffff;
+        glGenTextures(1, &texture);
+        glBindTexture(target, texture);
+        glTexImage2D(target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+        glTexParameterf(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameterf(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     }
+    return texture;
 }
 
+} // namespace
+
+// Tiled texture layout (native endianness):
+//   char[4] magic, uint32 version, uint32 levels, uint32[2 * levels] level sizes,
+//   then the pages of all levels, TextureCache::PAGE_BYTES each
+const char TILED_MAGIC[4] = {'L', 'W', 'T', 'X'};
+const uint32_t TILED_VERSION = 1;
+
 Texture::Texture(GLenum texture_target, const std::string &file_name)
-    : texture_target_(texture_target),
-      surface_(boost::filesystem::exists(file_name) ? SDL2pp::Surface(file_name)
-                                                    : SDL2pp::Surface("res/fail.png")),
-      w_(surface_.GetWidth()), h_(surface_.GetHeight())
+    : texture_target_(texture_target), file_name_(file_name)
 {
-    if (!boost::filesystem::exists(file_name))
-        Log("TextureReader").Error() << "Texture: " << file_name << " does not exist!";
+}
 
-    STRONG_ASSERT(surface_.GetSize().x > 0);
+void Texture::Load()
+{
+    std::call_once(load_once_, [this]() {
+        Read();
+        loaded_.store(true, std::memory_order_release);
+    });
 }
 
-void Texture::SetupForOpenGL()
+void Texture::Read()
 {
-    glGenTextures(1, &texture_obj_);
-    glBindTexture(texture_target_, texture_obj_);
+    bool compress = Config::inst().GetOption<bool>("texture_compression");
+    if (!TextureCache::inst().Enabled())
+    {
+        Decode(file_name_);
+        if (compress)
+            Compress();
+        return;
+    }
+
+    std::string tiled_path = file_name_ + ".lwtx";
+    uint64_t offset;
+    if (!ReadTiled(tiled_path, file_name_, &offset))
+    {
+        Decode(file_name_);
+        if (!WriteTiled(tiled_path, &offset))
+        {
+            Log("TextureReader").Warning()
+                << "Couldn't write " << tiled_path << ", keeping the texture in memory.";
+            if (compress)
+                Compress();
+            return;
+        }
+        texels_ = std::vector<uint32_t>();
+    }
+
+    cache_ = &TextureCache::inst();
+    cache_id_ = cache_->Register(tiled_path, offset, page_count_);
+}
+
+void Texture::AddLevel(uint32_t w, uint32_t h)
+{
+    // the last row and column of pages are padded
+    Level level;
+    level.w_ = w;
+    level.h_ = h;
+    level.pages_x_ = (w + PAGE_SIZE - 1) / PAGE_SIZE;
+    level.first_page_ = page_count_;
+
+    page_count_ += level.pages_x_ * ((h + PAGE_SIZE - 1) / PAGE_SIZE);
+    levels_.push_back(level);
+}
+
+void Texture::Decode(const std::string &file_name)
+{
+    // bytes R, G, B, A in memory, whatever the format of the file
+    SDL2pp::Surface surface = SDL2pp::Surface(file_name).Convert(SDL_PIXELFORMAT_RGBA32);
+    STRONG_ASSERT(surface.GetWidth() > 0 && surface.GetHeight() > 0);
+
+    // the whole pyramid is laid out first, texels_ is allocated once
+    AddLevel(surface.GetWidth(), surface.GetHeight());
+    while (levels_.back().w_ > 1 || levels_.back().h_ > 1)
+        AddLevel(std::max(1u, levels_.back().w_ / 2),
+                 std::max(1u, levels_.back().h_ / 2));
+    texels_.assign(size_t(page_count_) * TextureCache::PAGE_TEXELS, 0);
+
+    auto texel = [&](const Level &level, uint32_t x, uint32_t y) -> uint32_t & {
+        return texels_[size_t(Page(level, x, y)) * TextureCache::PAGE_TEXELS +
+                       TexelInPage(x, y)];
+    };
+
+    const auto *pixels = static_cast<const uint8_t *>(surface.Get()->pixels);
+    for (uint32_t y = 0; y < levels_[0].h_; y++)
+        for (uint32_t x = 0; x < levels_[0].w_; x++)
+            std::memcpy(&texel(levels_[0], x, y),
+                        pixels + y * surface.Get()->pitch + 4 * x, 4);
+
+    // the padding of the last pages repeats the edge, blocks cut by the edge then encode
+    // the texture's colours only
+    auto pad = [&](const Level &level) {
+        uint32_t pages_y = (level.h_ + PAGE_SIZE - 1) / PAGE_SIZE;
+        for (uint32_t y = 0; y < pages_y * PAGE_SIZE; y++)
+            for (uint32_t x = 0; x < level.pages_x_ * PAGE_SIZE; x++)
+                if (x >= level.w_ || y >= level.h_)
+                    texel(level, x, y) = texel(level, std::min(x, level.w_ - 1),
+                                               std::min(y, level.h_ - 1));
+    };
+    pad(levels_[0]);
+
+    // box filtered halves, odd sizes drop their last row or column
+    for (size_t l = 1; l < levels_.size(); l++)
+    {
+        const Level &fine = levels_[l - 1];
+        const Level &coarse = levels_[l];
+
+        for (uint32_t y = 0; y < coarse.h_; y++)
+            for (uint32_t x = 0; x < coarse.w_; x++)
+            {
+                uint32_t x0 = std::min(2 * x, fine.w_ - 1);
+                uint32_t x1 = std::min(2 * x + 1, fine.w_ - 1);
+                uint32_t y0 = std::min(2 * y, fine.h_ - 1);
+                uint32_t y1 = std::min(2 * y + 1, fine.h_ - 1);
+
+                uint8_t quad[4][4], average[4];
+                std::memcpy(quad[0], &texel(fine, x0, y0), 4);
+                std::memcpy(quad[1], &texel(fine, x1, y0), 4);
+                std::memcpy(quad[2], &texel(fine, x0, y1), 4);
+                std::memcpy(quad[3], &texel(fine, x1, y1), 4);
+                for (int c = 0; c < 4; c++)
+                    average[c] = uint8_t(
+                        (quad[0][c] + quad[1][c] + quad[2][c] + quad[3][c] + 2) / 4);
+                std::memcpy(&texel(coarse, x, y), average, 4);
+            }
+        pad(coarse);
+    }
+}
+
+void Texture::Compress()
+{
+    // tiles are the 4x4 blocks, contiguous in the pages
+    blocks_.resize(texels_.size() / BLOCK_TEXELS);
+    for (size_t b = 0; b < blocks_.size(); b++)
+        blocks_[b] = EncodeBlock(&texels_[b * BLOCK_TEXELS]);
+    texels_ = std::vector<uint32_t>();
+}
 
-    int mode;
-    switch (surface_.Get()->format->BytesPerPixel)
+bool Texture::ReadTiled(const std::string &path, const std::string &source,
+                        uint64_t *offset)
+{
+    namespace fs = boost::filesystem;
+    if (!fs::exists(path) || fs::last_write_time(path) < fs::last_write_time(source))
+        return false;
+
+    std::ifstream in(path, std::ios::binary);
+    char magic[4];
+    uint32_t version, level_count;
+    in.read(magic, sizeof(magic));
+    in.read((char *)&version, sizeof(uint32_t));
+    in.read((char *)&level_count, sizeof(uint32_t));
+    if (!in.good() || !std::equal(magic, magic + 4, TILED_MAGIC) ||
+        version != TILED_VERSION)
+        return false;
+
+    for (uint32_t l = 0; l < level_count; l++)
+    {
+        uint32_t size[2];
+        in.read((char *)size, sizeof(size));
+        AddLevel(size[0], size[1]);
+    }
+
+    *offset = uint64_t(in.tellg());
+    if (!in.good() ||
+        fs::file_size(path) != *offset + uint64_t(page_count_) * TextureCache::PAGE_BYTES)
     {
-    case 3:
-        mode = GL_RGB;
-        break;
-    case 4:
-        mode = GL_RGBA;
-        break;
-
-    default:
-        STRONG_ASSERT(0);
+        levels_.clear();
+        page_count_ = 0;
+        return false;
     }
+    return true;
+}
+
+bool Texture::WriteTiled(const std::string &path, uint64_t *offset) const
+{
+    // write aside and rename, concurrent renders never read a partial file
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        uint32_t level_count = levels_.size();
+
+        out.write(TILED_MAGIC, sizeof(TILED_MAGIC));
+        out.write((const char *)&TILED_VERSION, sizeof(uint32_t));
+        out.write((const char *)&level_count, sizeof(uint32_t));
+        for (const auto &level : levels_)
+        {
+            out.write((const char *)&level.w_, sizeof(uint32_t));
+            out.write((const char *)&level.h_, sizeof(uint32_t));
+        }
+        *offset = uint64_t(out.tellp());
+        out.write((const char *)texels_.data(), sizeof(uint32_t) * texels_.size());
+
+        if (!out.good())
+            return false;
+    }
+
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+void Texture::SetupForOpenGL()
+{
+    // materials sharing the texture upload it once
+    if (texture_obj_ != 0)
+        return;
+
+    EnsureLoaded();
+    const Level &level = levels_[0];
+    std::vector<uint32_t> rows(size_t(level.w_) * level.h_);
+    for (uint32_t y = 0; y < level.h_; y++)
+        for (uint32_t x = 0; x < level.w_; x++)
+            rows[size_t(y) * level.w_ + x] = Texel(level, x, y);
 
+    glGenTextures(1, &texture_obj_);
     glBindTexture(texture_target_, texture_obj_);
 
-    glTexImage2D(texture_target_, 0, mode, surface_.GetWidth(), surface_.GetHeight(), 0,
-                 mode, GL_UNSIGNED_BYTE, surface_.Get()->pixels);
+    glTexImage2D(texture_target_, 0, GL_RGBA, level.w_, level.h_, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, rows.data());
 
     glTexParameterf(texture_target_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameterf(texture_target_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -85,14 +274,68 @@ void Texture::SetupForOpenGL()
 void Texture::Bind(GLenum texture_unit)
 {
     glActiveTexture(texture_unit);
-    glBindTexture(texture_target_, texture_obj_);
+    glBindTexture(texture_target_,
+                  texture_obj_ != 0 ? texture_obj_ : PlaceholderTexture(texture_target_));
+}
+
+uint32_t Texture::Texel(const Level &level, uint32_t x, uint32_t y) const
+{
+    uint32_t page = Page(level, x, y);
+    if (cache_)
+        return cache_->Fetch(cache_id_, page, TexelInPage(x, y));
+
+    size_t texel = size_t(page) * TextureCache::PAGE_TEXELS + TexelInPage(x, y);
+    if (!blocks_.empty())
+        return DecodeTexel(blocks_[texel / BLOCK_TEXELS], texel % BLOCK_TEXELS);
+    return texels_[texel];
+}
+
+glm::vec3 Texture::Fetch(const Level &level, int x, int y) const
+{
+    uint32_t rgba = Texel(level, Wrap(x, level.w_), Wrap(y, level.h_));
+    uint8_t texel[4];
+    std::memcpy(texel, &rgba, 4);
+    return glm::vec3(texel[0], texel[1], texel[2]) * (1.0f / 255.0f);
 }
 
 glm::vec3 Texture::GetPixel(glm::vec2 uv) const
 {
-    int x = uv.x * w_;
-    int y = uv.y * h_;
-    return ::GetPixel(surface_.Get(), modulo(x, w_), modulo(y, h_));
+    EnsureLoaded();
+    const Level &level = levels_[0];
+    return Fetch(level, int(std::floor(uv.x * float(level.w_))),
+                 int(std::floor(uv.y * float(level.h_))));
+}
+
+glm::vec3 Texture::Bilinear(const Level &level, glm::vec2 uv) const
+{
+    // texel centres are at half integers
+    float x = uv.x * float(level.w_) - 0.5f;
+    float y = uv.y * float(level.h_) - 0.5f;
+    float x0 = std::floor(x), y0 = std::floor(y);
+    float fx = x - x0, fy = y - y0;
+
+    int ix = int(x0), iy = int(y0);
+    glm::vec3 top = Fetch(level, ix, iy) * (1.0f - fx) + Fetch(level, ix + 1, iy) * fx;
+    glm::vec3 bottom =
+        Fetch(level, ix, iy + 1) * (1.0f - fx) + Fetch(level, ix + 1, iy + 1) * fx;
+    return top * (1.0f - fy) + bottom * fy;
+}
+
+glm::vec3 Texture::Sample(glm::vec2 uv, float lod) const
+{
+    EnsureLoaded();
+    float max_lod = float(levels_.size() - 1);
+    // written so that a NaN lod ends at the full resolution
+    lod = lod > 0.0f ? std::min(lod, max_lod) : 0.0f;
+
+    int fine = int(lod);
+    int coarse = std::min(fine + 1, int(levels_.size()) - 1);
+    float t = lod - float(fine);
+
+    glm::vec3 ret = Bilinear(levels_[fine], uv);
+    if (t > 0.0f)
+        ret = ret * (1.0f - t) + Bilinear(levels_[coarse], uv) * t;
+    return ret;
 }
 
 Texture::~Texture()
@@ -0,0 +1,203 @@
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "texture_cache.h"
+#include "config.h"
+#include "exceptions.h"
+
+TextureCache::Descriptor::~Descriptor() { close(fd_); }
+
+TextureCache::TextureCache(size_t budget_bytes)
+    : slot_count_(budget_bytes / PAGE_BYTES), slots_(new Slot[slot_count_]),
+      texels_(new std::atomic<uint32_t>[size_t(slot_count_) * PAGE_TEXELS])
+{
+    for (uint32_t i = 0; i < slot_count_; i++)
+    {
+        slots_[i].key_.store(NO_KEY, std::memory_order_relaxed);
+        slots_[i].version_.store(0, std::memory_order_relaxed);
+        slots_[i].referenced_.store(false, std::memory_order_relaxed);
+    }
+    for (auto &counter : hits_)
+        counter.value_.store(0, std::memory_order_relaxed);
+    misses_.store(0, std::memory_order_relaxed);
+    evictions_.store(0, std::memory_order_relaxed);
+    if (Enabled())
+        files_.reserve(MAX_FILES);
+
+    if (budget_bytes > 0)
+        STRONG_ASSERT(slot_count_ > 0, "The texture cache is smaller than one page!");
+}
+
+TextureCache &TextureCache::inst()
+{
+    static TextureCache instance(
+        size_t(Config::inst().GetOption<int>("texture_cache_size")) * 1024 * 1024);
+    return instance;
+}
+
+uint32_t TextureCache::Register(const std::string &path, uint64_t offset,
+                                uint32_t page_count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    STRONG_ASSERT(files_.size() < MAX_FILES, "Too many textures for the texture cache");
+
+    // opened on the first miss, registering thousands of textures takes no descriptors
+    auto file = std::make_unique<File>();
+    file->path_ = path;
+    file->offset_ = offset;
+    file->page_count_ = page_count;
+    file->slots_.reset(new std::atomic<uint32_t>[page_count]);
+    for (uint32_t i = 0; i < page_count; i++)
+        file->slots_[i].store(NO_SLOT, std::memory_order_relaxed);
+
+    files_.push_back(std::move(file));
+    return uint32_t(files_.size() - 1);
+}
+
+uint32_t TextureCache::PickVictim()
+{
+    // an empty slot or the first one not used since the hand last passed it, slots
+    // other threads are filling are skipped
+    while (true)
+    {
+        uint32_t slot = hand_;
+        hand_ = (hand_ + 1) % slot_count_;
+
+        if (slots_[slot].version_.load(std::memory_order_relaxed) & 1)
+            continue;
+        if (slots_[slot].key_.load(std::memory_order_relaxed) == NO_KEY ||
+            !slots_[slot].referenced_.exchange(false, std::memory_order_relaxed))
+            return slot;
+    }
+}
+
+std::shared_ptr<TextureCache::Descriptor> TextureCache::Open(uint32_t texture)
+{
+    std::lock_guard<std::mutex> lock(descriptors_mutex_);
+    descriptor_clock_++;
+
+    for (auto &open_file : open_files_)
+        if (open_file.texture_ == texture)
+        {
+            open_file.last_use_ = descriptor_clock_;
+            return open_file.descriptor_;
+        }
+
+    const std::string &path = files_[texture]->path_;
+    int fd = open(path.c_str(), O_RDONLY);
+    STRONG_ASSERT(fd >= 0, "Couldn't open tiled texture " + path);
+    auto descriptor = std::make_shared<Descriptor>(fd);
+
+    // readers still holding the closed one keep it open until they are done
+    OpenFile open_file = {texture, descriptor_clock_, descriptor};
+    if (open_files_.size() < MAX_OPEN_FILES)
+        open_files_.push_back(open_file);
+    else
+        *std::min_element(open_files_.begin(), open_files_.end(),
+                          [](const OpenFile &a, const OpenFile &b) {
+                              return a.last_use_ < b.last_use_;
+                          }) = open_file;
+    return descriptor;
+}
+
+void TextureCache::ReadPage(uint32_t texture, uint32_t page, uint32_t *data)
+{
+    const File &file = *files_[texture];
+    auto descriptor = Open(texture);
+
+    // pread leaves the shared descriptor's offset alone, threads read concurrently
+    char *bytes = reinterpret_cast<char *>(data);
+    off_t offset = off_t(file.offset_ + uint64_t(page) * PAGE_BYTES);
+    size_t done = 0;
+    while (done < PAGE_BYTES)
+    {
+        ssize_t count = pread(descriptor->fd_, bytes + done, PAGE_BYTES - done,
+                              offset + off_t(done));
+        STRONG_ASSERT(count > 0, "Tiled texture " + file.path_ + " is truncated!");
+        done += size_t(count);
+    }
+}
+
+uint32_t TextureCache::FetchMissing(uint32_t texture, uint32_t page, uint32_t texel)
+{
+    misses_.fetch_add(1, std::memory_order_relaxed);
+
+    // the page may still be being filled by another thread, or evicted again before it
+    // is read, however unlikely
+    uint32_t value;
+    while (!TryFetch(Load(texture, page), Key(texture, page), texel, &value))
+        std::this_thread::yield();
+    return value;
+}
+
+uint32_t TextureCache::Load(uint32_t texture, uint32_t page)
+{
+    uint64_t key = Key(texture, page);
+    File &file = *files_[texture];
+
+    // another thread may have loaded it meanwhile, or be filling it
+    auto holds_page = [&](uint32_t slot) {
+        return slot != NO_SLOT &&
+               slots_[slot].key_.load(std::memory_order_relaxed) == key;
+    };
+    uint32_t slot = file.slots_[page].load(std::memory_order_acquire);
+    if (holds_page(slot))
+        return slot;
+
+    // the disk read takes no lock, misses of other pages go on meanwhile
+    thread_local std::array<uint32_t, PAGE_TEXELS> data;
+    ReadPage(texture, page, data.data());
+
+    uint32_t version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot = file.slots_[page].load(std::memory_order_relaxed);
+        if (holds_page(slot))
+            return slot;
+
+        slot = PickVictim();
+        Slot &s = slots_[slot];
+        if (s.key_.load(std::memory_order_relaxed) != NO_KEY)
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+
+        // readers of the old page see the odd version and retry, the new key tells
+        // other misses of this page to wait for it instead of reading it again
+        version = s.version_.load(std::memory_order_relaxed) + 1;
+        s.version_.store(version, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.key_.store(key, std::memory_order_relaxed);
+        s.referenced_.store(true, std::memory_order_relaxed);
+        file.slots_[page].store(slot, std::memory_order_release);
+    }
+
+    for (uint32_t i = 0; i < PAGE_TEXELS; i++)
+        texels_[size_t(slot) * PAGE_TEXELS + i].store(data[i], std::memory_order_relaxed);
+    slots_[slot].version_.store(version + 1, std::memory_order_release);
+    return slot;
+}
+
+TextureCache::Statistics TextureCache::GetStatistics() const
+{
+    Statistics ret;
+    ret.hits_ = 0;
+    for (const auto &counter : hits_)
+        ret.hits_ += counter.value_.load(std::memory_order_relaxed);
+    ret.misses_ = misses_.load(std::memory_order_relaxed);
+    ret.evictions_ = evictions_.load(std::memory_order_relaxed);
+    return ret;
+}
+
+void TextureCache::LogStatistics() const
+{
+    if (!Enabled())
+        return;
+
+    Statistics stats = GetStatistics();
+    uint64_t lookups = stats.hits_ + stats.misses_;
+    log_.Info() << "Texture lookups: " << lookups << ", "
+                << (lookups ? 100.0 * double(stats.hits_) / double(lookups) : 0.0)
+                << "% hits, " << stats.misses_ << " misses, " << stats.evictions_
+                << " evicted; " << slot_count_ * (PAGE_BYTES / 1024) << " kB of pages.";
+}
@@ -0,0 +1,103 @@
+
+#include <algorithm>
+#include <cstring>
+
+#include "texture_codec.h"
+
+namespace
+{
+
+uint32_t Expand(uint32_t value, uint32_t bits)
+{
+    return value << (8 - bits) | value >> (2 * bits - 8);
+}
+
+uint32_t ToRGB565(glm::vec3 c)
+{
+    c = glm::clamp(c, 0.0f, 255.0f);
+    return uint32_t(c.x * 31.0f / 255.0f + 0.5f) << 11 |
+           uint32_t(c.y * 63.0f / 255.0f + 0.5f) << 5 |
+           uint32_t(c.z * 31.0f / 255.0f + 0.5f);
+}
+
+} // namespace
+
+uint32_t DecodeTexel(uint64_t block, uint32_t i)
+{
+    // weight of the second end point, in thirds, by palette index
+    static const uint32_t WEIGHTS[4] = {0, 3, 1, 2};
+    uint32_t w = WEIGHTS[(block >> (32 + 2 * i)) & 3];
+    uint32_t c0 = uint32_t(block) & 0xffff, c1 = uint32_t(block >> 16) & 0xffff;
+
+    auto channel = [&](uint32_t shift, uint32_t bits) -> uint8_t {
+        uint32_t mask = (1u << bits) - 1;
+        uint32_t a = Expand(c0 >> shift & mask, bits);
+        uint32_t b = Expand(c1 >> shift & mask, bits);
+        return uint8_t((a * (3 - w) + b * w + 1) / 3);
+    };
+    uint8_t texel[4] = {channel(11, 5), channel(5, 6), channel(0, 5), 255};
+
+    uint32_t ret;
+    std::memcpy(&ret, texel, 4);
+    return ret;
+}
+
+uint64_t EncodeBlock(const uint32_t *texels)
+{
+    glm::vec3 colours[BLOCK_TEXELS], mean(0.0f);
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+    {
+        uint8_t texel[4];
+        std::memcpy(texel, &texels[i], 4);
+        colours[i] = glm::vec3(texel[0], texel[1], texel[2]);
+        mean += colours[i] / float(BLOCK_TEXELS);
+    }
+
+    // rows of the covariance, its dominant eigenvector by power iteration
+    glm::vec3 covariance[3] = {glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)};
+    for (const auto &c : colours)
+        for (int row = 0; row < 3; row++)
+            covariance[row] += (c[row] - mean[row]) * (c - mean);
+    glm::vec3 axis(1.0f);
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 next(glm::dot(covariance[0], axis), glm::dot(covariance[1], axis),
+                       glm::dot(covariance[2], axis));
+        float length = glm::length(next);
+        if (length < 1e-6f)
+            break;
+        axis = next / length;
+    }
+    axis = glm::normalize(axis);
+
+    float low = 0.0f, high = 0.0f;
+    for (const auto &c : colours)
+    {
+        low = std::min(low, glm::dot(c - mean, axis));
+        high = std::max(high, glm::dot(c - mean, axis));
+    }
+    uint64_t block = ToRGB565(mean + low * axis) | ToRGB565(mean + high * axis) << 16;
+
+    glm::vec3 palette[4];
+    for (uint32_t index = 0; index < 4; index++)
+    {
+        // the decoder's own rounding, the block with every texel on this entry
+        uint8_t texel[4];
+        uint32_t rgba = DecodeTexel(block | uint64_t(index) << 32, 0);
+        std::memcpy(texel, &rgba, 4);
+        palette[index] = glm::vec3(texel[0], texel[1], texel[2]);
+    }
+
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+    {
+        uint64_t best = 0;
+        for (uint32_t index = 1; index < 4; index++)
+        {
+            glm::vec3 d = colours[i] - palette[index], e = colours[i] - palette[best];
+            if (glm::dot(d, d) < glm::dot(e, e))
+                best = index;
+        }
+        block |= best << (32 + 2 * i);
+    }
+    return block;
+}
@@ -0,0 +1,78 @@
+
+#include <boost/filesystem.hpp>
+
+#include "config.h"
+#include "texture_manager.h"
+
+TextureManager::~TextureManager() { Wait(); }
+
+Texture *TextureManager::Acquire(const std::string &path)
+{
+    STRONG_ASSERT(workers_.empty(), "Texture acquired after the prefetch started");
+
+    std::string file_name = path;
+    if (!boost::filesystem::exists(file_name))
+    {
+        log_.Error() << "Texture: " << path << " does not exist!";
+        file_name = "res/fail.png";
+    }
+
+    // one key however the file is spelled, dir/./a.png and dir/a.png alike
+    std::string key = boost::filesystem::weakly_canonical(file_name).string();
+    auto &texture = textures_[key];
+    if (!texture)
+        texture = std::make_unique<Texture>(GL_TEXTURE_2D, file_name);
+    return texture.get();
+}
+
+void TextureManager::Prefetch()
+{
+    if (!workers_.empty() || textures_.empty())
+        return;
+
+    for (auto &texture : textures_)
+        pending_.push_back(texture.second.get());
+
+    int option = Config::inst().GetOption<int>("threads");
+    size_t threads = std::min(pending_.size(), size_t(std::max(1, option)));
+    log_.Info() << "Decoding " << pending_.size() << " textures on " << threads
+                << " threads";
+    prefetch_start_ = std::chrono::steady_clock::now();
+
+    // decoding times vary with the file sizes, taking one texture at a time balances them
+    for (size_t t = 0; t < threads; t++)
+        workers_.emplace_back([this]() {
+            for (size_t i = next_++; i < pending_.size(); i = next_++)
+            {
+                try
+                {
+                    pending_[i]->Load();
+                }
+                catch (const std::exception &e)
+                {
+                    // the first use reports it again on its own thread
+                    log_.Error() << "Prefetching a texture failed: " << e.what();
+                }
+            }
+        });
+}
+
+void TextureManager::Wait()
+{
+    bool joined = false;
+    for (auto &worker : workers_)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+            joined = true;
+        }
+    }
+
+    if (joined)
+        log_.Info() << "Decoded " << pending_.size() << " textures in "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - prefetch_start_)
+                           .count()
+                    << " ms";
+}
@@ -1,10 +1,12 @@
 
-#include <OpenEXR/ImfRgbaFile.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <boost/filesystem.hpp>
 
 #include "config.h"
+#include "denoiser.h"
 #include "sampler.h"
+#include "texture_cache.h"
 #include "view_raytracer.h"
 
 using namespace SDL2pp;
@@ -40,15 +42,18 @@ void SaveTexture(std::string filename, SDL_Renderer *renderer, SDL_Texture *text
     SDL_SetRenderTarget(renderer, target);
 }
 
-ViewRayCaster::ViewRayCaster(const Scene &scene)
+ViewRayCaster::ViewRayCaster(std::unique_ptr<RayCaster> raycaster,
+                             std::unique_ptr<Integrator> integrator)
     : rx_(Config::inst().GetOption<int>("resx")),
       ry_(Config::inst().GetOption<int>("resy")),
       window_("RayCaster preview", rx_ + 30, SDL_WINDOWPOS_CENTERED, rx_, ry_,
               Config::inst().GetOption<bool>("interactive") ? 0 : SDL_WINDOW_HIDDEN),
       renderer_(window_, -1, SDL_RENDERER_SOFTWARE),
       tex_(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, rx_, ry_),
-      raytracer_surface_(new uint8_t[rx_ * ry_ * 4]),
-      sky_color_(Config::inst().GetOption<glm::vec3>("sky")), pathtracer_(scene)
+      preview_(rx_, ry_),
+      sky_color_(Config::inst().GetOption<glm::vec3>("sky")), film_(rx_, ry_),
+      checkpoint_interval_(0.0f), raycaster_(std::move(raycaster)),
+      integrator_(std::move(integrator))
 {
 }
 
@@ -59,63 +64,104 @@ void ViewRayCaster::Render()
     renderer_.Present();
 }
 
-void ViewRayCaster::TakePicture(glm::vec3 camera_pos, glm::mat4 mvp, const Scene &scene)
+void ViewRayCaster::PresentPreview()
 {
-    Log("RayCasterView").Info() << "Started taking picture.";
-    Imf::Rgba *buffer = new Imf::Rgba[rx_ * ry_];
+    tex_.Update(NullOpt, preview_.Data(), preview_.Pitch());
+    Render();
+}
 
-    auto inv_mvp = glm::inverse(mvp);
-    auto iso = Config::inst().GetOption<float>("iso");
+std::vector<glm::vec3> ViewRayCaster::DenoisePreview(float iso)
+{
+    auto denoised = Denoiser().Denoise(film_, iso);
+
+    for (uint32_t y = 0; y < ry_; y++)
+        for (uint32_t x = 0; x < rx_; x++)
+            preview_.SetPixel(x, y, denoised[y * rx_ + x], iso);
+    PresentPreview();
+
+    return denoised;
+}
+
+bool ViewRayCaster::RefinementCancelled()
+{
+    // Only key presses are taken from the queue, so the OpenGL view does not replay
+    // camera movements queued up during the render.
+    bool cancelled = false;
+    SDL_Event event;
+
+    SDL_PumpEvents();
+    while (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_KEYDOWN, SDL_KEYDOWN) > 0)
+    {
+        if (event.key.keysym.sym == SDLK_SPACE)
+            cancelled = true;
+    }
+
+    return cancelled;
+}
+
+void ViewRayCaster::Checkpoint(bool force)
+{
+    if (checkpoint_path_ == "")
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (!force && std::chrono::duration<float>(now - last_checkpoint_).count() <
+                      checkpoint_interval_)
+        return;
 
+    film_.SaveCheckpoint(checkpoint_path_);
+    last_checkpoint_ = now;
+    log_.Info() << "Checkpoint saved to " << checkpoint_path_;
+}
+
+void ViewRayCaster::RenderPass(glm::vec3 camera_pos, glm::mat4 inv_mvp,
+                               uint32_t target_samples, float iso, bool report_progress)
+{
     float pixel_step_x = 1.0f / float(rx_ / 2);
     float pixel_step_y = 1.0f / float(ry_ / 2);
 
-    int samples_per_pixel = Config::inst().GetOption<int>("samples_per_pixel");
+    uint32_t seed = Config::inst().GetOption<int>("seed");
 
-    auto rt_func = [&](int x_start, int cols) -> void {
-        Sampler sampler;
+    auto rt_func = [&](unsigned int x_start, unsigned int cols) -> void {
+        auto sampler = MakeSampler(seed);
 
-        for (int x = x_start; x < x_start + cols; x += 1)
+        for (unsigned int x = x_start; x < std::min(x_start + cols, rx_); x += 1)
         {
             for (unsigned int y = 0; y < ry_; y += 1)
             {
+                uint32_t samples_done = film_.GetSampleCount(x, y);
+                if (samples_done >= target_samples)
+                    continue;
+
                 glm::vec3 value = glm::vec3();
+                PixelAOV aov_sum = {glm::vec3(), glm::vec3(), 0.0f};
 
-                for (int s = 0; s < samples_per_pixel; s++)
+                for (uint32_t s = samples_done; s < target_samples; s++)
                 {
                     float xr = (float(x) - float(rx_ / 2)) / (float(rx_ / 2));
                     float yr = (float(y) - float(ry_ / 2)) / (float(ry_ / 2));
 
-                    float deviation_x = (sampler.Sample() - 0.5f) * pixel_step_x;
-                    float deviation_y = (sampler.Sample() - 0.5f) * pixel_step_y;
+                    sampler->StartPixelSample(x, y, s);
+                    auto jitter = sampler->Get2D();
+                    float deviation_x = (jitter.x - 0.5f) * pixel_step_x;
+                    float deviation_y = (jitter.y - 0.5f) * pixel_step_y;
 
                     glm::vec4 ray_r(xr + deviation_x, -yr + deviation_y, 1, 1);
                     auto dir = inv_mvp * ray_r;
-                    value += pathtracer_.Trace(camera_pos, glm::normalize(dir));
-                }
-
-                uint8_t b;
-                uint8_t g;
-                uint8_t r;
-                uint8_t a;
-
-                auto readout = value * iso / float(samples_per_pixel);
-                r = float(0xff) * glm::min(readout.x, 1.0f);
-                g = float(0xff) * glm::min(readout.y, 1.0f);
-                b = float(0xff) * glm::min(readout.z, 1.0f);
-                a = 0xff;
 
-                uint8_t *target_pixel = raytracer_surface_ + y * rx_ * 4 + x * 4;
+                    PixelAOV aov;
+                    glm::uvec2 pixel(x, y);
+                    value += integrator_->Trace(camera_pos, glm::normalize(dir), *sampler,
+                                                &aov, &pixel);
 
-                *(uint32_t *)target_pixel = b;
-                *(uint32_t *)target_pixel += (uint32_t)g << 8;
-                *(uint32_t *)target_pixel += (uint32_t)r << 16;
-                *(uint32_t *)target_pixel += (uint32_t)a << 24;
+                    aov_sum.albedo_ += aov.albedo_;
+                    aov_sum.normal_ += aov.normal_;
+                    aov_sum.depth_ += aov.depth_;
+                }
 
-                int pixel_id = y * rx_ + x;
-                buffer[pixel_id].r = readout.x;
-                buffer[pixel_id].g = readout.y;
-                buffer[pixel_id].b = readout.z;
+                film_.AddSamples(x, y, value, target_samples - samples_done);
+                film_.AddAOVs(x, y, aov_sum);
+                preview_.SetPixel(x, y, film_.GetPixel(x, y), iso);
             }
         }
     };
@@ -136,27 +182,116 @@ void ViewRayCaster::TakePicture(glm::vec3 camera_pos, glm::mat4 mvp, const Scene
             threads[t].join();
         }
 
-        tex_.Update(NullOpt, raytracer_surface_, rx_ * 4);
-        renderer_.Clear();
-        renderer_.Copy(tex_, NullOpt, NullOpt);
-        renderer_.Present();
+        Checkpoint(false);
+
+        if (report_progress)
+        {
+            PresentPreview();
+            log_.Info() << "Progress: " << float(x) / float(rx_) * 100.0f << "%.";
+        }
+    }
 
-        log_.Info() << "Progress: " << float(x) / float(rx_) * 100.0f << "%.";
+    // splats of light paths land on pixels already shown
+    if (integrator_->Splats())
+    {
+        preview_.Update(film_, iso);
+        PresentPreview();
     }
+}
+
+void ViewRayCaster::TakePicture(glm::vec3 camera_pos, glm::mat4 mvp, const Scene &scene)
+{
+    Log("RayCasterView").Info() << "Started taking picture.";
+
+    auto inv_mvp = glm::inverse(mvp);
+    auto iso = Config::inst().GetOption<float>("iso");
+
+    uint32_t samples_per_pixel = Config::inst().GetOption<int>("samples_per_pixel");
 
     std::string png_file_path =
         Config::inst().GetOption<std::string>("target_file") + ".png";
     std::string exr_file_path =
         Config::inst().GetOption<std::string>("target_file") + ".exr";
 
+    checkpoint_path_ = Config::inst().GetOption<std::string>("checkpoint_file");
+    checkpoint_interval_ = Config::inst().GetOption<float>("checkpoint_interval");
+    last_checkpoint_ = std::chrono::steady_clock::now();
+
+    if (Config::inst().GetOption<bool>("resume") && checkpoint_path_ != "" &&
+        boost::filesystem::exists(checkpoint_path_))
+    {
+        film_ = Film::LoadCheckpoint(checkpoint_path_);
+        STRONG_ASSERT(film_.GetWidth() == rx_ && film_.GetHeight() == ry_,
+                      "Checkpoint resolution doesn't match the requested one!");
+
+        log_.Info() << "Resuming from " << checkpoint_path_;
+        preview_.Update(film_, iso);
+        PresentPreview();
+    }
+    else
+    {
+        film_.Clear();
+    }
+
+    // the seed keys the sample streams of MakeSampler; films rendered with the same seed
+    // hold the same samples, merging or resuming them would count those twice
+    film_.AddSeed(Config::inst().GetOption<int>("seed"));
+    integrator_->SetCamera(camera_pos, inv_mvp, film_);
+
+    bool denoise = Config::inst().GetOption<bool>("denoise");
+    std::vector<glm::vec3> denoised;
+
+    if (Config::inst().GetOption<bool>("progressive"))
+    {
+        // 1, 2, 4, ... samples per pixel, the whole frame in each pass
+        bool snapshots = Config::inst().GetOption<bool>("progressive_snapshots");
+        uint32_t target_samples = 1;
+
+        for (int pass = 0;; pass++)
+        {
+            target_samples = std::min(target_samples, samples_per_pixel);
+            integrator_->StartPass(pass);
+            RenderPass(camera_pos, inv_mvp, target_samples, iso, false);
+            PresentPreview();
+
+            log_.Info() << "Pass " << pass << " done, " << target_samples
+                        << " samples per pixel.";
+
+            if (denoise)
+                denoised = DenoisePreview(iso);
+
+            if (snapshots)
+                film_.WriteEXR(exr_file_path, iso, denoised);
+
+            if (target_samples == samples_per_pixel)
+                break;
+
+            if (RefinementCancelled())
+            {
+                log_.Info() << "Refinement stopped by the user.";
+                break;
+            }
+
+            target_samples *= 2;
+        }
+    }
+    else
+    {
+        integrator_->StartPass(0);
+        RenderPass(camera_pos, inv_mvp, samples_per_pixel, iso, true);
+
+        if (denoise)
+            denoised = DenoisePreview(iso);
+    }
+
+    Checkpoint(true);
+
+    TextureCache::inst().LogStatistics();
     Log("RayCasterView").Info() << "Taking picture done. Saving to: " << png_file_path
                                 << " and " << exr_file_path;
 
     SaveTexture(Config::inst().GetOption<std::string>("target_file"), renderer_.Get(),
                 tex_.Get());
 
-    Imf::RgbaOutputFile file(exr_file_path.c_str(), rx_, ry_, Imf::WRITE_RGB);
-    file.setFrameBuffer(buffer, 1, rx_);
-    file.writePixels(ry_);
-    delete[] buffer;
+    film_.WriteEXR(exr_file_path, iso, denoised);
 }
@@ -0,0 +1,50 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Compact vertices"
+
+#include "compact_vertices.h"
+#include "mesh.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(RoundTripTest)
+{
+    std::vector<Vertex> vertices;
+    for (int i = 0; i < 100; i++)
+    {
+        float t = float(i) / 99.0f;
+        glm::vec3 position(t * 10.0f - 3.0f, 2.0f, t * t);
+        glm::vec3 normal(std::cos(t * 6.0f), std::sin(t * 6.0f), t - 0.5f);
+        vertices.push_back({position, glm::vec2(t, 1.0f - t), glm::normalize(normal)});
+    }
+
+    CompactVertices compact(vertices);
+    BOOST_CHECK_EQUAL(compact.Size(), vertices.size());
+    BOOST_CHECK_EQUAL(compact.Bytes(), vertices.size() * 16);
+
+    PositionStream positions(nullptr, &compact);
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        Vertex v = compact.Decode(i);
+        // half a step of 2^21 over the 10 units of the bounds
+        BOOST_CHECK_SMALL(glm::length(v.pos_ - vertices[i].pos_), 1e-5f);
+        BOOST_CHECK(positions[i] == v.pos_);
+        BOOST_CHECK_SMALL(glm::length(v.tex_ - vertices[i].tex_), 1e-4f);
+        BOOST_CHECK_SMALL(glm::length(v.norm_ - vertices[i].norm_), 1e-3f);
+    }
+
+    // a flat extent stays exactly in place
+    BOOST_CHECK_EQUAL(compact.Position(42).y, 2.0f);
+}
+
+BOOST_AUTO_TEST_CASE(FullPrecisionStreamTest)
+{
+    std::vector<Vertex> vertices = {
+        {glm::vec3(1.0f, 2.0f, 3.0f), glm::vec2(0.0f), glm::vec3(0.0f, 0.0f, -1.0f)}};
+
+    PositionStream positions(vertices.data(), nullptr);
+    BOOST_CHECK(positions[0] == vertices[0].pos_);
+
+    // the lower half of the octahedron folds back onto the same normal
+    CompactVertices compact(vertices);
+    BOOST_CHECK_SMALL(glm::length(compact.Decode(0).norm_ - vertices[0].norm_), 1e-4f);
+}
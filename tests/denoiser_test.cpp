@@ -0,0 +1,94 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Denoiser"
+
+#include "denoiser.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+const uint32_t SIZE = 16;
+
+using Albedo = glm::vec3 (*)(uint32_t x);
+using Irradiance = glm::vec3 (*)(uint32_t x, uint32_t y);
+
+// one sample per pixel of radiance albedo * irradiance, facing the camera at depth 1
+void Fill(Film &film, Albedo albedo, Irradiance irradiance)
+{
+    film.Clear();
+    for (uint32_t y = 0; y < SIZE; y++)
+        for (uint32_t x = 0; x < SIZE; x++)
+        {
+            film.AddSamples(x, y, albedo(x) * irradiance(x, y), 1);
+            film.AddAOVs(x, y, {albedo(x), glm::vec3(0.0f, 0.0f, 1.0f), 1.0f});
+        }
+}
+
+glm::vec3 White(uint32_t) { return glm::vec3(1.0f); }
+
+// a sharp texture edge down the middle of the image
+glm::vec3 Stripes(uint32_t x) { return glm::vec3(x < SIZE / 2 ? 0.2f : 0.8f); }
+
+glm::vec3 Constant(uint32_t, uint32_t) { return glm::vec3(0.5f); }
+
+// deterministic noise around 0.5
+glm::vec3 Noisy(uint32_t x, uint32_t y)
+{
+    uint32_t h = (x * 73856093u) ^ (y * 19349663u);
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return glm::vec3(0.25f + 0.5f * float(h & 0xffff) / 65535.0f);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(ConstantImageTest)
+{
+    Film film(SIZE, SIZE);
+    Fill(film, White, Constant);
+
+    auto denoised = Denoiser().Denoise(film, 1.0f);
+    BOOST_REQUIRE_EQUAL(denoised.size(), SIZE * SIZE);
+    for (const auto &pixel : denoised)
+        BOOST_CHECK_CLOSE(pixel.x, 0.5f, 1e-3f);
+}
+
+BOOST_AUTO_TEST_CASE(AlbedoEdgeTest)
+{
+    // the irradiance is smooth, the edge is in the albedo only and must stay sharp
+    Film film(SIZE, SIZE);
+    Fill(film, Stripes, Constant);
+
+    auto denoised = Denoiser().Denoise(film, 1.0f);
+    for (uint32_t y = 0; y < SIZE; y++)
+    {
+        BOOST_CHECK_CLOSE(denoised[y * SIZE + SIZE / 2 - 1].x, 0.1f, 1e-2f);
+        BOOST_CHECK_CLOSE(denoised[y * SIZE + SIZE / 2].x, 0.4f, 1e-2f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(NoiseReductionTest)
+{
+    Film film(SIZE, SIZE);
+    Fill(film, White, Noisy);
+
+    auto variance = [](const std::vector<glm::vec3> &pixels) {
+        float mean = 0.0f, squares = 0.0f;
+        for (const auto &pixel : pixels)
+        {
+            mean += pixel.x;
+            squares += pixel.x * pixel.x;
+        }
+        mean /= pixels.size();
+        return squares / pixels.size() - mean * mean;
+    };
+
+    std::vector<glm::vec3> noisy;
+    for (uint32_t y = 0; y < SIZE; y++)
+        for (uint32_t x = 0; x < SIZE; x++)
+            noisy.push_back(film.GetPixel(x, y));
+
+    BOOST_CHECK_LT(variance(Denoiser().Denoise(film, 1.0f)), 0.25f * variance(noisy));
+}
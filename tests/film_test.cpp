@@ -0,0 +1,41 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Film checkpoints"
+
+#include "film.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(CheckpointRoundTripTest)
+{
+    Film film(4, 2);
+    film.AddSeed(7);
+    film.AddSamples(3, 1, glm::vec3(2.0f, 4.0f, 6.0f), 2);
+    film.AddSplat(3, 1, glm::vec3(0.0f, 2.0f, 0.0f));
+
+    film.SaveCheckpoint("film_test.lwcp");
+    Film loaded = Film::LoadCheckpoint("film_test.lwcp");
+
+    BOOST_CHECK_EQUAL(loaded.GetWidth(), 4u);
+    BOOST_CHECK_EQUAL(loaded.GetHeight(), 2u);
+    BOOST_CHECK_EQUAL(loaded.GetSampleCount(3, 1), 2u);
+    BOOST_CHECK_EQUAL(loaded.GetSampleCount(0, 0), 0u);
+    BOOST_CHECK_CLOSE(loaded.GetPixel(3, 1).x, 1.0f, 0.01f);
+    BOOST_CHECK_CLOSE(loaded.GetPixel(3, 1).y, 3.0f, 0.01f);
+    BOOST_CHECK_EQUAL(loaded.GetSeeds().size(), 1u);
+};
+
+BOOST_AUTO_TEST_CASE(MergeTest)
+{
+    Film first(2, 2), second(2, 2), same_seed(2, 2);
+    first.AddSeed(1);
+    second.AddSeed(2);
+    same_seed.AddSeed(1);
+
+    first.AddSamples(0, 0, glm::vec3(1.0f), 1);
+    second.AddSamples(0, 0, glm::vec3(3.0f), 1);
+
+    BOOST_CHECK(first.Merge(second));
+    BOOST_CHECK(!first.Merge(same_seed));
+    BOOST_CHECK_EQUAL(first.GetSampleCount(0, 0), 2u);
+    BOOST_CHECK_CLOSE(first.GetPixel(0, 0).x, 2.0f, 0.01f);
+};
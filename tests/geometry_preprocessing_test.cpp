@@ -0,0 +1,74 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Geometry preprocessing"
+
+#include "geometry_preprocessing.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+Vertex At(float x, float y)
+{
+    return {glm::vec3(x, y, 0.0f), glm::vec2(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)};
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(CleanupTest)
+{
+    // two triangles of a quad, the second with its own copy of a shared corner, then
+    // a degenerate and a duplicate one
+    std::vector<Vertex> vertices = {At(0, 0), At(1, 0), At(1, 1),
+                                    At(0, 1), At(1.000001f, 1), At(2, 2)};
+    std::vector<glm::u32> indices = {0, 1, 2, 0, 4, 3, 0, 2, 5, 2, 0, 1};
+
+    auto report = PreprocessGeometry(&vertices, &indices, 1e-5f);
+    BOOST_CHECK_EQUAL(report.welded_vertices_, 1u);
+    BOOST_CHECK_EQUAL(report.degenerate_triangles_, 1u);
+    BOOST_CHECK_EQUAL(report.duplicate_triangles_, 1u);
+    // the far corner of the degenerate triangle
+    BOOST_CHECK_EQUAL(report.unused_vertices_, 1u);
+
+    BOOST_CHECK_EQUAL(vertices.size(), 4u);
+    BOOST_CHECK_EQUAL(indices.size(), 6u);
+    // numbered by first use
+    BOOST_CHECK_EQUAL(indices[0], 0u);
+    BOOST_CHECK_EQUAL(indices[1], 1u);
+    BOOST_CHECK_EQUAL(indices[2], 2u);
+}
+
+BOOST_AUTO_TEST_CASE(MortonOrderTest)
+{
+    // a row of triangles in reverse order along x
+    std::vector<Vertex> vertices;
+    std::vector<glm::u32> indices;
+    for (int i = 7; i >= 0; i--)
+    {
+        glm::u32 first = vertices.size();
+        vertices.push_back(At(i, 0));
+        vertices.push_back(At(i + 0.5f, 0));
+        vertices.push_back(At(i, 0.5f));
+        indices.insert(indices.end(), {first, first + 1, first + 2});
+    }
+
+    auto report = PreprocessGeometry(&vertices, &indices, 0.0f);
+    BOOST_CHECK_EQUAL(report.welded_vertices_, 0u);
+    BOOST_CHECK_EQUAL(indices.size(), 24u);
+    for (size_t t = 1; t < indices.size() / 3; t++)
+        BOOST_CHECK_LT(vertices[indices[3 * t - 3]].pos_.x,
+                       vertices[indices[3 * t]].pos_.x);
+}
+
+BOOST_AUTO_TEST_CASE(TinyToleranceTest)
+{
+    // the cells of a tolerance this small would be out of the range of int
+    std::vector<Vertex> vertices = {At(0, 0), At(1000, 0), At(1000, 1000), At(1000, 1000),
+                                    At(0, 1000)};
+    std::vector<glm::u32> indices = {0, 1, 2, 0, 3, 4};
+
+    auto report = PreprocessGeometry(&vertices, &indices, 1e-30f);
+    BOOST_CHECK_EQUAL(report.welded_vertices_, 1u);
+    BOOST_CHECK_EQUAL(report.duplicate_triangles_, 0u);
+    BOOST_CHECK_EQUAL(indices.size(), 6u);
+}
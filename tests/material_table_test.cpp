@@ -0,0 +1,62 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Material table"
+
+#include "material_table.h"
+#include "mesh.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+MaterialRecord Record(glm::vec3 albedo, glm::vec3 glossy)
+{
+    MaterialRecord record = {};
+    record.albedo_ = albedo;
+    record.glossy_ = glossy;
+    record.parameter_correction_ = 0.5f;
+    record.kind_ = glossy == glm::vec3(0.0f) ? BSDFKind::Lambertian : BSDFKind::Phong;
+    return record;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(InteractTest)
+{
+    MaterialTable table;
+    uint32_t matte = table.AddMaterial(Record(glm::vec3(0.8f), glm::vec3(0.0f)), nullptr);
+    uint32_t shiny = table.AddMaterial(Record(glm::vec3(0.2f), glm::vec3(0.6f)), nullptr);
+    table.AddObject(shiny);
+    table.AddObject(matte);
+
+    Vertex v = {glm::vec3(0.0f), glm::vec2(0.0f), glm::vec3(0.0f, 2.0f, 0.0f)};
+    auto si = table.Interact(1, glm::vec3(1.0f), glm::vec3(0.0f, 0.0f, 3.0f),
+                             glm::vec3(0.2f, 0.3f, 0.5f), v, v, v);
+
+    BOOST_CHECK(si.kind_ == BSDFKind::Lambertian);
+    BOOST_CHECK(si.record_ == &table.GetRecord(1));
+    BOOST_CHECK_CLOSE(si.normal_.z, 1.0f, 1e-4f);
+    BOOST_CHECK_CLOSE(si.shading_normal_.y, 1.0f, 1e-4f);
+    BOOST_CHECK_CLOSE(si.albedo_.x, 0.8f, 1e-4f);
+    BOOST_CHECK_CLOSE(si.diffuse_.x, 0.4f, 1e-4f);
+}
+
+BOOST_AUTO_TEST_CASE(KernelDispatchTest)
+{
+    MaterialTable table;
+    table.AddObject(table.AddMaterial(Record(glm::vec3(0.2f), glm::vec3(0.6f)), nullptr));
+
+    Vertex v = {glm::vec3(0.0f), glm::vec2(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)};
+    auto si = table.Interact(0, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                             glm::vec3(1.0f, 0.0f, 0.0f), v, v, v);
+    BOOST_CHECK(si.kind_ == BSDFKind::Phong);
+
+    // the mirror direction gets the whole Phong lobe, the Lambertian kernel none of it
+    glm::vec3 from(-1.0f, 1.0f, 0.0f), to(1.0f, 1.0f, 0.0f);
+    BOOST_CHECK_CLOSE(EvaluateBSDF(si, from, to).x, 0.7f, 1e-3f);
+    BOOST_CHECK_CLOSE(EvaluateBSDF<BSDFKind::Lambertian>(si, from, to).x, 0.1f, 1e-3f);
+
+    glm::vec3 grazing(1.0f, 0.0f, 1.0f);
+    BOOST_CHECK_CLOSE(EvaluateBSDF(si, from, grazing).x,
+                      EvaluateBSDF<BSDFKind::Phong>(si, from, grazing).x, 1e-4f);
+}
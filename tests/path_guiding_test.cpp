@@ -0,0 +1,83 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Path guiding"
+
+#include "path_guiding.h"
+#include "sampler.h"
+
+#include <boost/test/unit_test.hpp>
+#include <glm/gtc/constants.hpp>
+
+// a distribution trained on light coming mostly from around +z
+DirectionalDistribution TrainedDistribution()
+{
+    RandomSampler sampler(3);
+    DirectionalDistribution training;
+
+    for (int pass = 0; pass < 3; pass++)
+    {
+        for (uint32_t i = 0; i < 20000; i++)
+        {
+            sampler.StartPixelSample(i, pass, 0);
+            glm::vec3 dir = sampler.SampleDirection();
+            training.Record(dir, dir.z > 0.9f ? 10.0f : 0.1f);
+        }
+
+        training.Accumulate();
+        if (pass < 2)
+            training = training.Refined(0.01f);
+    }
+
+    return training;
+}
+
+BOOST_AUTO_TEST_CASE(PdfNormalizationTest)
+{
+    auto distribution = TrainedDistribution();
+    RandomSampler sampler(5);
+
+    // E[pdf / uniform pdf] over uniform directions is 1
+    double sum = 0.0;
+    const int samples = 100000;
+    for (int i = 0; i < samples; i++)
+    {
+        sampler.StartPixelSample(i, 0, 0);
+        sum += distribution.Pdf(sampler.SampleDirection()) * 4.0f * glm::pi<float>();
+    }
+
+    BOOST_CHECK_CLOSE(sum / samples, 1.0, 3.0);
+}
+
+BOOST_AUTO_TEST_CASE(SampleMatchesPdfTest)
+{
+    auto distribution = TrainedDistribution();
+    RandomSampler sampler(7);
+
+    // E[1 / pdf] over the samples is the sphere area, and most samples go up
+    double inverse_sum = 0.0;
+    int up = 0;
+    const int samples = 100000;
+    for (int i = 0; i < samples; i++)
+    {
+        sampler.StartPixelSample(i, 0, 0);
+        glm::vec3 dir = distribution.Sample(sampler.Get2D());
+        BOOST_REQUIRE_CLOSE(glm::length(dir), 1.0f, 0.01f);
+
+        inverse_sum += 1.0f / distribution.Pdf(dir);
+        up += dir.z > 0.9f ? 1 : 0;
+    }
+
+    BOOST_CHECK_CLOSE(inverse_sum / samples, 4.0 * glm::pi<double>(), 3.0);
+    BOOST_CHECK_GT(up, samples * 3 / 4);
+}
+
+BOOST_AUTO_TEST_CASE(SpatialSplitTest)
+{
+    GuidingField field(glm::vec3(0.0f), glm::vec3(1.0f), 100, 0.01f);
+
+    for (int i = 0; i < 1000; i++)
+        field.GetRegion(glm::vec3(0.1f)).samples_++;
+    field.Refine(0);
+
+    BOOST_CHECK_GT(field.GetRegionCount(), 1u);
+    BOOST_CHECK(&field.GetRegion(glm::vec3(0.1f)) != &field.GetRegion(glm::vec3(0.9f)));
+}
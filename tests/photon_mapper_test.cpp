@@ -0,0 +1,75 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Photon mapper"
+
+#include "photon_mapper.h"
+
+#include <boost/test/unit_test.hpp>
+#include <random>
+
+namespace
+{
+
+std::vector<Photon> RandomPhotons(size_t count, std::mt19937 &mt)
+{
+    std::uniform_real_distribution<float> dist(-5.0f, 5.0f);
+    std::vector<Photon> photons;
+    for (size_t i = 0; i < count; i++)
+    {
+        Photon photon = {};
+        photon.position_ = glm::vec3(dist(mt), dist(mt), dist(mt));
+        // the index, to tell the photons apart
+        photon.power_ = glm::vec3(float(i));
+        photons.push_back(photon);
+    }
+    return photons;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(GridLookupTest)
+{
+    std::mt19937 mt(7);
+    auto photons = RandomPhotons(5000, mt);
+    auto copy = photons;
+
+    PhotonGrid grid;
+    grid.Build(std::move(copy), 0.5f);
+    BOOST_CHECK_EQUAL(grid.Size(), photons.size());
+
+    // lookups of the build radius and smaller ones, the progressive passes shrink it
+    std::uniform_real_distribution<float> dist(-6.0f, 6.0f);
+    for (float radius : {0.5f, 0.3f, 0.05f})
+    {
+        for (int query = 0; query < 200; query++)
+        {
+            glm::vec3 position(dist(mt), dist(mt), dist(mt));
+
+            std::vector<int> found;
+            grid.ForEachPhoton(position, radius, [&](const Photon &photon) {
+                found.push_back(int(photon.power_.x));
+            });
+
+            std::vector<int> expected;
+            for (const auto &photon : photons)
+            {
+                glm::vec3 diff = photon.position_ - position;
+                if (glm::dot(diff, diff) < radius * radius)
+                    expected.push_back(int(photon.power_.x));
+            }
+
+            // every photon in range exactly once
+            std::sort(found.begin(), found.end());
+            BOOST_CHECK(found == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EmptyGridTest)
+{
+    PhotonGrid grid;
+    grid.Build({}, 1.0f);
+
+    int found = 0;
+    grid.ForEachPhoton(glm::vec3(0.0f), 1.0f, [&](const Photon &) { found++; });
+    BOOST_CHECK_EQUAL(found, 0);
+}
@@ -0,0 +1,44 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Preview buffer"
+
+#include "preview_buffer.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(SplatRefreshTest)
+{
+    const uint32_t rx = 8, ry = 4;
+    Film film(rx, ry);
+    PreviewBuffer preview(rx, ry), expected(rx, ry);
+
+    // a BDPT pass: every pixel is shown right after its own samples, while light paths
+    // splat onto pixels shown before
+    for (uint32_t x = 0; x < rx; x++)
+    {
+        for (uint32_t y = 0; y < ry; y++)
+        {
+            film.AddSamples(x, y, glm::vec3(0.1f), 1);
+            preview.SetPixel(x, y, film.GetPixel(x, y), 1.0f);
+        }
+        film.AddSplat(0, x % ry, glm::vec3(0.5f));
+    }
+
+    for (uint32_t y = 0; y < ry; y++)
+        for (uint32_t x = 0; x < rx; x++)
+            expected.SetPixel(x, y, film.GetPixel(x, y), 1.0f);
+    BOOST_CHECK(preview.GetPixel(0, 1) != expected.GetPixel(0, 1));
+
+    preview.Update(film, 1.0f);
+    for (uint32_t y = 0; y < ry; y++)
+        for (uint32_t x = 0; x < rx; x++)
+            BOOST_CHECK_EQUAL(preview.GetPixel(x, y), expected.GetPixel(x, y));
+}
+
+BOOST_AUTO_TEST_CASE(PixelFormatTest)
+{
+    PreviewBuffer preview(1, 1);
+
+    // ARGB, saturated at 1 and black below 0
+    preview.SetPixel(0, 0, glm::vec3(2.0f, -1.0f, 0.5f), 1.0f);
+    BOOST_CHECK_EQUAL(preview.GetPixel(0, 0), 0xffff007fu);
+}
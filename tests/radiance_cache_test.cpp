@@ -0,0 +1,55 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Radiance cache"
+
+#include "radiance_cache.h"
+
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(LookupTest)
+{
+    RadianceCache cache(10, 0.1f, 0.01f, 2);
+    glm::vec3 camera(0.0f), up(0.0f, 1.0f, 0.0f);
+
+    cache.Insert(glm::vec3(1.0f, 0.0f, 0.0f), up, camera, glm::vec3(1.0f, 2.0f, 3.0f));
+    BOOST_CHECK(!cache.Lookup(glm::vec3(1.0f, 0.0f, 0.0f), up, camera));
+
+    cache.Insert(glm::vec3(1.01f, 0.0f, 0.0f), up, camera, glm::vec3(3.0f, 2.0f, 1.0f));
+    auto cached = cache.Lookup(glm::vec3(1.02f, 0.0f, 0.0f), up, camera);
+    BOOST_REQUIRE(cached);
+    BOOST_CHECK_CLOSE(cached->x, 2.0f, 0.01f);
+    BOOST_CHECK_CLOSE(cached->z, 2.0f, 0.01f);
+
+    // other side of the surface
+    BOOST_CHECK(!cache.Lookup(glm::vec3(1.0f, 0.0f, 0.0f), -up, camera));
+
+    cache.Clear();
+    BOOST_CHECK(!cache.Lookup(glm::vec3(1.0f, 0.0f, 0.0f), up, camera));
+};
+
+BOOST_AUTO_TEST_CASE(ConcurrentInsertTest)
+{
+    RadianceCache cache(12, 0.1f, 0.01f, 1);
+    glm::vec3 camera(0.0f), up(0.0f, 1.0f, 0.0f);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 10000; i++)
+                cache.Insert(glm::vec3(float(i % 16), 0.0f, 0.0f), up, camera,
+                             glm::vec3(1.0f));
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    for (int i = 0; i < 16; i++)
+    {
+        auto cached = cache.Lookup(glm::vec3(float(i), 0.0f, 0.0f), up, camera);
+        BOOST_REQUIRE(cached);
+        BOOST_CHECK_CLOSE(cached->y, 1.0f, 0.01f);
+    }
+};
@@ -0,0 +1,49 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "ReSTIR reservoirs"
+
+#include "restir.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(ReservoirSelectionTest)
+{
+    LightCandidate dim = {glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f)};
+    LightCandidate bright = {glm::vec3(1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(3.0f)};
+
+    int bright_kept = 0;
+    const int runs = 10000;
+    for (int i = 0; i < runs; i++)
+    {
+        Reservoir reservoir;
+        reservoir.Update(dim, 1.0f, 1.0f, float(i % 100) / 100.0f);
+        reservoir.Update(bright, 3.0f, 3.0f, float(i) / float(runs));
+
+        BOOST_CHECK_EQUAL(reservoir.count_, 2u);
+        if (reservoir.sample_.emission_.x == 3.0f)
+            bright_kept++;
+    }
+
+    BOOST_CHECK_CLOSE(float(bright_kept) / float(runs), 0.75f, 1.0f);
+};
+
+BOOST_AUTO_TEST_CASE(ReservoirMergeTest)
+{
+    LightCandidate light = {glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f)};
+
+    Reservoir other;
+    for (int i = 0; i < 100; i++)
+        other.Update(light, 2.0f, 1.0f, 0.5f);
+    // the average resampling weight
+    BOOST_CHECK_CLOSE(other.ContributionWeight(), 2.0f, 0.01f);
+
+    Reservoir reservoir;
+    reservoir.Update(light, 2.0f, 1.0f, 0.5f);
+    reservoir.Merge(other, 1.0f, 0.5f, 10);
+
+    BOOST_CHECK_EQUAL(reservoir.count_, 11u);
+    BOOST_CHECK_CLOSE(reservoir.ContributionWeight(), 2.0f, 0.01f);
+
+    Reservoir empty;
+    BOOST_CHECK(!reservoir.Merge(empty, 1.0f, 0.0f, 10));
+    BOOST_CHECK_EQUAL(empty.ContributionWeight(), 0.0f);
+};
@@ -0,0 +1,120 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Samplers"
+
+#include "sampler.h"
+
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+
+// Every elementary interval of area 1/n holds exactly one of the n points.
+bool IsZeroTwoNet(const std::vector<glm::vec2> &points)
+{
+    int n = points.size();
+
+    for (int xdivs = n; xdivs >= 1; xdivs /= 2)
+    {
+        int ydivs = n / xdivs;
+        std::vector<int> hits(n, 0);
+
+        for (const auto &p : points)
+        {
+            if (hits[int(p.y * ydivs) * xdivs + int(p.x * xdivs)]++ > 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void CheckPrefixes(Sampler &sampler)
+{
+    for (uint32_t dimension = 0; dimension < 4; dimension++)
+    {
+        std::vector<glm::vec2> points;
+
+        for (uint32_t s = 0; s < 64; s++)
+        {
+            sampler.StartPixelSample(13, 7, s);
+            for (uint32_t d = 0; d < dimension; d++)
+                sampler.Get2D();
+
+            points.push_back(sampler.Get2D());
+
+            if (((s + 1) & s) == 0)
+                BOOST_CHECK(IsZeroTwoNet(points));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SobolStratificationTest)
+{
+    SobolSampler sampler(5);
+    CheckPrefixes(sampler);
+};
+
+BOOST_AUTO_TEST_CASE(PMJ02StratificationTest)
+{
+    PMJ02Sampler sampler(5, 64);
+    CheckPrefixes(sampler);
+};
+
+BOOST_AUTO_TEST_CASE(RandomSamplerReproducibilityTest)
+{
+    RandomSampler first(1), second(1), other_seed(2);
+
+    first.StartPixelSample(3, 4, 17);
+    second.StartPixelSample(3, 4, 17);
+    other_seed.StartPixelSample(3, 4, 17);
+
+    for (int d = 0; d < 8; d++)
+    {
+        float u = first.Get1D();
+        BOOST_CHECK(u >= 0.0f && u < 1.0f);
+        BOOST_CHECK_EQUAL(u, second.Get1D());
+        BOOST_CHECK_NE(u, other_seed.Get1D());
+    }
+};
+
+BOOST_AUTO_TEST_CASE(RandomSamplerSeedStreamTest)
+{
+    // the seed has a lane of its own, no pixel of one seed repeats a pixel of another
+    RandomSampler seeded(6), unseeded(0);
+    std::vector<float> values;
+
+    for (uint32_t x = 0; x < 64; x++)
+    {
+        unseeded.StartPixelSample(x, 4, 17);
+        values.push_back(unseeded.Get1D());
+    }
+    for (uint32_t x = 0; x < 64; x++)
+    {
+        seeded.StartPixelSample(x, 4, 17);
+        float u = seeded.Get1D();
+        BOOST_CHECK(std::find(values.begin(), values.end(), u) == values.end());
+    }
+};
+
+BOOST_AUTO_TEST_CASE(RandomSamplerLightSampleTest)
+{
+    // a pass of photons at the default photons_per_pass, more than a pixel axis holds
+    RandomSampler sampler(1), camera(1);
+    std::vector<std::pair<float, float>> values;
+    for (uint32_t photon = 0; photon < 200000; photon++)
+    {
+        sampler.StartLightSample(photon, 3);
+        glm::vec2 u = sampler.Get2D();
+        values.emplace_back(u.x, u.y);
+    }
+
+    // every photon a path of its own
+    std::sort(values.begin(), values.end());
+    BOOST_CHECK(std::adjacent_find(values.begin(), values.end()) == values.end());
+
+    // and none repeats the camera samples of the pixel keyed the same
+    for (uint32_t s = 0; s < 64; s++)
+    {
+        sampler.StartLightSample(s, 3);
+        camera.StartPixelSample(3, 0, s);
+        BOOST_CHECK_NE(sampler.Get1D(), camera.Get1D());
+    }
+};
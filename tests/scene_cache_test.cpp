@@ -0,0 +1,172 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Scene cache"
+
+#include "scene_cache.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace
+{
+
+int64_t ModificationTime(const std::string &path)
+{
+    struct stat st;
+    stat(path.c_str(), &st);
+    return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// the source time in the header, after the magic, version and source size
+int64_t CachedModificationTime(const std::string &path)
+{
+    int64_t mtime = 0;
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(16);
+    in.read((char *)&mtime, sizeof(int64_t));
+    return mtime;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(RoundTripTest)
+{
+    namespace fs = boost::filesystem;
+    fs::path dir = fs::temp_directory_path() / fs::unique_path("%%%%-%%%%");
+    fs::create_directories(dir);
+    std::string source = (dir / "scene.obj").string(), cache = source + ".lwsc";
+    std::ofstream(source) << "v 0 0 0\n";
+
+    SceneDescription scene;
+    MaterialDescription material = {glm::vec3(0.5f), glm::vec3(0.0f), glm::vec3(0.1f),
+                                    glm::vec3(0.0f), dir.string() + "/wood.png"};
+    scene.materials_ = {material, material};
+    scene.materials_[1].texture_ = "";
+    scene.imported_vertices_ = {
+        {{glm::vec3(1.0f, 2.0f, 3.0f), glm::vec2(0.5f), glm::vec3(0.0f)}}};
+    scene.imported_indices_ = {{0, 0, 0}};
+    scene.objects_ = {{1, scene.imported_vertices_[0], scene.imported_indices_[0]}};
+    scene.draws_ = {{glm::mat4(2.0f), 0}};
+
+    BOOST_REQUIRE(WriteSceneCache(cache, source, dir.string(), scene));
+
+    // read back from another spelling of the directory
+    SceneDescription read;
+    std::string other_dir = (dir / ".").string();
+    BOOST_REQUIRE(ReadSceneCache(cache, source, other_dir, &read));
+    BOOST_CHECK_EQUAL(read.materials_[0].texture_, other_dir + "/wood.png");
+    BOOST_CHECK_EQUAL(read.materials_[1].texture_, "");
+    BOOST_CHECK_EQUAL(read.materials_[0].specular_.y, 0.1f);
+    BOOST_CHECK_EQUAL(read.objects_[0].material_, 1u);
+    BOOST_CHECK_EQUAL(read.objects_[0].vertices_[0].pos_.z, 3.0f);
+    BOOST_CHECK_EQUAL(read.objects_[0].indices_.size(), 3u);
+    BOOST_CHECK_EQUAL(read.draws_[0].transform_[1][1], 2.0f);
+    // the geometry is viewed in the file
+    BOOST_CHECK(read.file_.IsOpen());
+    BOOST_CHECK(read.imported_vertices_.empty());
+
+    // touching the source keeps the cache and updates the time in it, changing it
+    // doesn't
+    fs::last_write_time(source, fs::last_write_time(source) + 10);
+    BOOST_CHECK(ReadSceneCache(cache, source, dir.string(), &read));
+    BOOST_CHECK_EQUAL(CachedModificationTime(cache), ModificationTime(source));
+    std::ofstream(source) << "v 0 0 1\n";
+    BOOST_CHECK(!ReadSceneCache(cache, source, dir.string(), &read));
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(OutOfRangeTest)
+{
+    namespace fs = boost::filesystem;
+    fs::path dir = fs::temp_directory_path() / fs::unique_path("%%%%-%%%%");
+    fs::create_directories(dir);
+    std::string source = (dir / "scene.obj").string(), cache = source + ".lwsc";
+    std::ofstream(source) << "v 0 0 0\n";
+
+    auto make_scene = []() {
+        SceneDescription scene;
+        scene.materials_ = {{glm::vec3(0.5f), glm::vec3(0.0f), glm::vec3(0.0f),
+                             glm::vec3(0.0f), ""}};
+        scene.imported_vertices_ = {std::vector<Vertex>(3)};
+        scene.imported_indices_ = {{0, 1, 2}};
+        scene.objects_ = {{0, scene.imported_vertices_[0], scene.imported_indices_[0]}};
+        scene.draws_ = {{glm::mat4(1.0f), 0}};
+        return scene;
+    };
+
+    // files with indices past the arrays they index are imported again
+    SceneDescription read;
+    for (int field = 0; field < 4; field++)
+    {
+        SceneDescription scene = make_scene();
+        if (field == 1)
+            scene.objects_[0].material_ = 1;
+        else if (field == 2)
+            scene.imported_indices_[0][2] = 3;
+        else if (field == 3)
+            scene.draws_[0].object_ = 1;
+
+        BOOST_REQUIRE(WriteSceneCache(cache, source, dir.string(), scene));
+        BOOST_CHECK_EQUAL(ReadSceneCache(cache, source, dir.string(), &read), field == 0);
+    }
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(ForgedCountsTest)
+{
+    namespace fs = boost::filesystem;
+    fs::path dir = fs::temp_directory_path() / fs::unique_path("%%%%-%%%%");
+    fs::create_directories(dir);
+    std::string source = (dir / "scene.obj").string(), cache = source + ".lwsc";
+    std::ofstream(source) << "v 0 0 0\n";
+
+    SceneDescription scene;
+    scene.materials_ = {
+        {glm::vec3(0.5f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), ""}};
+
+    // counts of materials, objects, draws and material libraries past the hashes, far
+    // more than the file holds; the cache is rejected before anything is allocated for
+    // them
+    SceneDescription read;
+    for (int field = 0; field < 4; field++)
+    {
+        BOOST_REQUIRE(WriteSceneCache(cache, source, dir.string(), scene));
+        {
+            uint32_t count = 0xffffffff;
+            std::fstream out(cache, std::ios::binary | std::ios::in | std::ios::out);
+            out.seekp(40 + field * sizeof(uint32_t));
+            out.write((const char *)&count, sizeof(uint32_t));
+        }
+        BOOST_CHECK(!ReadSceneCache(cache, source, dir.string(), &read));
+    }
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(MaterialLibraryTest)
+{
+    namespace fs = boost::filesystem;
+    fs::path dir = fs::temp_directory_path() / fs::unique_path("%%%%-%%%%");
+    fs::create_directories(dir);
+    std::string source = (dir / "scene.obj").string(), cache = source + ".lwsc";
+    std::string library = (dir / "scene.mtl").string();
+    std::ofstream(source) << "mtllib scene.mtl\r\nv 0 0 0\n";
+    std::ofstream(library) << "newmtl red\nKd 1 0 0\n";
+
+    SceneDescription scene, read;
+    BOOST_REQUIRE(WriteSceneCache(cache, source, dir.string(), scene));
+    BOOST_CHECK(ReadSceneCache(cache, source, dir.string(), &read));
+
+    // editing only the library makes the cache stale, the source is unchanged
+    std::ofstream(library) << "newmtl red\nKd 0 0 1\n";
+    BOOST_CHECK(!ReadSceneCache(cache, source, dir.string(), &read));
+    BOOST_REQUIRE(WriteSceneCache(cache, source, dir.string(), scene));
+    BOOST_CHECK(ReadSceneCache(cache, source, dir.string(), &read));
+    fs::remove(library);
+    BOOST_CHECK(!ReadSceneCache(cache, source, dir.string(), &read));
+
+    fs::remove_all(dir);
+}
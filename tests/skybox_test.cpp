@@ -0,0 +1,117 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Skybox"
+
+#include "config.h"
+#include "lights.h"
+
+#include <OpenEXR/ImfRgbaFile.h>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <glm/gtc/constants.hpp>
+#include <random>
+
+namespace
+{
+
+const int WIDTH = 16, HEIGHT = 8;
+
+// a dim map with a bright texel and a black row, loaded the way the renderer does
+Skybox MakeSkybox()
+{
+    std::vector<Imf::Rgba> pixels(WIDTH * HEIGHT);
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+        {
+            float value = x == 5 && y == 3 ? 100.0f : 0.1f * float(x + 1);
+            if (y == 6)
+                value = 0.0f;
+            pixels[y * WIDTH + x] = {value, value, value, 1.0f};
+        }
+
+    auto path = boost::filesystem::temp_directory_path() / "skybox_test.exr";
+    {
+        Imf::RgbaOutputFile file(path.c_str(), WIDTH, HEIGHT, Imf::WRITE_RGBA);
+        file.setFrameBuffer(pixels.data(), 1, WIDTH);
+        file.writePixels(HEIGHT);
+    }
+
+    Config::inst().SetParameter("sky_map", path.string());
+    Config::inst().SetParameter("sky_map_scale", 1.0f);
+    Skybox skybox;
+    Config::inst().SetParameter("sky_map", std::string(""));
+
+    boost::filesystem::remove(path);
+    return skybox;
+}
+
+glm::vec3 Direction(float theta, float phi)
+{
+    return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                     std::sin(theta) * std::sin(phi));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(PdfMatchesHistogramTest)
+{
+    Skybox skybox = MakeSkybox();
+    BOOST_REQUIRE(skybox.HasMap());
+
+    const int samples = 400000;
+    std::vector<int> histogram(WIDTH * HEIGHT, 0);
+    std::mt19937 mt(3);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    for (int i = 0; i < samples; i++)
+    {
+        float pdf;
+        glm::vec3 dir = skybox.SampleDirection(glm::vec2(dist(mt), dist(mt)), &pdf);
+        BOOST_REQUIRE_GT(pdf, 0.0f);
+        BOOST_CHECK_CLOSE(pdf, skybox.Pdf(dir), 1e-3f);
+
+        float theta = std::acos(glm::clamp(dir.y, -1.0f, 1.0f));
+        float phi = std::atan2(dir.z, dir.x);
+        if (phi < 0.0f)
+            phi += 2.0f * glm::pi<float>();
+        int x = std::min(int(phi / (2.0f * glm::pi<float>()) * WIDTH), WIDTH - 1);
+        int y = std::min(int(theta / glm::pi<float>() * HEIGHT), HEIGHT - 1);
+        histogram[y * WIDTH + x]++;
+    }
+
+    // the pdf is constant over the angles of a texel, its probability is the pdf at
+    // the centre times the solid angle
+    float d_theta = glm::pi<float>() / HEIGHT, d_phi = 2.0f * glm::pi<float>() / WIDTH;
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+        {
+            float theta = (float(y) + 0.5f) * d_theta, phi = (float(x) + 0.5f) * d_phi;
+            float expected =
+                skybox.Pdf(Direction(theta, phi)) * std::sin(theta) * d_theta * d_phi;
+            float frequency = float(histogram[y * WIDTH + x]) / float(samples);
+
+            BOOST_CHECK_SMALL(frequency - expected,
+                              4.0f * std::sqrt(expected / float(samples)) + 1e-5f);
+        }
+
+    BOOST_CHECK_EQUAL(histogram[6 * WIDTH + 2], 0);
+    BOOST_CHECK_GT(histogram[3 * WIDTH + 5], samples / 4);
+}
+
+BOOST_AUTO_TEST_CASE(PdfIntegratesToOneTest)
+{
+    Skybox skybox = MakeSkybox();
+
+    // midpoint rule, several points per texel
+    const int rows = 32 * HEIGHT, columns = 32 * WIDTH;
+    float d_theta = glm::pi<float>() / rows, d_phi = 2.0f * glm::pi<float>() / columns;
+    double integral = 0.0;
+    for (int y = 0; y < rows; y++)
+        for (int x = 0; x < columns; x++)
+        {
+            float theta = (float(y) + 0.5f) * d_theta, phi = (float(x) + 0.5f) * d_phi;
+            integral +=
+                skybox.Pdf(Direction(theta, phi)) * std::sin(theta) * d_theta * d_phi;
+        }
+
+    BOOST_CHECK_CLOSE(integral, 1.0, 0.1);
+}
@@ -0,0 +1,49 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Spectrum"
+
+#include "spectrum.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(HeroWavelengthsTest)
+{
+    for (float u = 0.0f; u < 1.0f; u += 0.01f)
+    {
+        HeroWavelengths lambda(u);
+        for (int i = 0; i < SPECTRUM_HERO_WAVELENGTHS; i++)
+        {
+            BOOST_CHECK_GE(lambda[i], float(SPECTRUM_LAMBDA_START));
+            BOOST_CHECK_LT(lambda[i], float(SPECTRUM_LAMBDA_END));
+        }
+    }
+};
+
+BOOST_AUTO_TEST_CASE(RoundTripTest)
+{
+    const int runs = 4096;
+    glm::vec3 white = glm::vec3(), red = glm::vec3(), teal = glm::vec3();
+
+    for (int i = 0; i < runs; i++)
+    {
+        HeroWavelengths lambda((float(i) + 0.5f) / float(runs));
+        white += SpectrumToRGB(RGBToSpectrum(glm::vec3(0.5f), lambda), lambda);
+        red += SpectrumToRGB(RGBToSpectrum(glm::vec3(1.0f, 0.0f, 0.0f), lambda), lambda);
+        teal += SpectrumToRGB(RGBToSpectrum(glm::vec3(0.2f, 0.6f, 0.5f), lambda), lambda);
+    }
+    white /= float(runs);
+    red /= float(runs);
+    teal /= float(runs);
+
+    // grey is flat and keeps its value
+    BOOST_CHECK_CLOSE(white.x, 0.5f, 0.1f);
+    BOOST_CHECK_CLOSE(white.y, 0.5f, 0.1f);
+    BOOST_CHECK_CLOSE(white.z, 0.5f, 0.1f);
+
+    // the fitted table reproduces colours, saturated ones included
+    BOOST_CHECK_CLOSE(red.x, 1.0f, 1.0f);
+    BOOST_CHECK_SMALL(red.y, 0.01f);
+    BOOST_CHECK_SMALL(red.z, 0.01f);
+    BOOST_CHECK_CLOSE(teal.x, 0.2f, 2.0f);
+    BOOST_CHECK_CLOSE(teal.y, 0.6f, 1.0f);
+    BOOST_CHECK_CLOSE(teal.z, 0.5f, 1.0f);
+};
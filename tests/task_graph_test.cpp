@@ -0,0 +1,95 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Task graph"
+
+#include "task_graph.h"
+
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <stdexcept>
+
+BOOST_AUTO_TEST_CASE(DependencyOrderTest)
+{
+    std::mutex mutex;
+    std::vector<std::string> order;
+    auto record = [&](const std::string &name) {
+        return [&, name]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(name);
+        };
+    };
+
+    TaskGraph graph;
+    auto a = graph.Add("a", record("a"));
+    auto b = graph.Add("b", record("b"), {a});
+    auto c = graph.Add("c", record("c"), {a});
+    auto d = graph.Add("d", record("d"), {b, c});
+    graph.Start(3);
+    graph.Wait(d);
+
+    BOOST_CHECK(graph.Done(b) && graph.Done(c));
+    BOOST_REQUIRE_EQUAL(order.size(), 4u);
+    BOOST_CHECK_EQUAL(order.front(), "a");
+    BOOST_CHECK_EQUAL(order.back(), "d");
+
+    // added after its dependency is done, it's ready right away
+    auto e = graph.Add("e", record("e"), {d});
+    graph.Wait(e);
+    BOOST_CHECK_EQUAL(order.back(), "e");
+}
+
+BOOST_AUTO_TEST_CASE(MainThreadTest)
+{
+    TaskGraph graph;
+    std::atomic<bool> worker_ran(false);
+    std::thread::id ran_on;
+
+    auto worker = graph.Add("worker", [&]() { worker_ran = true; });
+    auto main = graph.Add(
+        "main", [&]() { ran_on = std::this_thread::get_id(); }, {worker}, true);
+    graph.Start(1);
+    graph.Wait(main);
+
+    BOOST_CHECK(worker_ran);
+    BOOST_CHECK(ran_on == std::this_thread::get_id());
+}
+
+BOOST_AUTO_TEST_CASE(MainThreadChainTest)
+{
+    TaskGraph graph;
+    std::thread::id window_on, upload_on;
+    std::atomic<bool> decoded(false);
+
+    // as the interactive startup: only the last main thread task is waited for, the
+    // ones it depends on run in the same Wait, a worker task between them too
+    auto import = graph.Add("import", []() {});
+    auto window = graph.Add(
+        "window", [&]() { window_on = std::this_thread::get_id(); }, {import}, true);
+    auto decode = graph.Add("decode", [&]() { decoded = true; }, {window});
+    auto upload = graph.Add(
+        "upload", [&]() { upload_on = std::this_thread::get_id(); }, {window, decode},
+        true);
+    graph.Start(2);
+    graph.Wait(upload);
+
+    BOOST_CHECK(decoded);
+    BOOST_CHECK(window_on == std::this_thread::get_id());
+    BOOST_CHECK(upload_on == std::this_thread::get_id());
+}
+
+BOOST_AUTO_TEST_CASE(FailureTest)
+{
+    TaskGraph graph;
+    bool dependent_ran = false;
+
+    auto failing = graph.Add("failing", []() { throw std::runtime_error("broken"); });
+    auto dependent = graph.Add("dependent", [&]() { dependent_ran = true; }, {failing});
+    auto independent = graph.Add("independent", []() {});
+    graph.Start(2);
+
+    BOOST_CHECK_THROW(graph.Wait(dependent), std::runtime_error);
+    BOOST_CHECK(!dependent_ran);
+    BOOST_CHECK_NO_THROW(graph.Wait(independent));
+    BOOST_CHECK_THROW(graph.Wait(failing), std::runtime_error);
+
+    graph.LogTimings();
+}
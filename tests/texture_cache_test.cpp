@@ -0,0 +1,105 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Texture cache"
+
+#include "texture_cache.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+
+const uint64_t HEADER = 16;
+const uint32_t PAGES = 8;
+
+// texel i of page p holds p * PAGE_TEXELS + i
+std::string WritePages()
+{
+    std::string path = (boost::filesystem::temp_directory_path() /
+                        boost::filesystem::unique_path("%%%%-%%%%.lwtx"))
+                           .string();
+    std::ofstream out(path, std::ios::binary);
+
+    std::vector<char> header(HEADER, 'x');
+    out.write(header.data(), header.size());
+    for (uint32_t i = 0; i < PAGES * TextureCache::PAGE_TEXELS; i++)
+        out.write((const char *)&i, sizeof(uint32_t));
+    return path;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(EvictionTest)
+{
+    std::string path = WritePages();
+    TextureCache cache(2 * TextureCache::PAGE_BYTES);
+    uint32_t id = cache.Register(path, HEADER, PAGES);
+
+    BOOST_CHECK_EQUAL(cache.Fetch(id, 3, 5), 3 * TextureCache::PAGE_TEXELS + 5);
+    BOOST_CHECK_EQUAL(cache.Fetch(id, 3, 6), 3 * TextureCache::PAGE_TEXELS + 6);
+    BOOST_CHECK_EQUAL(cache.Fetch(id, 0, 0), 0u);
+
+    auto stats = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.misses_, 2u);
+    BOOST_CHECK_EQUAL(stats.hits_, 1u);
+    BOOST_CHECK_EQUAL(stats.evictions_, 0u);
+
+    // a third page doesn't fit
+    BOOST_CHECK_EQUAL(cache.Fetch(id, 7, 1), 7 * TextureCache::PAGE_TEXELS + 1);
+    BOOST_CHECK_EQUAL(cache.GetStatistics().evictions_, 1u);
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentFetchTest)
+{
+    std::string path = WritePages();
+    TextureCache cache(3 * TextureCache::PAGE_BYTES);
+    uint32_t id = cache.Register(path, HEADER, PAGES);
+
+    // far more pages in use than slots, every thread keeps evicting the others' pages
+    std::vector<std::thread> threads;
+    std::atomic<int> errors(0);
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t]() {
+            for (uint32_t i = 0; i < 20000; i++)
+            {
+                uint32_t page = (i * 7 + t) % PAGES, texel = (i * 13) % 1024;
+                uint32_t expected = page * TextureCache::PAGE_TEXELS + texel;
+                if (cache.Fetch(id, page, texel) != expected)
+                    errors++;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    BOOST_CHECK_EQUAL(errors.load(), 0);
+    auto stats = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.hits_ + stats.misses_, 80000u);
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(ManyTexturesTest)
+{
+    // more textures than the cache keeps descriptors open for, read round robin
+    std::string path = WritePages();
+    TextureCache cache(4 * TextureCache::PAGE_BYTES);
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 100; i++)
+        ids.push_back(cache.Register(path, HEADER, PAGES));
+
+    for (int round = 0; round < 3; round++)
+        for (uint32_t i = 0; i < ids.size(); i++)
+        {
+            uint32_t page = (i + round) % PAGES;
+            BOOST_CHECK_EQUAL(cache.Fetch(ids[i], page, i),
+                              page * TextureCache::PAGE_TEXELS + i);
+        }
+
+    boost::filesystem::remove(path);
+}
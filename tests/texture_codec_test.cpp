@@ -0,0 +1,74 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Texture codec"
+
+#include "texture_codec.h"
+
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+uint32_t RGBA(int r, int g, int b)
+{
+    uint8_t texel[4] = {uint8_t(r), uint8_t(g), uint8_t(b), 255};
+    uint32_t ret;
+    std::memcpy(&ret, texel, 4);
+    return ret;
+}
+
+// largest difference of a colour channel over the block after a round trip
+int RoundTripError(const uint32_t *texels)
+{
+    uint64_t block = EncodeBlock(texels);
+    int error = 0;
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+    {
+        uint8_t expected[4], decoded[4];
+        uint32_t rgba = DecodeTexel(block, i);
+        std::memcpy(expected, &texels[i], 4);
+        std::memcpy(decoded, &rgba, 4);
+        for (int c = 0; c < 3; c++)
+            error = std::max(error, std::abs(int(expected[c]) - int(decoded[c])));
+    }
+    return error;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(GradientTest)
+{
+    // four steps along the principal axis, the palette holds them all
+    uint32_t texels[BLOCK_TEXELS];
+    for (uint32_t y = 0; y < 4; y++)
+        for (uint32_t x = 0; x < 4; x++)
+            texels[y * 4 + x] = RGBA(30 + 60 * x, 220 - 60 * x, 100 + 30 * x);
+
+    // within the rounding of the 5 bit channels
+    BOOST_CHECK_LE(RoundTripError(texels), 6);
+}
+
+BOOST_AUTO_TEST_CASE(TwoColourTest)
+{
+    uint32_t texels[BLOCK_TEXELS];
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+        texels[i] = (i + i / 4) % 2 ? RGBA(200, 30, 90) : RGBA(20, 180, 240);
+
+    BOOST_CHECK_LE(RoundTripError(texels), 4);
+
+    // the colours stay apart, each on an end point of its own
+    uint64_t block = EncodeBlock(texels);
+    BOOST_CHECK_NE(DecodeTexel(block, 0), DecodeTexel(block, 1));
+    BOOST_CHECK_EQUAL(DecodeTexel(block, 0), DecodeTexel(block, 5));
+}
+
+BOOST_AUTO_TEST_CASE(ConstantTest)
+{
+    uint32_t texels[BLOCK_TEXELS];
+    for (auto &texel : texels)
+        texel = RGBA(128, 64, 32);
+
+    BOOST_CHECK_LE(RoundTripError(texels), 4);
+    BOOST_CHECK_EQUAL(DecodeTexel(EncodeBlock(texels), 3) >> 24, 255u);
+}
@@ -0,0 +1,30 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Texture manager"
+
+#include "texture_manager.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+
+BOOST_AUTO_TEST_CASE(SharedTextureTest)
+{
+    namespace fs = boost::filesystem;
+    fs::path dir = fs::temp_directory_path() / fs::unique_path("%%%%-%%%%");
+    fs::create_directories(dir);
+    // never decoded, textures are read on first use only
+    std::ofstream((dir / "a.png").string());
+    std::ofstream((dir / "b.png").string());
+
+    TextureManager textures;
+    Texture *a = textures.Acquire((dir / "a.png").string());
+    BOOST_CHECK_EQUAL(textures.Acquire((dir / "." / "a.png").string()), a);
+    BOOST_CHECK_NE(textures.Acquire((dir / "b.png").string()), a);
+
+    // missing files share the fallback texture
+    BOOST_CHECK_EQUAL(textures.Acquire((dir / "c.png").string()),
+                      textures.Acquire((dir / "d.png").string()));
+    BOOST_CHECK_EQUAL(textures.Size(), 3u);
+
+    fs::remove_all(dir);
+}